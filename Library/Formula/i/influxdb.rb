@@ -17,7 +17,7 @@ class Influxdb < Formula
   end
 
   head do
-    url "https://github.com/influxdb/influxdb.git"
+    url "https://github.com/influxdb/influxdb.git", :vcs_metadata => true
   end
 
   depends_on "go" => :build
@@ -0,0 +1,240 @@
+require 'keg'
+require 'metafiles'
+
+# Pours a gzipped bottle into the Cellar in a single pass:  The tarball is decompressed & its entries unpacked as they stream past,
+# and in text files the placeholders `@@HOMEBREW_PREFIX@@` & `@@HOMEBREW_CELLAR@@` are replaced on the way through, so each file is
+# written to the Cellar once and nothing is read back afterwards.  Mach-O files are written as they come, but those whose bytes
+# hold a placeholder are noted, so that only they need their load commands edited (see {#mach_o_files}).
+#
+# This stands in for `tar -xzf` followed by Keg#relocate_text_files, which reads every file in the keg again (once through
+# `file`, and once more for each text file).  Bottles in any other compression format are still staged the old way.
+#
+# Given #thin_to, each fat file is also thinned (see Keg#thin) as soon as it is written, by a `lipo` run in the background while
+# the rest of the bottle pours.
+class BottlePourer
+  BLOCK = 512
+  CHUNK = 64 * 1024
+  PLACEHOLDER_RX = /@@HOMEBREW_(?:PREFIX|CELLAR)@@/
+  PLACEHOLDER_LENGTH = Keg::PREFIX_PLACEHOLDER.length  # Both are the same length.
+
+  class << self
+    # Whether the bottle at “path” can be poured this way.
+    def pourable?(path)
+      require 'zlib'
+      path.compression_type == :gzip
+    rescue LoadError
+      false
+    end
+  end # << self
+
+  # The Mach-O files written which contain a placeholder, & so need their install names relocated.
+  attr_reader :mach_o_files
+
+  # The text files written, with any placeholders already replaced.
+  attr_reader :text_files
+
+  # How many octets thinning saved.
+  attr_reader :octets_thinned
+
+  def initialize(bottle, destination = HOMEBREW_CELLAR, prefix = HOMEBREW_PREFIX, cellar = HOMEBREW_CELLAR)
+    @bottle = Pathname(bottle)
+    @destination = Pathname(destination)
+    @replacements = { Keg::PREFIX_PLACEHOLDER => binary(prefix.to_s), Keg::CELLAR_PLACEHOLDER => binary(cellar.to_s) }
+    @mach_o_files = []
+    @text_files = []
+    @thinners = []  # [PID, path, temporary path], for each `lipo` still running
+    @octets_thinned = 0
+  end # initialize
+
+  # Thin each fat file to those of “archs” it holds, “jobs” at a time; nil “archs” means no thinning.
+  def thin_to(archs, jobs = CPU.cores)
+    @thin_archs = archs
+    @thin_jobs = [jobs.to_i, 1].max
+    self
+  end # thin_to
+
+  def pour
+    require 'zlib'
+    @directories = []  # [path, mode, mtime], set once their contents are in place
+    @bottle.open('rb') do |f|
+      gz = Zlib::GzipReader.new(f)
+      begin
+        each_entry(gz) { |header| extract(gz, header) }
+      ensure
+        gz.close
+        reap_thinners
+      end
+    end
+    @mach_o_files = @mach_o_files.select(&:tracked_mach_o?)  # Not, say, a Java class file (which shares the fat magic).
+    @directories.reverse_each do |dir, mode, mtime|
+      dir.chmod(mode)
+      File.utime(mtime, mtime, dir.to_s)
+    end
+    self
+  end # pour
+
+  private
+
+  def binary(s); s.respond_to?(:force_encoding) ? s.dup.force_encoding('BINARY') : s; end
+
+  # Yields a hash describing each entry, leaving the stream at the start of its contents.  GNU long names & pax extended headers
+  # are folded into the entry they describe.
+  def each_entry(io)
+    long_name = long_link = nil
+    pax = {}
+    while (block = io.read(BLOCK)) and block.length == BLOCK
+      break if block.count("\0") == BLOCK  # End of archive.
+      name, mode, _, _, size, mtime, _, type, link = block.unpack('Z100A8A8A8A12A12A8aZ100')
+      magic, prefix = block[257, 6], block[345, 155].unpack('Z155').first
+      name = "#{prefix}/#{name}" if magic =~ /\Austar/ and not prefix.empty?
+      size = size.oct
+      case type
+        when 'L' then long_name = read_contents(io, size).sub(/\0.*\z/m, '')
+        when 'K' then long_link = read_contents(io, size).sub(/\0.*\z/m, '')
+        when 'x' then pax = parse_pax(read_contents(io, size))
+        when 'g' then read_contents(io, size)
+        else
+          header = { :name => pax['path'] || long_name || name,
+                     :link => pax['linkpath'] || long_link || link,
+                     :type => type,
+                     :mode => mode.oct & 07777,
+                     :size => (pax['size'] || size).to_i,
+                     :mtime => (pax['mtime'] || mtime.oct).to_i }
+          long_name = long_link = nil
+          pax = {}
+          yield header
+      end # case type
+    end # while a header block remains
+  end # each_entry
+
+  def read_contents(io, size)
+    data = size > 0 ? io.read(size) : ''
+    skip_padding(io, size)
+    data
+  end
+
+  def skip_padding(io, size); io.read(BLOCK - size % BLOCK) if size % BLOCK != 0; end
+
+  def parse_pax(data)
+    h = {}
+    data.scan(/\d+ ([^=]+)=(.*?)\n/m) { h[$1] = $2 }
+    h
+  end
+
+  def target_for(name)
+    name = name.sub(%r{\A\./}, '')
+    raise "Refusing to pour #{name} from #{@bottle.basename}" \
+      if name.starts_with?('/') or name.split('/').include?('..')
+    @destination/name
+  end # target_for
+
+  def extract(io, header)
+    path = target_for(header[:name])
+    case header[:type]
+      when '5'
+        path.mkpath
+        @directories << [path, header[:mode], header[:mtime]]
+      when '2'
+        path.dirname.mkpath
+        path.unlink if path.symlink? or path.exist?
+        path.make_symlink(header[:link])
+      when '1'
+        path.dirname.mkpath
+        path.unlink if path.symlink? or path.exist?
+        target = target_for(header[:link])
+        reap_thinners if @thinners.any?{ |t| t[1] == target }  # Link to the thinned file, not the fat one it replaces.
+        FileUtils.ln(target, path)
+      when '0', "\0", ''
+        path.dirname.mkpath
+        path.unlink if path.symlink? or path.exist?
+        write_file(io, path, header)
+      else read_contents(io, header[:size])  # Device nodes, FIFOs &c. have no place in a bottle.
+    end # case type
+  end # extract
+
+  # Copies the file’s contents from the stream, replacing placeholders in text files as it goes.  A file is taken as text if its
+  # first chunk holds no NUL bytes (or it is a libtool archive), & isn’t documentation.  A placeholder straddling two chunks is
+  # caught by holding back the last few bytes of each chunk until the next has arrived.
+  def write_file(io, path, header)
+    remaining = header[:size]
+    kind = nil
+    pending = binary('')
+    path.open('wb') do |out|
+      while remaining > 0
+        chunk = io.read([remaining, CHUNK].min)
+        raise "#{@bottle.basename} is truncated" unless chunk and chunk.length > 0
+        remaining -= chunk.length
+        kind ||= classify(path, chunk)
+        case kind
+          when :text
+            done, pending = substitute(pending + chunk, remaining == 0)
+            out.write(done)
+          when :mach_o
+            out.write(chunk)
+            unless @mach_o_files.last == path
+              @mach_o_files << path if (pending + chunk) =~ PLACEHOLDER_RX
+              pending = chunk[-(PLACEHOLDER_LENGTH - 1)..-1] || chunk
+            end
+          else out.write(chunk)
+        end # case kind
+      end # while remaining
+    end # open |out|
+    skip_padding(io, header[:size])
+    @text_files << path if kind == :text
+    path.chmod(header[:mode])
+    File.utime(header[:mtime], header[:mtime], path.to_s)
+    thin(path) if kind == :mach_o and @thin_archs
+  end # write_file
+
+  # Starts `lipo` thinning the file just written, once fewer than @thin_jobs others are still at it.
+  def thin(path)
+    return unless keep = Keg.slices_to_keep(path, @thin_archs)
+    reap_thinners(@thin_jobs - 1)
+    temp = Keg.thin_temp(path)
+    args = Keg.lipo_thin_args(path, keep, temp)
+    pid = fork do
+      begin
+        exec(*args)
+      rescue Exception
+        exit! 1
+      end
+    end
+    @thinners << [pid, path, temp]
+  end # thin
+
+  # Waits, oldest first, until no more than “limit” thinners are still running, putting each thinned file in place as its `lipo`
+  # finishes.  A file `lipo` failed on is simply left fat.
+  def reap_thinners(limit = 0)
+    while @thinners.length > limit
+      pid, path, temp = @thinners.shift
+      Process.waitpid(pid)
+      if $?.success? and temp.file? then @octets_thinned += Keg.replace_thinned(path, temp)
+      else
+        opoo "Could not thin #{path}" if DEBUG
+        temp.unlink if temp.exist?
+      end
+    end
+  end # reap_thinners
+
+  def classify(path, chunk)
+    if chunk.length >= 4 and MachO::FILE_SIGNATURES[chunk[0, 4].unpack('N').first] then :mach_o
+    elsif Metafiles::EXTENSIONS.include? path.extname then :other
+    elsif path.extname == '.la' or not chunk.include?("\0") then :text
+    else :other; end
+  end # classify
+
+  # Replaces each complete placeholder in “buf”.  Returns the replaced text that is safe to write, & the tail which might yet
+  # begin a placeholder (empty if this is the last of the file).
+  def substitute(buf, last)
+    limit = last ? buf.length : [buf.length - (PLACEHOLDER_LENGTH - 1), 0].max
+    out = binary('')
+    pos = 0
+    while (i = buf.index(PLACEHOLDER_RX, pos)) and i < limit
+      out << buf[pos...i] << @replacements[$&]
+      pos = i + PLACEHOLDER_LENGTH
+    end
+    keep = [pos, limit].max
+    out << buf[pos...keep]
+    return out, buf[keep..-1]
+  end # substitute
+end # BottlePourer
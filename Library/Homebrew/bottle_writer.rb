@@ -0,0 +1,160 @@
+require 'zlib'
+require 'utils/fork'
+
+# Writes a bottle – a gzipped tarball of one or more kegs – so that identical kegs always give identical bytes, using every core
+# to compress it, and noting which files contain any of a given set of strings (the prefix & Cellar paths, for `brew bottle` to
+# judge relocatability) as they go by.
+#
+# The tar stream is deterministic:  Entries are in sorted order, owned by root:wheel, and all stamped with the same mtime
+# (SOURCE_DATE_EPOCH if set, else the Mac OS X epoch); only their names, modes, contents & link targets are kept.  The stream is
+# cut into fixed‐size slices, each of which is deflated by a forked worker, primed with the 32 KiB preceding it and ended with a
+# sync flush so the pieces join up into one ordinary deflate stream.  The result is a single‐member gzip file, which the `gunzip`
+# shipped with Tiger reads as readily as Zlib::GzipReader does.  Since the slicing doesn’t depend on the number of workers, neither
+# does the output.
+class BottleWriter
+  BLOCK = 512
+  SLICE = 1024 * 1024
+  DICTIONARY = 32 * 1024
+  EPOCH = 978307200  # 2001‐01‐01 00:00:00 UTC
+
+  # Deflates one slice.  Some Rubies’ zlib bindings raise a spurious BufError if a signal arrives mid‐flush; as deflating is
+  # deterministic, the slice is simply done over.
+  def self.deflate(level, dict, data, mode)
+    tries = 0
+    begin
+      z = Zlib::Deflate.new(level, -Zlib::MAX_WBITS)
+      z.set_dictionary(dict) unless dict.empty?
+      z.deflate(data, mode)
+    rescue Zlib::BufError
+      raise if (tries += 1) > 10
+      retry
+    ensure
+      z.close
+    end
+  end # BottleWriter::deflate
+
+  # “root” is the directory the tarball’s names are relative to, & “names” are the files & directories under it to include.
+  # Options:  :scan (strings to look for), :jobs (workers; default CPU.cores), :level (compression level), & :slice (bytes).
+  def initialize(root, names, options = {})
+    @root = Pathname(root)
+    @names = names
+    @scan = (options[:scan] || []).map(&:to_s).uniq
+    @jobs = options[:jobs]
+    @level = options[:level] || Zlib::DEFAULT_COMPRESSION
+    @slice = options[:slice] || SLICE
+    @mtime = (ENV['SOURCE_DATE_EPOCH'] || EPOCH).to_i
+    @matches = {}  # string scanned for => [files containing it]
+    @scan.each{ |s| @matches[s] = [] }
+  end # initialize
+
+  # The files found to contain the given string (one of those scanned for), in the order they were written.  Of hardlinked
+  # files, only the first is named.
+  def files_containing(string); @matches[string.to_s] || []; end
+
+  def write(io)
+    unless @jobs
+      require 'cpu'
+      @jobs = CPU.cores
+    end
+    @out = io
+    @pending = binary('')
+    @dictionary = binary('')
+    @crc = Zlib.crc32
+    @length = 0
+    @inodes = {}
+    @out.write [0x1f, 0x8b, 8, 0, 0, 0, 3].pack('CCCCVCC')  # No name & no mtime, for reproducibility.
+    @names.sort.each{ |name| add(name) }
+    emit "\0" * (BLOCK * 2)
+    flush(true)
+    @out.write [@crc, @length & 0xffffffff].pack('VV')
+    self
+  end # write
+
+  private
+
+  def binary(s); s.respond_to?(:force_encoding) ? s.dup.force_encoding('BINARY') : s; end
+
+  def add(name)
+    path = @root/name
+    st = path.lstat
+    if st.symlink? then entry(name, '2', 0777, 0, path.readlink.to_s)
+    elsif st.directory?
+      entry("#{name}/", '5', st.mode & 07777, 0)
+      Dir.entries(path.to_s).reject{ |e| e == '.' or e == '..' }.sort.each{ |e| add("#{name}/#{e}") }
+    elsif st.file?
+      if st.nlink > 1 and (first = @inodes[[st.dev, st.ino]]) then entry(name, '1', st.mode & 07777, 0, first)
+      else
+        @inodes[[st.dev, st.ino]] = name if st.nlink > 1
+        entry(name, '0', st.mode & 07777, st.size)
+        copy(path, st.size)
+      end
+    end # regular file; other kinds are left out
+  end # add
+
+  def copy(path, size)
+    tail = binary('')
+    keep = (@scan.map{ |s| binary(s).length }.max || 1) - 1
+    written = 0
+    path.open('rb') do |f|
+      while written < size and chunk = f.read([size - written, @slice].min)
+        written += chunk.length
+        emit chunk
+        next if @scan.empty?
+        window = tail + chunk
+        @scan.each{ |s| @matches[s] << path if @matches[s].last != path and window.include?(binary(s)) }
+        tail = window[-keep..-1] || window if keep > 0
+      end
+    end
+    raise "#{path} changed size while being bottled" unless written == size
+    emit "\0" * (BLOCK - size % BLOCK) if size % BLOCK != 0
+  end # copy
+
+  # Emits a header block (preceded by GNU long‐name blocks where a name won’t fit).
+  def entry(name, type, mode, size, link = '')
+    name, link = binary(name), binary(link)
+    if link.length > 100
+      entry('././@LongLink', 'K', 0644, link.length + 1)
+      emit link + "\0" * (BLOCK - link.length % BLOCK)
+    end
+    prefix = ''
+    if name.length > 100
+      if (i = name.index('/', name.length - 101)) and i <= 155 and i > 0 then prefix, name = name[0, i], name[i + 1..-1]
+      else
+        entry('././@LongLink', 'L', 0644, name.length + 1)
+        emit name + "\0" * (BLOCK - name.length % BLOCK)
+      end
+    end
+    fields = [name[0, 100], '%07o' % mode, '%07o' % 0, '%07o' % 0, '%011o' % size, '%011o' % @mtime, ' ' * 8, type,
+              link[0, 100], 'ustar', '00', 'root', 'wheel', '', '', prefix]
+    header = fields.pack('a100a8a8a8a12a12a8aa100a6a2a32a32a8a8a155x12')
+    sum = 0
+    header.each_byte{ |b| sum += b }
+    header[148, 8] = ('%06o' % sum) + "\0 "
+    emit header
+  end # entry
+
+  def emit(data)
+    @pending << data
+    flush(false) if @pending.length >= @slice * @jobs
+  end
+
+  # Deflates every whole slice pending (& the remainder, if this is the last), in parallel, & writes them out in order.
+  def flush(last)
+    slices = []
+    offset = 0
+    while @pending.length - offset >= @slice or (last and (offset < @pending.length or slices.empty?))
+      data = @pending[offset, @slice]
+      offset += data.length
+      slices << [@dictionary, data, Zlib::SYNC_FLUSH]
+      @dictionary = (@dictionary + data)[-DICTIONARY..-1] || @dictionary + data
+    end
+    @pending = @pending[offset..-1]
+    slices.last[2] = Zlib::FINISH if last
+    compressed = Utils.parallel_map(slices, @jobs) { |dict, data, mode| BottleWriter.deflate(@level, dict, data, mode) }
+    slices.each_with_index do |(_, data, _), i|
+      @crc = Zlib.crc32(data, @crc)
+      @length += data.length
+      @out.write compressed[i]
+    end
+  end # flush
+end # BottleWriter
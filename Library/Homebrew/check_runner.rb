@@ -0,0 +1,66 @@
+require 'stringio'
+require 'utils/fork'
+
+# Runs a set of diagnostic checks – the `check_*` methods of an object such as `brew doctor`’s Checks – concurrently, & hands back
+# their results in the order they were asked for.
+#
+# Most checks only look at things, so they run in forked children, “jobs” at a time.  A check whose side effects other checks read
+# is named in “:in_process”, & runs in this process so that every check started after it sees those effects; “:after” names, for
+# each check that reads such effects, the checks it must follow.  Before any check runs, the object’s #warm_probes (if it has one) is
+# called, so that expensive probes several checks share – compiler & Xcode versions, the installed formulæ – are done once, here, &
+# inherited by every child.
+#
+# Whatever a check prints is collected along with the warning it returns, & an exception it raises is recorded as its result rather
+# than ending the run.  Each check’s cost is measured, for `brew doctor --timings`.
+class CheckRunner
+  class Result < Struct.new(:name, :output, :printed, :seconds, :error); end
+
+  attr_reader :probe_seconds, :elapsed
+
+  def initialize(checks, names, options = {})
+    @checks = checks
+    @names = names.map(&:to_s)
+    @after = options[:after] || {}
+    @in_process = options[:in_process] || []
+    @jobs = options[:jobs] || CPU.cores
+  end # initialize
+
+  # Runs every check, & returns their Results in the order the checks were named.
+  def run
+    started = Time.now
+    @checks.warm_probes if @checks.respond_to?(:warm_probes)
+    @probe_seconds = Time.now - started
+    done = {}
+    pending = @names.dup
+    until pending.empty?
+      ready = pending.select{ |name| (@after[name] || []).all?{ |a| done[a] or not @names.include?(a) } }
+      raise "The checks #{pending.list} wait on one another" if ready.empty?
+      serial, forked = ready.partition{ |name| @in_process.include? name }
+      serial.each{ |name| done[name] = run_one(name) }
+      forked.zip(Utils.parallel_map(forked, @jobs){ |name| run_one(name) }).each{ |name, result| done[name] = result }
+      pending -= ready
+    end
+    @elapsed = Time.now - started
+    @results = @names.map{ |name| done[name] }
+  end # run
+
+  # The Results of the last run, costliest first.
+  def timings; (@results || []).sort_by{ |r| -r.seconds }; end
+
+  private
+
+  def run_one(name)
+    old_out, old_err = $stdout, $stderr
+    $stdout = $stderr = buffer = StringIO.new
+    started = Time.now
+    begin
+      output = @checks.send(name)
+      output = output.to_s unless output.nil?
+    rescue StandardError => e
+      error = "#{e.class}:  #{e.message}"
+    end
+    Result.new(name, output, buffer.string, Time.now - started, error)
+  ensure
+    $stdout, $stderr = old_out, old_err
+  end # run_one
+end # CheckRunner
@@ -2,6 +2,7 @@ require "formula"
 require "bottles"
 require "tab"
 require "keg"
+require "bottle_writer"
 require "formula/versions"
 require "utils/inreplace"
 require "erb"
@@ -35,7 +36,9 @@ EOS
 MAXIMUM_STRING_MATCHES = 100
 
 module Homebrew
-  def keg_contains(string, keg, ignores)
+  # “files”, if given, are those already known to contain the string (see BottleWriter#files_containing); otherwise the keg is
+  # searched for them.
+  def keg_contains(string, keg, ignores, files = nil)
     @put_string_exists_header, @put_filenames = nil
 
     def print_filename(string, filename)
@@ -53,7 +56,12 @@ module Homebrew
 
     result = false
 
-    keg.each_unique_file_matching(string) do |file|
+    unless files
+      files = []
+      keg.each_unique_file_matching(string) { |file| files << file }
+    end
+
+    files.each do |file|
       # skip document file.
       next if Metafiles::EXTENSIONS.include? file.extname
 
@@ -186,29 +194,29 @@ module Homebrew
 
         keg.delete_pyc_files!
 
-        cd cellar do
-          # Use gzip, faster to compress than bzip2, faster to uncompress than bzip2
-          # or an uncompressed tarball (and more bandwidth friendly).
-          safe_system TAR_PATH, "czf", bottle_path, "#{f.name}/#{f.pkg_version}"
-        end
-
-        if bottle_path.size > 1*1024*1024
-          ohai "Detecting if #{filename} is relocatable..."
-        end
-
         if prefix == "/usr/local"
           prefix_check = File.join(prefix, "opt")
         else
           prefix_check = prefix
         end
 
+        # Use gzip, faster to compress than bzip2, faster to uncompress than bzip2
+        # or an uncompressed tarball (and more bandwidth friendly).  The writer
+        # notes which files hold the prefix or Cellar as it compresses them.
+        writer = BottleWriter.new(cellar, ["#{f.name}/#{f.pkg_version}"], :scan => [prefix_check, cellar])
+        bottle_path.open("wb") { |out| writer.write(out) }
+
+        if bottle_path.size > 1*1024*1024
+          ohai "Detecting if #{filename} is relocatable..."
+        end
+
         ignores = []
         if f.deps.any? { |dep| dep.name == "go" }
           ignores << %r{#{HOMEBREW_CELLAR}/go/[\d\.]+/libexec}
         end
 
-        relocatable = !keg_contains(prefix_check, keg, ignores)
-        relocatable = !keg_contains(cellar, keg, ignores) && relocatable
+        relocatable = !keg_contains(prefix_check, keg, ignores, writer.files_containing(prefix_check))
+        relocatable = !keg_contains(cellar, keg, ignores, writer.files_containing(cellar)) && relocatable
         skip_relocation = relocatable && !keg.require_install_name_tool?
         puts if !relocatable && VERBOSE
       rescue Interrupt
@@ -1,10 +1,14 @@
 require 'formula'
+require 'installed_index'
 require 'keg'
 require 'bottles'
+require 'download_cache'
+require 'keg_cache'
 require 'thread'
 
 module Homebrew
   def cleanup
+    InstalledIndex.instance(ARGV.include? '--rebuild')
     if ARGV.named.empty?
       cleanup_cellar
       cleanup_cache
@@ -27,6 +31,7 @@ module Homebrew
   def cleanup_cache(f = nil)
     return unless HOMEBREW_CACHE.directory?
     HOMEBREW_CACHE.children.each do |path|
+      next if DownloadCache.own?(path)
       if f then next unless path.basename.to_s.starts_with?(f.name); end
       if prune?(path)
         if path.file? then cleanup_path(path) { path.unlink }
@@ -50,8 +55,31 @@ module Homebrew
         cleanup_path(file) { file.unlink }
       end
     end # each cache child |path|
+    cleanup_keg_cache(f)
+    cleanup_blobs unless f or ARGV.dry_run?
   end # cleanup_cache
 
+  # Copies of built kegs (see KegCache) are kept whatever the formula’s current version – switching back to an older one is what they
+  # are for – so they go only when unused for longer than `--prune` allows, or when scrubbing.
+  def cleanup_keg_cache(f = nil)
+    return unless KegCache::DIR.directory?
+    KegCache::DIR.children.each do |path|
+      next unless path.file? and not path.basename.to_s.starts_with?('.')
+      next if f and not path.basename.to_s.starts_with?("#{f.name}--")
+      cleanup_path(path) { path.unlink } if ARGV.switch?('s') or prune?(path)
+    end
+  end # cleanup_keg_cache
+
+  # Fold any plain downloads into the content‐addressed store (see DownloadCache), then evict whatever no entry needs any more, and
+  # whatever $HOMEBREW_CACHE_BUDGET leaves no room for.
+  def cleanup_blobs
+    saved = DownloadCache.absorb
+    DownloadCache.prune_dangling
+    freed = DownloadCache.evict(DownloadCache.budget, :orphans => true, :wait => true)
+    puts "Deduplicated #{'%.1f' % (saved / 1048576.0)} MB of downloads" if saved > 0
+    puts "Evicted #{'%.1f' % (freed / 1048576.0)} MB of downloads" if freed > 0
+  end # cleanup_blobs
+
   def cleanup_cellar; Formula.installed.each{ |formula| cleanup_formula formula }; end
 
   def cleanup_checkpoints(f = nil)
@@ -63,17 +91,17 @@ module Homebrew
   end # cleanup_checkpoints
 
   def cleanup_formula(f)
+    entry = InstalledIndex.instance.rack(f.rack.basename)
+    kegs = entry ? entry.kegs : []
     if f.installed?
-      eligible_kegs = f.rack.subdirs.map{ |d| Keg.new(d) }.select{ |k| f.pkg_version > k.version }
+      eligible_kegs = kegs.select{ |k| f.pkg_version > k.version }.map(&:keg)
       if eligible_kegs.any? && eligible_for_cleanup?(f) then eligible_kegs.each{ |keg| cleanup_keg(keg) }
       else eligible_kegs.each{ |keg| opoo "Skipping (old) keg-only:  #{keg}" }; end
-    elsif (pn = f.linked_keg.resolved_path).directory? \
-          or (f.pinned? and (pn = (PINDIR/f.name).resolved_path).directory?) \
-          or (pn = f.opt_prefix.resolved_path).directory?  # Clean up the others.
-      eligible_kegs = f.rack.subdirs.select{ |d| d != pn }.map{ |d| Keg.new(d) }
+    elsif entry and (keep = entry.linked_keg || entry.pinned_keg || entry.opt_keg)  # Clean up the others.
+      eligible_kegs = (kegs - [keep]).map(&:keg)
       if eligible_kegs.any? and eligible_for_cleanup?(f) then eligible_kegs.each{ |keg| cleanup_keg(keg) }
       else eligible_kegs.each{ |keg| opoo "Skipping (old) keg-only:  #{keg}" }; end
-    elsif f.rack.subdirs.length == 1  # If only one version is installed, don’t complain that we can’t tell which one to keep.
+    elsif kegs.length == 1  # If only one version is installed, don’t complain that we can’t tell which one to keep.
       opoo "Skipping #{f.full_name}:  Most recent version #{f.pkg_version} not installed"
     else raise MultipleVersionsInstalledError.new(f.full_name); end
   end # cleanup_formula
@@ -115,7 +143,7 @@ module Homebrew
       # SHA records were added to INSTALL_RECEIPTs the same day as opt symlinks
       Formula.installed.select{ |f|
         f.deps.any?{ |d| d.to_formula.full_name == formula.full_name rescue d.name == formula.name }
-      }.all?{ |f| f.rack.subdirs.all?{ |keg| Tab.for_keg(keg).git_head_SHA1 } }
+      }.all?{ |f| (entry = InstalledIndex.instance.rack(f.rack.basename)).nil? or entry.kegs.all?(&:git_head_SHA1) }
     end
   end # eligible_for_cleanup?
 
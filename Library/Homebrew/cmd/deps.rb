@@ -13,6 +13,7 @@
 #:one.  (“Intersection” is the default as it’s harder to get using other tools.)
 
 # encoding: UTF-8
+require 'dependency_graph'
 require 'formula'
 require 'ostruct'
 
@@ -28,13 +29,14 @@ module Homebrew
     if mode.tree?
       category_label = mode.no_discr? ? 'required' : mode.no_optnl? ? 'recommended' : 'all'
       category_label += ' run-time' if mode.no_build?
-      puts_deps_tree((mode.installed? ? Formula.installed : mode.all? ? Formula : ARGV.formulae), category_label)
+      puts_deps_tree((mode.installed? ? snapshot_formulae(:installed) : mode.all? ? snapshot_formulae : ARGV.formulae),
+                     category_label)
     elsif mode.all? or mode.installed?
-      puts_deps(mode.all? ? Formula : Formula.installed)
+      puts_deps(mode.installed? ? snapshot_formulae(:installed) : snapshot_formulae)
     else
-      all_deps = deps_for_formulae(ARGV.formulae, &(mode.union? ? :| : :&))
-      all_deps = all_deps.select(&:installed?) if mode.installed?
-      puts all_deps.map(&:name).uniq.sort
+      names = dep_names_for_formulae(ARGV.formulae, &(mode.union? ? :| : :&))
+      names = names.select{ |name| dep_name_installed?(name) } if mode.installed?
+      puts names.uniq.sort
     end
   end # deps
 
@@ -57,6 +59,44 @@ module Homebrew
     }
   end # gather_ignores
 
+  def dependency_graph; DependencyGraph.instance; end
+
+  # The classes of dependency graph edge that the command line says to ignore.
+  def ignored_classes(ignores = gather_ignores)
+    ignored = 0
+    ignored |= DependencyGraph::BUILD if ignores['build?']
+    ignored |= DependencyGraph::OPTIONAL if ignores['optional?'] or ignores['discretionary?']
+    ignored |= DependencyGraph::RECOMMENDED if ignores['discretionary?']
+    ignored
+  end # ignored_classes
+
+  # Every formula in the snapshot, or every installed one, as snapshot entries.  These answer `full_name` just as formulæ do, and
+  # the graph queries below need nothing more.
+  def snapshot_formulae(which = :all)
+    which == :installed ? FormulaSnapshot.instance.installed : FormulaSnapshot.instance.entries
+  end
+
+  # A formula’s dependencies as a bitset over the dependency graph, or nil if the graph doesn’t know the formula (as when it was
+  # loaded from a path or URL).  Recursive expansion waives pruning for recommended dependencies, as Dependency::expand does for
+  # any a formula is built with by default.
+  def dependency_mask(f)
+    return unless id = dependency_graph[f.full_name]
+    if mode.recursive? then dependency_graph.closure(id, ignored_classes, DependencyGraph::RECOMMENDED)
+    else dependency_graph.direct(id, ignored_classes); end
+  end # dependency_mask
+
+  def dep_names_for_formula(f)
+    (mask = dependency_mask(f)) ? dependency_graph.names_in(mask) : deps_for_formula(f).map(&:name)
+  end
+
+  def dep_names_for_formulae(formulae, &block); formulae.map{ |f| dep_names_for_formula f }.inject(&block); end
+
+  def dep_name_installed?(name)
+    (id = dependency_graph[name]) ? dependency_graph.installed[id] == 1 : Formulary.factory(name).installed?
+  rescue FormulaUnavailableError
+    false
+  end
+
   def gather_deps_and_reqs(formula, ignores = gather_ignores)
     if mode.recursive?
       deps = formula.recursive_dependencies do |dependent, dependency|
@@ -79,16 +119,15 @@ module Homebrew
     (deps + reqs.select(&:default_formula?).map(&:to_dependency)).uniq
   end
 
-  def deps_for_formulae(formulae, &block); formulae.map{ |f| deps_for_formula f }.inject(&block); end
-
   def puts_deps(formulae)
-    formulae.each{ |f|; d = deps_for_formula f; puts "#{f.full_name}:  #{d.sort_by(&:name).list}" if d and not d.empty? }
+    formulae.each{ |f|; d = dep_names_for_formula f; puts "#{f.full_name}:  #{d.sort.list}" if d and not d.empty? }
   end
 
   def puts_deps_tree(formulae, category_label)
     formulae.each do |f|
       puts "#{f.full_name} (#{category_label} dependencies)"
-      recursive_deps_tree(f, '', gather_ignores)
+      if id = dependency_graph[f.full_name] then graph_deps_tree(id, '', ignored_classes)
+      else recursive_deps_tree(f, '', gather_ignores); end
       puts
     end
   end # puts_deps_tree
@@ -117,4 +156,21 @@ module Homebrew
       recursive_deps_tree(ff, prefix + prefix_ext, ignores, dependency_chain + [nm])
     end
   end # recursive_deps_tree()
+
+  # As recursive_deps_tree, but walking the dependency graph instead of loading each formula.
+  def graph_deps_tree(id, prefix, ignored, dependency_chain = [id])
+    g = dependency_graph
+    edges = g.edges_of(id).select{ |edge| edge.klass & ignored == 0 }.sort_by{ |edge| g.name_of(edge.to) }
+    edges = edges.select(&:requirement?) + edges.reject(&:requirement?)
+    max = edges.length - 1
+    edges.each_with_index do |edge, i|
+      nm = g.name_of(edge.to)
+      raise "{#{nm}} has a circular dependency!\n    {#{dependency_chain.map{ |d| g.name_of(d) } * '} → {'}} → {#{nm}}" \
+                                                                                          if dependency_chain.includes? edge.to
+      str = i == max ? '└──' : '├──'
+      prefix_ext = i == max ? '    ' : '│   '
+      puts prefix + "#{str} #{':' if edge.requirement?}#{nm}#{" #{g.installed[edge.to] == 1 ? TICK : CROSS}" unless NO_EMOJI}"
+      graph_deps_tree(edge.to, prefix + prefix_ext, ignored, dependency_chain + [edge.to])
+    end
+  end # graph_deps_tree()
 end # Homebrew
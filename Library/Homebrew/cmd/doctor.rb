@@ -1,3 +1,4 @@
+require "check_runner"
 require "cmd/missing"
 require "formula"
 require "keg"
@@ -49,6 +50,13 @@ class Volumes
 end # Volumes
 
 class Checks
+  # How the checks must be scheduled, where it matters (see CheckRunner):  Those in IN_PROCESS have side effects that later checks
+  # read, & AFTER names, for each check reading them, the checks it must follow.  Every other check stands alone.
+  IN_PROCESS = %w[check_user_path_1].freeze
+  AFTER = {
+    "check_user_path_2" => %w[check_user_path_1],
+    "check_user_path_3" => %w[check_user_path_1],
+  }.freeze
 
   ############# HELPERS
   # Finds files in HOMEBREW_PREFIX *and* /usr/local.
@@ -63,6 +71,25 @@ class Checks
   def inject_file_list(list, str)
     list.inject(str) { |s, f| s << "    #{f}\n" }
   end
+
+  # The result of an expensive probe, worked out only the first time any check asks for it.
+  def probe(key)
+    @probes ||= {}
+    @probes.fetch(key) { @probes[key] = yield }
+  end
+
+  def installed_formulae; probe(:installed_formulae) { Formula.installed }; end
+
+  # Run the probes that several checks share, before the checks are forked off, so that they are run only once.  A probe that fails
+  # here is left for the checks needing it to fail on, & report.
+  def warm_probes
+    [ lambda { Utils.git_available? },
+      lambda { MacOS::Xcode.installed? and MacOS::Xcode.version },
+      lambda { MacOS::CLT.installed? },
+      lambda { MacOS.clang_version },
+      lambda { installed_formulae },
+    ].each { |p| p.call rescue nil }
+  end
   ############# END HELPERS
 
   def check_path_for_trailing_slashes
@@ -935,7 +962,7 @@ class Checks
   def check_for_linked_keg_only_brews
     return unless HOMEBREW_CELLAR.exists?
 
-    linked = Formula.installed.select do |f|
+    linked = installed_formulae.select do |f|
       f.keg_only? and __check_linked_brew(f)
     end
 
@@ -976,7 +1003,7 @@ class Checks
   def check_missing_deps
     return unless HOMEBREW_CELLAR.exists?
     missing = Set.new
-    Homebrew.missing_deps(Formula.installed).each_value do |deps|
+    Homebrew.missing_deps(installed_formulae).each_value do |deps|
       missing.merge(deps)
     end
 
@@ -1210,8 +1237,6 @@ module Homebrew
       exit
     end
 
-    inject_dump_stats(checks) if ARGV.switch? "D"
-
     if ARGV.named.empty?
       methods = checks.all.sort
       methods << "check_for_linked_keg_only_brews" << "check_for_outdated_leopardbrew"
@@ -1220,15 +1245,22 @@ module Homebrew
       methods = ARGV.named
     end
 
+    unknown, methods = methods.partition { |method| not checks.respond_to? method }
+    unknown.each do |method|
+      Homebrew.failed = true
+      puts "No check available by the name: #{method}"
+    end
+
+    runner = CheckRunner.new(checks, methods, :after => Checks::AFTER, :in_process => Checks::IN_PROCESS)
     first_warning = true
-    methods.each do |method|
-      begin
-        out = checks.send(method)
-      rescue NoMethodError
+    runner.run.each do |result|
+      $stdout.write result.printed
+      if result.error
         Homebrew.failed = true
-        puts "No check available by the name: #{method}"
+        onoe "#{result.name} could not be completed:  #{result.error}"
         next
       end
+      out = result.output
       unless out.nil? or out.empty?
         if first_warning
           $stderr.puts <<-EOS.undent
@@ -1245,21 +1277,14 @@ module Homebrew
       end
     end
 
+    print_timings(runner) if ARGV.include? "--timings" or ARGV.switch? "D"
     puts "Your system is ready to brew." unless Homebrew.failed?
   end # doctor
 
-  def inject_dump_stats(checks)
-    checks.extend Module.new {
-      def send(method, *)
-        time = Time.now
-        super
-      ensure
-        $times[method] = Time.now - time
-      end
-    }
-    $times = {}
-    at_exit do
-      puts $times.sort_by { |_k, v| v }.map { |k, v| "#{k}: #{v}" }
-    end
-  end # inject_dump_stats
+  def print_timings(runner)
+    ohai "Timings"
+    runner.timings.each { |r| puts "#{"%8.2fs" % r.seconds}  #{r.name}" }
+    puts "#{"%8.2fs" % runner.probe_seconds}  (shared probes, run beforehand)"
+    puts "#{"%8.2fs" % runner.elapsed}  in all, running checks concurrently"
+  end # print_timings
 end # Homebrew
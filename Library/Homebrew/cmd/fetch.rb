@@ -16,6 +16,16 @@ module Homebrew
     end
 
     puts "Fetching: #{bucket * ", "}" if bucket.size > 1
+    # Hash everything already downloaded up front, spread across the CPU cores, rather than one file at a time as each is verified.
+    require "digest_cache"
+    DigestCache.prime(bucket.map { |f| fetchables_for(f) }.flatten.map(&:cached_download)) unless ARGV.force?
+    # Then fetch whatever isn't yet downloaded in the background, several at once; see DownloadScheduler.
+    unless ARGV.force? || ENV["HOMEBREW_NO_BACKGROUND_DOWNLOADS"]
+      require "download_scheduler"
+      scheduler = DownloadScheduler.new
+      bucket.each { |f| fetchables_for(f).each { |item| scheduler.add(item.is_a?(Formula) ? item.active_spec : item) } }
+      scheduler.start
+    end
     bucket.each do |f|
       f.print_tap_action :verb => "Fetching"
 
@@ -29,6 +39,11 @@ module Homebrew
     end
   end
 
+  def fetchables_for(f)
+    return [f.bottle] if fetch_bottle?(f)
+    [f] + f.resources + f.patchlist.select(&:external?)
+  end
+
   def fetch_bottle?(f)
     return true if ARGV.force_bottle? && f.bottle
     return false unless f.bottle && f.pour_bottle?
@@ -77,6 +92,7 @@ module Homebrew
     f.clear_cache if ARGV.force?
 
     already_fetched = f.cached_download.exist?
+    DownloadScheduler.wait_for(f) if defined?(DownloadScheduler)
 
     begin
       download = f.fetch
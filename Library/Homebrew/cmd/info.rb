@@ -2,6 +2,7 @@ require 'blacklist'
 require 'caveats'
 require 'cmd/options'
 require 'formula'
+require 'formula_snapshot'
 require 'keg'
 require 'tab'
 require 'utils/json'
@@ -150,8 +151,9 @@ module Homebrew
     tick = ["2714".hex].pack("U*")
     cross = ["2718".hex].pack("U*")
     deps_status = dependencies.collect do |dep|
-        colr = dep.installed? ? TTY.green : TTY.red
-        symb = dep.installed? ? tick : cross
+        installed = dep_installed?(dep)
+        colr = installed ? TTY.green : TTY.red
+        symb = installed ? tick : cross
         colored_dep = NO_EMOJI ? "#{colr}#{dep}" : "#{dep} #{colr}#{symb}"
         "#{colored_dep}#{TTY.reset}"
       end
@@ -159,4 +161,11 @@ module Homebrew
   end # decorate_dependencies
 
   def all_deps(formula); (formula.deps + formula.requirements.to_dependencies).uniq; end
+
+  # Consults the formula snapshot, if one has been built, so that listing a formula’s dependencies doesn’t mean evaluating every one
+  # of them.  Without one, asking each dependency is still far cheaper than evaluating every formula to build the snapshot.
+  def dep_installed?(dep)
+    return dep.installed? if dep.group_dep? or not FormulaSnapshot.available?
+    (entry = FormulaSnapshot.instance[dep.name]) ? entry.installed? : dep.installed?
+  end
 end # Homebrew
@@ -1,16 +1,22 @@
 require 'formula'
+require 'installed_index'
 require 'tab'
 require 'set'
 
 module Homebrew
   def leaves
+    index = InstalledIndex.instance(ARGV.include? '--rebuild')
     installed = Formula.installed
     deps_of_installed = Set.new
 
     installed.each do |f|
-      deps = []
-      tab = Tab.for_formula(f)
-      f.deps.each{ |dep| deps << dep.to_formula.full_name if not dep.discretionary? or tab.with?(dep) }
+      keg = (entry = index.rack(f.rack.basename)) ? entry.active_keg : nil
+      if keg and keg.dependencies then deps = keg.dependencies  # As recorded when it was installed.
+      else
+        deps = []
+        tab = Tab.for_formula(f)
+        f.deps.each{ |dep| deps << dep.to_formula.full_name if not dep.discretionary? or tab.with?(dep) }
+      end
       deps_of_installed.merge(deps)
     end # each |f|
 
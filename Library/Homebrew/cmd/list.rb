@@ -1,5 +1,6 @@
 require 'metafiles'
 require 'formula'
+require 'installed_index'
 
 module Homebrew
   def list
@@ -10,6 +11,7 @@ module Homebrew
       raise NoSuchRackError, ARGV.named.first if ARGV.named.any?
       return
     end
+    InstalledIndex.instance(ARGV.include? '--rebuild')  # (Which, if asked, rebuilds it & reports on what was amiss.)
     if ARGV.intersects? %w[--pinned --versions] then filtered_list
     elsif ARGV.named.empty?
       if ARGV.includes? '--full-name'
@@ -52,19 +54,17 @@ module Homebrew
   end # Homebrew#list_unbrewed
 
   def filtered_list
-    names = (ARGV.named.empty? ? Formula.racks : ARGV.named.map{ |n| HOMEBREW_CELLAR/n }.select(&:exists?))
+    index = InstalledIndex.instance
+    racks = (ARGV.named.empty? ? index.racks : ARGV.named.map{ |n| index.rack(n) }.compact)
     if ARGV.includes? '--pinned'
-      pinned_versions = {}
-      names.each{ |d|
-        keg_pin = (PINDIR/d.basename.to_s)
-        pinned_versions[d] = keg_pin.readlink.basename.to_s if keg_pin.exists? or keg_pin.symlink?
+      puts_columns racks.select(&:pinned).map{ |r|
+        "#{r.name}#{" #{File.basename(r.pinned)}" if ARGV.includes?('--versions')}"
       }
-      puts_columns pinned_versions.map{ |d, version| "#{d.basename}#{" #{version}" if ARGV.includes?('--versions')}" }
     else  # --versions without --pinned
-      puts_columns names.map{ |d|
-        versions = d.subdirs.map{ |pn| pn.basename.to_s }
+      puts_columns racks.map{ |r|
+        versions = r.kegs.map{ |k| File.basename(k.path) }
         next if ARGV.includes?('--multiple') and versions.length < 2
-        "#{d.basename} #{versions * ' '}"
+        "#{r.name} #{versions * ' '}"
       }
     end # “--pinned”?
   end # Homebrew#filtered_list
@@ -12,12 +12,18 @@
 #:code repositories.
 
 require 'formula'
-require 'keg'
+require 'formula_snapshot'
+require 'installed_index'
 require 'migrator'
 
 module Homebrew
   def outdated
-    formulae = ARGV.resolved_formulae.any? ? ARGV.resolved_formulae : Formula.installed
+    InstalledIndex.instance(ARGV.include? '--rebuild')
+    # With nothing named, every installed formula is examined; a snapshot, if one has been built, spares us from evaluating each of
+    # them.  (Building one here would mean evaluating every formula instead, which costs more.)
+    formulae = if ARGV.resolved_formulae.any? then ARGV.resolved_formulae
+               elsif FormulaSnapshot.available? then FormulaSnapshot.instance.installed
+               else Formula.installed; end
     if ARGV.json == 'v1'
       outdated = print_outdated_json(formulae)
     else
@@ -29,9 +35,10 @@ module Homebrew
   def outdated_brews(formulae)
     Array(formulae).map{ |f|
       versions = []
-      raise Migrator::MigrationNeededError.new(f) if f.oldname and not f.rack.exists? \
-                                                     and (dir = HOMEBREW_CELLAR/f.oldname).exists? \
-                                                     and f.tap == Tab.for_keg(dir.subdirs.first).tap
+      index = InstalledIndex.instance
+      raise Migrator::MigrationNeededError.new(f) if f.oldname and not index.rack(f.name) \
+                                                     and (old = index.rack(f.oldname)) and old.kegs.any? \
+                                                     and f.tap == old.kegs.first.tap
       if ARGV.build_devel? and f.devel
         check_version = PkgVersion.new(f.devel.version, f.revision)
         false_positive_version = f.pkg_version
@@ -39,8 +46,7 @@ module Homebrew
         check_version = f.pkg_version
         false_positive_version = nil
       end
-      f.rack.subdirs.each do |keg_dir|
-        version = Keg.new(keg_dir).version
+      index.versions(f.rack.basename).each do |version|
         versions << version if version != false_positive_version
       end
       versions = versions.compact
@@ -1,11 +1,18 @@
 # `brew readall` tries to import all formulae one-by-one.
 # This can be useful for debugging issues across all formulae
 # when making significant changes to formula.rb,
-# or to determine if any current formulae have Ruby issues
+# or to determine if any current formulae have Ruby issues.
+#
+# The formulae are loaded across forked workers – one per CPU core, or as many as
+# `--jobs=N` asks for – and any problems are reported in file order.  Files that
+# loaded cleanly last time & haven't changed since are skipped (see ReadallCache)
+# unless `--no-cache` is given.
 
 require "formula"
 require "cmd/tap"
 require "thread"
+require "readall_cache"
+require "utils/fork"
 
 module Homebrew
   def readall
@@ -51,14 +58,33 @@ module Homebrew
       formulae = tap.formula_files
     end
 
-    formulae.each do |file|
+    cache = ARGV.delete("--no-cache") ? ReadallCache.new : ReadallCache.load
+    jobs = (ARGV.value("jobs") || CPU.cores).to_i
+    sums = {}
+    formulae = formulae.sort.reject do |file|
+      sums[file] = ReadallCache.digest(file)
+      cache.passed?(file, sums[file])
+    end
+
+    problems = Utils.parallel_map(formulae, jobs) do |file|
       begin
         Formulary.factory(file)
+        nil
       rescue Exception => e
+        e.to_s
+      end
+    end
+
+    formulae.zip(problems).each do |file, problem|
+      if problem
         onoe "problem in #{file}"
-        puts e
+        puts problem
+        cache.fail(file)
         Homebrew.failed = true
+      else
+        cache.pass(file, sums[file])
       end
     end
+    cache.save
   end
 end
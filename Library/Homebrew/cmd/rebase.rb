@@ -0,0 +1,19 @@
+# `brew rebase [--prebind] [--dry-run]` [<formulæ>]:  Give every dylib in the named formulæ’s kegs – by default, in the whole Cellar –
+# a preferred load address clear of every other brewed dylib’s.  See RebasePlanner.
+require 'rebase_planner'
+
+module Homebrew
+  def rebase
+    kegs = if not ARGV.named.empty? then ARGV.kegs
+           elsif HOMEBREW_CELLAR.directory? then HOMEBREW_CELLAR.subdirs.map(&:subdirs).flatten.map{ |d| Keg.new(d) }
+           else []; end
+    rewritten = RebasePlanner.run(kegs, :dry_run => ARGV.dry_run?, :prebind => ARGV.include?('--prebind'))
+    if ARGV.dry_run?
+      puts "Would rebase #{rewritten.length} dylib#{plural(rewritten.length)}"
+      rewritten.each{ |pn| puts "  #{pn}" } if VERBOSE
+    else
+      ohai "Rebased #{rewritten.length} dylib#{plural(rewritten.length)}"
+      rewritten.each{ |pn| puts pn } if VERBOSE
+    end
+  end # rebase
+end # Homebrew
@@ -4,6 +4,7 @@ require "utils"
 require "thread"
 require "official_taps"
 require "descriptions"
+require "formula_snapshot"
 
 module Homebrew
   SEARCH_ERROR_QUEUE = Queue.new
@@ -138,8 +139,9 @@ module Homebrew
     aliases = Formula.alias_full_names
     results = (Formula.full_names+aliases).grep(rx).sort
 
+    snapshot = FormulaSnapshot.instance if FormulaSnapshot.available?  # Not worth building just for the handful of results.
     results.map do |name|
-      formula = Formulary.factory(name)
+      formula = (snapshot and snapshot[name]) || Formulary.factory(name)
       canonical_name = formula.name
       canonical_full_name = formula.full_name
       # Ignore aliases from results when the full name was also found
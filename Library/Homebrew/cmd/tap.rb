@@ -42,7 +42,7 @@ module Homebrew
 
     formula_count = tap.formula_files.size
     puts "Tapped #{formula_count} formula#{plural(formula_count, "e")} (#{tap.path.abv})"
-    Descriptions.cache_formulae(tap.formula_names)
+    Descriptions.refresh_cache
 
     if !clone_target && tap.private?
       puts <<-EOS.undent
@@ -0,0 +1,23 @@
+# `brew thin [--archs=<archs>] [--dry-run]` <formulæ>:  Cut every fat Mach-O file & `ar` archive in each formula’s keg down to the
+# given architectures – by default, those this Mac runs natively – and record the keg as built for only those.  See Keg#thin.
+require 'keg'
+
+module Homebrew
+  def thin
+    raise KegUnspecifiedError if ARGV.named.empty?
+    archs = (list = ARGV.value('archs')) ? ARGV.archs_from(list) : Target.native_archs
+    ARGV.kegs.each do |keg|
+      if ARGV.dry_run?
+        files = keg.thinnable_files(archs)
+        puts "Would thin #{files.length} file#{plural(files.length)} in #{keg}"
+        files.each{ |pn, keep| puts "  #{pn.relative_path_from(keg.path)} (keeping #{keep.list})" } if VERBOSE
+        next
+      end
+      keg.lock do
+        ohai "Thinning #{keg} to #{archs.list}"
+        saved = keg.thin(archs)
+        puts saved > 0 ? "#{'%.1f' % (saved / 1048576.0)} MB saved" : 'Nothing to thin'
+      end
+    end # each ARGV |keg|
+  end # thin
+end # Homebrew
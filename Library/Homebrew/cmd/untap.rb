@@ -14,9 +14,9 @@ module Homebrew
       tap.unpin if tap.pinned?
 
       formula_count = tap.formula_files.size
-      Descriptions.uncache_formulae(tap.formula_names)
       tap.path.rmtree
       tap.path.dirname.rmdir_if_possible
+      Descriptions.refresh_cache
       puts "Untapped #{formula_count} formula#{plural(formula_count, "e")}"
     end
   end
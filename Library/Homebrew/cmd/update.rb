@@ -4,6 +4,7 @@ require 'formula/versions'
 require 'migrator'
 require 'formulary'
 require 'descriptions'
+require 'utils/fork'
 
 module Homebrew
   HOME_REPO_GIT = 'git@github.com:gsteemso/leopardbrew.git'
@@ -31,19 +32,11 @@ module Homebrew
     master_updater.pull!
     report.update(master_updater.report)
     rename_taps_dir_if_necessary  # Rename Taps directories.  This will be removed in future if it seems unnecessary.
-    Tap.each do |tap|
-      next unless tap.git?
-      tap.path.cd do
-        updater = Updater.new(tap.path)
-        begin
-          updater.pull!
-        rescue
-          onoe "Failed to update tap: #{tap}"
-        else
-          report.update(updater.report) { |_key, oldval, newval| oldval.concat(newval) }
-        end
-      end # cd to tap/path
-    end # each |tap|
+    updaters = [master_updater] + update_taps
+    # With every repository up to date, detect what changed in all of them in one pass.
+    updaters[1..-1].each do |updater|
+      updater.repository.cd { report.update(updater.report) { |_key, oldval, newval| oldval.concat(newval) } }
+    end
     Tap.clear_cache
     report.select_formula(:D).each do |f|  # Automatically tap any migrated formulæ's new taps.
       next unless (dir = HOMEBREW_CELLAR/f).exists?
@@ -83,11 +76,30 @@ module Homebrew
       puts "Updated Leopardbrew from #{master_updater.initial_revision[0, 8]} to #{master_updater.current_revision[0, 8]}."
       report.dump
     end
-    Descriptions.update_cache(report)
+    Descriptions.update_cache(updaters.map(&:changed_files).flatten, master_updater.library_changed?)
   end # Homebrew#update
 
   private
 
+  # Pulls every git tap, up to $HOMEBREW_UPDATE_JOBS (by default, 4) at once in forked children – the time goes on round trips to
+  # the remotes, not on this machine – and returns the Updaters of those that succeeded, for the caller to report on.
+  def update_taps
+    taps = Tap.select(&:git?)
+    pulled = Utils.parallel_map(taps, (ENV['HOMEBREW_UPDATE_JOBS'].nope || 4).to_i) do |tap|
+      begin
+        tap.path.cd { updater = Updater.new(tap.path); updater.pull!; updater }
+      rescue StandardError => e
+        e.message
+      end
+    end
+    updaters = []
+    taps.zip(pulled).each do |tap, result|
+      if result.is_a?(Updater) then updaters << result
+      else onoe "Failed to update tap: #{tap}"; $stderr.puts result if VERBOSE; end
+    end
+    updaters
+  end # Homebrew#update_taps
+
   def get_install_time; TIMESTAMP_FILE.mtime if TIMESTAMP_FILE.exists?; end
 
   def git_init_if_necessary
@@ -260,6 +272,12 @@ end # Report
 class Updater
   attr_reader :initial_revision, :current_revision, :repository
 
+  # Every formula file the update added, changed, renamed or removed (whether or not its version changed), as of the last #report.
+  def changed_files; @changed_files || []; end
+
+  # Whether Homebrew’s own code (as opposed to just formulæ) changed in this pull.
+  def library_changed?; !!@library_changed; end
+
   def initialize(repository)
     @repository = repository
     @stashed = false
@@ -300,7 +318,6 @@ class Updater
     end
     @initial_revision = read_current_revision
     safe_system 'git', 'checkout', @initial_branch, *quiet
-    @current_revision = read_current_revision
     args = %w[pull --ff]
     args << ((ARGV.includes? '--rebase') ? '--rebase' : '--no-rebase')
     args += quiet
@@ -308,6 +325,7 @@ class Updater
     # the refspec ensures that the default initial branch gets updated
     args << "refs/heads/#{@initial_branch}:refs/remotes/origin/#{@initial_branch}"
     reset_on_interrupt { safe_system 'git', *args }
+    @current_revision = read_current_revision
     if @stashed
       safe_system 'git', 'stash', 'pop', *quiet
       puts 'Restored your changes:'
@@ -328,13 +346,17 @@ class Updater
 
   def report
     map = Hash.new { |h, k| h[k] = [] }
+    @changed_files = []
+    @library_changed = false
     if initial_revision and initial_revision != current_revision
       wc_revision = read_current_revision
       diff.each_line do |line|
         status, *paths = line.split
         src = paths.first; dst = paths.last
+        @library_changed = true if repository == HOMEBREW_REPOSITORY and paths.any?{ |p| p.starts_with?('Library/Homebrew/') }
         next unless File.extname(dst) == '.rb'
-        next unless paths.any? { |p| File.dirname(p) == formula_directory }
+        next unless paths.any? { |p| formula_path?(p) }
+        paths.each { |p| @changed_files << repository.join(p) if formula_path?(p) }
         case status
           when 'A', 'D'
             map[status.to_sym] << repository.join(src)
@@ -354,8 +376,8 @@ class Updater
             end
             map[:M] << file
           when /^R\d{0,3}/
-            map[:D] << repository.join(src) if File.dirname(src) == formula_directory
-            map[:A] << repository.join(dst) if File.dirname(dst) == formula_directory
+            map[:D] << repository.join(src) if formula_path?(src)
+            map[:A] << repository.join(dst) if formula_path?(dst)
         end
       end # each diff |line|
     end # revisions differ?
@@ -371,6 +393,13 @@ class Updater
       :                                                 '.'
   end # Updater#formula_directory
 
+  # Whether the repository‐relative path “p” is a formula file.  Core formulæ are filed in lettered subdirectories (Formula/f/foo.rb);
+  # a tap’s are not.
+  def formula_path?(p)
+    if repository == HOMEBREW_REPOSITORY then p.starts_with?("#{formula_directory}/")
+    else File.dirname(p) == formula_directory; end
+  end
+
   def read_current_revision; `git rev-parse -q --verify HEAD`.chomp; end
 
   def diff
@@ -15,8 +15,23 @@ module Homebrew
   def uses
     raise FormulaUnspecifiedError if ARGV.named.empty?
     used_formulae = ARGV.formulae
+    graph = dependency_graph
+    used_ids = used_formulae.map{ |ff| graph[ff.full_name] }
+    return uses_by_evaluation(used_formulae) unless used_ids.all?
+    candidates = graph.bitset(snapshot_formulae(ARGV.includes?('--installed') ? :installed : :all).map{ |e| graph[e.full_name] })
+    installed = graph.ids_in(graph.installed)
+    masks = used_formulae.zip(used_ids).map do |ff, id|
+        mask = mode.recursive? ? graph.reverse_closure(id, ignored_classes, DependencyGraph::RECOMMENDED) \
+                               : graph.direct_dependents(id, ignored_classes)
+        installed.each{ |i| mask |= (1 << i) if Keg.new(graph.entry_of(i).prefix).enhanced_by?(ff) }
+        mask
+      end # map used formulæ |ff, id|
+    puts_columns graph.names_in(masks.inject{ |a, b| a & b } & candidates)
+  end # uses
+
+  # The original approach, for any named formula the dependency graph doesn’t know (as when it was loaded from a path or URL).
+  def uses_by_evaluation(used_formulae)
     formulae = ARGV.includes?('--installed') ? Formula.installed : Formula
-    recursive = ARGV.recursion == :yes
     uses = formulae.select do |f|
         used_formulae.all? do |ff|
           begin
@@ -31,5 +46,5 @@ module Homebrew
         end # all? block:  used formulæ |ff|
       end # select block:  user formulæ |f|
     puts_columns uses.map(&:full_name)
-  end # uses
+  end # uses_by_evaluation
 end # Homebrew
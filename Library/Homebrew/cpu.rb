@@ -1,10 +1,11 @@
 # This file is loaded before `global.rb`, so must eschew many brew‐isms at eval time.
+require 'host_probe'
 require 'mach'
 
 class CPU
   module Sysctl
     # All of the following use data extracted via sysctl.  See <sys/sysctl.h> for sysctl keys, as well as some related constants, &
-    # <mach/machine.h> for Mach‐O CPU‐encoding constants.
+    # <mach/machine.h> for Mach‐O CPU‐encoding constants.  The values are all read at once, & remembered between runs, by HostProbe.
 
     module_function
 
@@ -112,11 +113,7 @@ class CPU
 
     def sysctl_int(key); sysctl_n(key).to_i; end
 
-    def sysctl_n(*keys)
-      (@@properties ||= {}).fetch(keys) do
-        @@properties[keys] = Utils.popen_read('/usr/sbin/sysctl', '-n', *keys)
-      end
-    end
+    def sysctl_n(*keys); keys.map{ |k| HostProbe.sysctl(k) }.compact.join("\n"); end
   end # Sysctl
 
   class << self
@@ -0,0 +1,156 @@
+require 'formula_snapshot'
+
+# The dependency relations between every available formula, built from the {FormulaSnapshot} so that no formula need be evaluated
+# to answer “what does this need?” or “what needs this?”.
+#
+# Each formula gets a dense integer ID, and a set of formulæ is an Integer used as a bitset (bit n set ⇔ formula n is a member).
+# Every edge carries a class – the OR of BUILD, OPTIONAL & RECOMMENDED for each of those tags it bears, or RUN if it bears none –
+# and adjacency is kept per class, so a query which ignores some classes of edge simply ORs together the masks of those it keeps.
+# Transitive closures (forward & reverse) are memoized per node for each combination of ignored classes.
+#
+# The graph lives only as long as the snapshot it was built from:  When taps or formula files change, the snapshot is refreshed on
+# its next load, and a new graph is built from it.
+class DependencyGraph
+  BUILD       = 1
+  OPTIONAL    = 2
+  RECOMMENDED = 4
+  RUN         = 8
+
+  class CircularDependencyError < RuntimeError
+    def initialize(chain); super "{#{chain.last}} has a circular dependency!\n    {#{chain * '} → {'}}"; end
+  end
+
+  # One edge of the graph:  The formula depended upon, the edge’s class, & whether it arises from a requirement’s default formula.
+  class Edge < Struct.new(:to, :klass, :requirement)
+    def requirement?; requirement; end
+  end
+
+  class << self
+    def instance
+      snapshot = FormulaSnapshot.instance
+      @instance = new(snapshot) unless @instance and @instance.snapshot.equal?(snapshot)
+      @instance
+    end
+
+    def reset!; @instance = nil; end
+
+    # The class of an edge bearing the given tags.
+    def class_of(tags)
+      klass = 0
+      klass |= BUILD if tags.include? :build
+      klass |= OPTIONAL if tags.include? :optional
+      klass |= RECOMMENDED if tags.include? :recommended
+      klass == 0 ? RUN : klass
+    end
+  end # << self
+
+  attr_reader :snapshot
+
+  def initialize(snapshot = FormulaSnapshot.instance)
+    @snapshot = snapshot
+    @entries = snapshot.entries.dup     # ID => {FormulaSnapshot::Entry}, or nil for a name nothing in the snapshot answers to
+    @names = @entries.map(&:full_name)  # ID => name
+    @ids = {}                           # name, full name, or alias => ID
+    @entries.each_with_index{ |e, id| @ids[e.full_name] = id; @ids[e.name] ||= id }
+    @edges = []                         # ID => [{Edge}s]
+    @adj = []                           # ID => { class => bitset }
+    @radj = []                          # ID => { class => bitset }, for edges into the node
+    @entries.each_index{ |id| @edges[id] = [] }
+    snapshot.entries.each_with_index do |e, id|  # Not @entries, which grows as unknown names are met.
+      e.deps.each{ |dep| add_edge(id, id_for(dep.name), DependencyGraph.class_of(dep.tags), false) }
+      e.requirements.each do |_, default, tags|
+        add_edge(id, id_for(default), DependencyGraph.class_of(tags), true) if default
+      end
+    end
+    @closures = {}; @rclosures = {}; @installed = nil
+  end # initialize
+
+  # The ID of the named formula, or nil if the snapshot knows nothing by that name.
+  def [](name)
+    name = name.to_s
+    return @ids[name] if @ids.has_key?(name)
+    e = @snapshot[name]
+    @ids[name] = (e ? @ids[e.full_name] : nil)
+  end # []
+
+  def size; @names.length; end
+
+  def name_of(id); @names[id]; end
+
+  def entry_of(id); @entries[id]; end
+
+  def edges_of(id); @edges[id] || []; end
+
+  # A formula’s direct dependencies, along edges not ignored.  See #closure for “ignored” & “kept”.
+  def direct(id, ignored = 0, kept = 0); successors(@adj, id, ignored, kept); end
+
+  # A formula’s direct dependents, along edges not ignored.
+  def direct_dependents(id, ignored = 0, kept = 0); successors(@radj, id, ignored, kept); end
+
+  # Everything a formula depends on, recursively.  Edges of an “ignored” class are not followed unless they are also of a “kept”
+  # class.  (That mirrors Dependency::prune’s being waived for dependencies a formula is built with by default – i.e., recommended
+  # ones.)  Raises CircularDependencyError on meeting a cycle.
+  def closure(id, ignored = 0, kept = 0)
+    reach(@adj, (@closures[[ignored, kept]] ||= {}), id, ignored, kept, [])
+  end
+
+  # Everything that depends on a formula, recursively; edges are chosen just as for #closure.
+  def reverse_closure(id, ignored = 0, kept = 0)
+    reach(@radj, (@rclosures[[ignored, kept]] ||= {}), id, ignored, kept, [])
+  end
+
+  # The bitset of formulæ with their current version installed.
+  def installed
+    @installed ||= begin
+        mask = 0
+        @entries.each_with_index{ |e, id| mask |= (1 << id) if e and e.installed? }
+        mask
+      end
+  end # installed
+
+  def bitset(ids); ids.inject(0){ |mask, id| mask | (1 << id) }; end
+
+  # The IDs of a bitset’s members, in ascending order.
+  def ids_in(mask)
+    ids = []
+    bits = mask.to_s(2).reverse
+    i = -1
+    ids << i while i = bits.index('1', i + 1)
+    ids
+  end # ids_in
+
+  def names_in(mask); ids_in(mask).map{ |id| @names[id] }; end
+
+  private
+
+  # Returns the ID for a dependency’s name, adding a bare node for one the snapshot doesn’t know (e.g. from an untapped tap).
+  def id_for(name)
+    unless id = self[name]
+      id = @ids[name] = @names.length
+      @names << name; @entries << nil; @edges[id] = []
+    end
+    id
+  end # id_for
+
+  def add_edge(from, to, klass, requirement)
+    @edges[from] << Edge.new(to, klass, requirement)
+    out = (@adj[from] ||= {}); out[klass] = (out[klass] || 0) | (1 << to)
+    into = (@radj[to] ||= {}); into[klass] = (into[klass] || 0) | (1 << from)
+  end # add_edge
+
+  def successors(adj, id, ignored, kept)
+    mask = 0
+    (adj[id] || {}).each_pair{ |klass, m| mask |= m if klass & ignored == 0 or klass & kept != 0 }
+    mask
+  end
+
+  def reach(adj, memo, id, ignored, kept, chain)
+    return memo[id] if memo[id]
+    raise CircularDependencyError.new((chain + [id]).map{ |i| @names[i] }) if chain.include? id
+    chain = chain + [id]
+    direct = successors(adj, id, ignored, kept)
+    mask = direct
+    ids_in(direct).each{ |succ| mask |= reach(adj, memo, succ, ignored, kept, chain) }
+    memo[id] = mask
+  end # reach
+end # DependencyGraph
@@ -0,0 +1,183 @@
+require 'formula_snapshot'
+
+# An on‐disk trigram index over every formula’s full name & description, so that `brew search --desc` and `brew desc` need only
+# test their regular expression against the formulæ which could possibly match it.
+#
+# Each formula is given a small integer ID, and each trigram (three consecutive characters of the downcased text) maps to an
+# Integer bitset of the IDs whose text contains it – one such map for names, another for descriptions.  A query’s regular
+# expression is scanned for the literal runs any match must contain; the formulæ holding every trigram of those runs are the only
+# candidates.  (Where a pattern offers no such run, as with an alternation, every formula is a candidate.)
+#
+# The index lives in HOMEBREW_CACHE and is kept level with the {FormulaSnapshot} – only formulæ whose names or descriptions differ
+# from what was indexed are reindexed.
+class DescriptionIndex
+  INDEX_FILE = HOMEBREW_CACHE/'desc_index.marshal'
+  FORMAT_VERSION = 1
+
+  class << self
+    def instance; @instance ||= load.refresh; end
+
+    def reset!; @instance = nil; end
+
+    def exists?; INDEX_FILE.file?; end
+
+    def load
+      data = INDEX_FILE.open('rb') { |f| Marshal.load(f) } if INDEX_FILE.file?
+      new(data)
+    rescue StandardError
+      new  # A corrupt or foreign index is simply rebuilt.
+    end
+
+    def trigrams(text)
+      text = text.to_s.downcase
+      grams = {}
+      (0..(text.length - 3)).each{ |i| grams[text[i, 3]] = true }
+      grams.keys
+    end # trigrams
+
+    # The literal runs (downcased) which any match of the regular expression must contain.  Deliberately conservative:  Any
+    # alternation, group, or escape that stands for other characters makes for no runs at all, and a quantified character ends
+    # the run before it.
+    def required_literals(regex)
+      return [] if regex.options & Regexp::EXTENDED != 0
+      src = regex.source
+      runs = []; run = ''; i = 0
+      while i < src.length
+        c = src[i, 1]
+        case c
+          when '|', '(', ')' then return []
+          when '\\'
+            i += 1
+            nxt = src[i, 1]
+            return [] if nxt =~ /[0-9xucCMkgpP]/  # Character codes, back‐references & properties.
+            if nxt =~ /[A-Za-z]/ then runs << run; run = ''; else run << nxt; end  # \d, \s, \b &c. aren’t literal.
+          when '['
+            runs << run; run = ''
+            depth = 1; i += 1
+            i += 1 if src[i, 1] == '^'
+            i += 1 if src[i, 1] == ']'  # A leading ‘]’ is part of the set.
+            while i < src.length and depth > 0
+              case src[i, 1]
+                when '\\' then i += 1
+                when '[' then depth += 1
+                when ']' then depth -= 1
+              end
+              i += 1
+            end # while in the set
+            i -= 1
+          when '?', '*', '{'
+            run.chop! unless run.empty?  # The quantified character may not appear at all.
+            runs << run; run = ''
+            i = src.index('}', i) || src.length if c == '{'
+          when '+', '.', '^', '$'
+            runs << run; run = ''
+          else run << c
+        end # case c
+        i += 1
+      end # while i
+      runs << run
+      runs.map(&:downcase).select{ |r| r.length >= 3 }
+    end # required_literals
+  end # << self
+
+  def initialize(data = nil)
+    data = nil unless data.is_a?(Hash) and data[:format] == FORMAT_VERSION and data[:library] == HOMEBREW_LIBRARY.to_s
+    @docs  = data ? data[:docs]  : {}  # full name => [ID, description]
+    @names = data ? data[:names] : []  # ID => full name, or nil for a freed ID
+    @grams = data ? data[:grams] : { :name => {}, :desc => {} }  # field => { trigram => bitset of IDs }
+    @dirty = data.nil?
+    @free = []
+    @names.each_with_index{ |name, id| @free << id unless name }
+  end # initialize
+
+  # Reindex whichever formulæ are new, or whose descriptions have changed, since they were last indexed, & drop those now gone.
+  def refresh(snapshot = FormulaSnapshot.instance)
+    seen = {}
+    snapshot.entries.each do |e|
+      seen[name = e.full_name] = true
+      next if (doc = @docs[name]) and doc[1] == e.desc
+      remove(name) if doc
+      add(name, e.desc)
+    end
+    (@docs.keys - seen.keys).each{ |name| remove(name) }
+    save
+  end # refresh
+
+  def save
+    return self unless @dirty
+    HOMEBREW_CACHE.mkpath
+    INDEX_FILE.atomic_write Marshal.dump(:format => FORMAT_VERSION, :library => HOMEBREW_LIBRARY.to_s,
+                                         :docs => @docs, :names => @names, :grams => @grams)
+    @dirty = false
+    self
+  end # save
+
+  # A hash of full name => description for each formula whose name and/or description (per “field”:  :name, :desc, or :either)
+  # matches the regular expression.
+  def search(regex, field = :either)
+    fields = field == :either ? [:name, :desc] : [field]
+    results = {}
+    ids_in(fields.inject(0){ |mask, f| mask | candidates(regex, f) }).each do |id|
+      name = @names[id]; desc = @docs[name][1]
+      results[name] = desc if fields.any?{ |f| (f == :name ? name : desc) =~ regex }
+    end
+    results
+  end # search
+
+  # A hash of full name => description for the named formulæ (or every one), as indexed.
+  def descriptions(names = @docs.keys)
+    h = {}
+    names.each{ |name| h[name] = @docs[name][1] if @docs[name] }
+    h
+  end
+
+  private
+
+  # The bitset of formulæ whose field could match the regular expression.
+  def candidates(regex, field)
+    literals = DescriptionIndex.required_literals(regex)
+    return every_id if literals.empty?
+    postings = @grams[field]
+    literals.inject(every_id) do |mask, literal|
+      DescriptionIndex.trigrams(literal).inject(mask){ |m, gram| m & (postings[gram] || 0) }
+    end
+  end # candidates
+
+  def every_id
+    unless @every_id
+      @every_id = 0
+      @names.each_with_index{ |name, id| @every_id |= (1 << id) if name }
+    end
+    @every_id
+  end # every_id
+
+  def ids_in(mask)
+    ids = []
+    bits = mask.to_s(2).reverse
+    i = -1
+    ids << i while i = bits.index('1', i + 1)
+    ids
+  end # ids_in
+
+  def add(name, desc)
+    id = @free.shift || @names.length
+    @names[id] = name
+    @docs[name] = [id, desc]
+    { :name => name, :desc => desc }.each_pair do |field, text|
+      DescriptionIndex.trigrams(text).each{ |gram| @grams[field][gram] = (@grams[field][gram] || 0) | (1 << id) }
+    end
+    @every_id = nil; @dirty = true
+  end # add
+
+  def remove(name)
+    id, desc = @docs.delete(name)
+    @names[id] = nil; @free << id
+    { :name => name, :desc => desc }.each_pair do |field, text|
+      DescriptionIndex.trigrams(text).each do |gram|
+        next unless mask = @grams[field][gram]
+        if (mask &= ~(1 << id)) == 0 then @grams[field].delete(gram); else @grams[field][gram] = mask; end
+      end
+    end
+    @every_id = nil; @dirty = true
+  end # remove
+end # DescriptionIndex
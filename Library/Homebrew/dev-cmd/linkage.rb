@@ -1,6 +1,7 @@
 #:Check the library links of an installed formula.
 #:
 #:  Usage:    linkage [--test | --reverse] <formula>
+#:            linkage --all [--test] [--jobs=<n>]
 #:
 #:<formula> must be installed or an error is raised.
 #:
@@ -9,24 +10,53 @@
 #:
 #:If `--reverse` is passed, for each dynamic library the keg references, print
 #:its name and which of the keg’s binaries link to it.
+#:
+#:If `--all` is passed, check every installed keg.  The kegs are shared out
+#:amongst <n> worker processes (by default, one per CPU core), all of which use
+#:the same Cellar‐wide linkage index; the results are printed in keg order.
 
 require "macos/linkage_checker"
+require "stringio"
 
 module Homebrew
   module_function
 
   def linkage
+    return linkage_all if ARGV.include?("--all")
     ARGV.kegs.each do |keg|
       ohai "Checking #{keg.name} linkage" if ARGV.kegs.size > 1
       result = LinkageChecker.new(keg)
       if ARGV.include?("--test")
         result.display_test_output
-        Homebrew.failed = true if result.broken_dylibs?
+        Homebrew.failed = true if result.broken_dylibs.any?
       elsif ARGV.include?("--reverse")
         result.display_reverse_output
       else
         result.display_normal_output
       end
     end
-  end
-end
+  end # linkage
+
+  def linkage_all
+    index = LinkageIndex.instance  # Build or freshen it once, before forking, so every worker inherits it.
+    jobs = (ARGV.value("jobs") || CPU.cores).to_i
+    kegs = index.keg_paths.map { |p| Keg.new(p) }
+    reports = Utils.parallel_map(kegs, jobs) do |keg|
+      out = $stdout
+      $stdout = StringIO.new
+      begin
+        result = LinkageChecker.new(keg, nil, index)
+        if ARGV.include?("--test") then result.display_test_output; else result.display_normal_output; end
+        [$stdout.string, result.broken_dylibs.any?]
+      ensure
+        $stdout = out
+      end
+    end # parallel_map |keg|
+    kegs.zip(reports).each do |keg, (text, broken)|
+      next if text.empty?
+      ohai "#{keg.name} #{keg.version}"
+      puts text
+      Homebrew.failed = true if broken
+    end
+  end # linkage_all
+end # Homebrew
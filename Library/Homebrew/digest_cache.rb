@@ -0,0 +1,91 @@
+require 'checksum'
+require 'utils/fork'
+
+# Remembers the digests of files in HOMEBREW_CACHE, so that a download is hashed once – ideally while it arrives (see {Tee}) – and
+# never again for as long as it is unchanged.  Each cached file’s digests are kept in a like‐named file under HOMEBREW_CACHE/.digests,
+# headed by the file’s size, mtime & inode number; if any of those differ, the record is ignored and the file hashed afresh.
+module DigestCache
+  HASHERS = { :sha1 => ['digest/sha1', 'SHA1'], :sha256 => ['digest/sha2', 'SHA256'] }
+
+  # Feeds every chunk written through it to a digest of each checksum type as well as to the output.
+  class Tee
+    # If “prefix” names an existing file (e.g. a partial download about to be resumed), its contents are hashed first.
+    def initialize(io, prefix = nil)
+      @io = io
+      @digests = {}
+      Checksum::TYPES.each{ |type| @digests[type] = DigestCache.digest_class(type).new }
+      prefix.open('rb') { |f| buf = ''; self.digest(buf) while f.read(FileUtils::FILE_BUFSIZE, buf) } if prefix and prefix.file?
+    end
+
+    def write(chunk); @io.write(chunk); digest(chunk); end
+
+    def digest(chunk); @digests.each_value{ |d| d << chunk }; end
+
+    # A hash of checksum type => hexadecimal digest, of everything written so far.
+    def hexdigests
+      h = {}
+      @digests.each_pair{ |type, d| h[type] = d.hexdigest }
+      h
+    end
+  end # Tee
+
+  module_function
+
+  def digest_class(type)
+    lib, name = HASHERS.fetch(type)
+    require lib
+    Digest.const_get(name)
+  end
+
+  # Only files directly within HOMEBREW_CACHE have their digests remembered.
+  def cacheable?(path); File.expand_path(path.dirname.to_s) == File.expand_path(HOMEBREW_CACHE.to_s); end
+
+  def dir; HOMEBREW_CACHE/'.digests'; end
+
+  def record_path(path); dir/path.basename.to_s; end
+
+  def stamp(path); st = path.stat; "#{st.size} #{st.mtime.to_i} #{st.ino}"; end
+
+  # The remembered digests of an unchanged file, as a hash of checksum type => hexadecimal digest; empty if there are none.
+  def remembered(path)
+    return {} unless cacheable?(path) and (rec = record_path(path)).file?
+    lines = rec.read.split("\n")
+    return {} unless lines.shift == stamp(path)
+    h = {}
+    lines.each{ |line| type, hex = line.split(' ', 2); h[type.to_sym] = hex if HASHERS[type.to_sym] }
+    h
+  rescue SystemCallError
+    {}
+  end # remembered
+
+  # Remember the given digests (a hash of checksum type => hexadecimal digest) for a file, alongside any already remembered.
+  def remember(path, digests)
+    return unless cacheable?(path)
+    digests = remembered(path).merge(digests)
+    dir.mkpath
+    record_path(path).atomic_write([stamp(path), *digests.map{ |type, hex| "#{type} #{hex}" }].join("\n") + "\n")
+  rescue SystemCallError
+    # Not being able to remember is no reason to fail.
+  end # remember
+
+  # The digest of the given type for a file, as remembered if the file is unchanged, else computed (& then remembered).
+  def digest(path, type)
+    unless hex = remembered(path)[type]
+      hex = path.incremental_hash(digest_class(type))
+      remember(path, type => hex)
+    end
+    hex
+  end # digest
+
+  # Compute & remember the digests of many files at once, with the files shared out amongst forked workers.  Files whose digests
+  # are already remembered are skipped.
+  def prime(paths, jobs = nil)
+    todo = paths.select{ |p| p.file? and cacheable?(p) and not Checksum::TYPES.all?{ |type| remembered(p)[type] } }
+    return if todo.empty?
+    unless jobs
+      require 'cpu'
+      jobs = CPU.cores
+    end
+    Utils.parallel_map(todo, jobs){ |p| Checksum::TYPES.each{ |type| digest(p, type) }; nil }
+  end # prime
+end # DigestCache
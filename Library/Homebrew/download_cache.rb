@@ -0,0 +1,152 @@
+require 'pathname'
+
+# Stores downloads by content.  Each finished download is moved to HOMEBREW_CACHE/blobs/<xx>/<SHA-256>, & its usual name‐based entry
+# (`<name>-<version><ext>`) becomes a symbolic link to that blob.  A second download whose content matches – the same tarball under
+# another formula’s name, or from another mirror – is then discarded in favour of the existing blob, & a fetch whose expected SHA-256
+# is already stored needn’t download anything at all.
+#
+# Each use of a blob is appended to an access log.  When $HOMEBREW_CACHE_BUDGET is set (e.g. “20G”), blobs are evicted, least
+# recently used first, until the store fits within it:  After each download, and by `brew cleanup`.  Evicting a blob also removes
+# the entries pointing at it, so the next fetch of any of them simply downloads it again.
+#
+# Concurrent `brew` processes can share the cache:  Blobs & entries only ever appear by atomic renames; appends to the log happen
+# under a shared lock, & eviction (which rewrites the log) under an exclusive one; and blobs used in the last GRACE seconds are never
+# evicted, lest another process be about to read them.  A process already reading a blob is unaffected by its eviction.
+module DownloadCache
+  BLOB_DIR = HOMEBREW_CACHE/'blobs'
+  LOG_FILE = HOMEBREW_CACHE/'blobs.log'
+  LOCK_FILE = HOMEBREW_CACHE/'blobs.lock'
+  GRACE = 3600  # seconds
+
+  module_function
+
+  def blob_path(sha256); BLOB_DIR/sha256[0, 2]/sha256; end
+
+  # Whether “path” (a child of HOMEBREW_CACHE) is part of the store’s own machinery, rather than a download.
+  def own?(path); [BLOB_DIR, LOG_FILE, LOCK_FILE].any?{ |p| p.to_s == path.to_s }; end
+
+  # The blob an entry points at; nil if it is not a link into the store.
+  def blob_of(entry)
+    return unless entry.symlink?
+    target = (entry.dirname/entry.readlink).cleanpath
+    target if File.expand_path(target.dirname.dirname.to_s) == File.expand_path(BLOB_DIR.to_s)
+  end
+
+  # Points “entry” at “blob”, replacing whatever was there.
+  def link(entry, blob)
+    temp = entry.dirname/".#{entry.basename}.#{$$}.link"
+    temp.unlink if temp.symlink?
+    File.symlink(blob.relative_path_from(entry.dirname).to_s, temp.to_s)
+    File.rename(temp.to_s, entry.to_s)
+  end # DownloadCache::link
+
+  # If a blob with the given SHA-256 is stored, points “entry” at it & returns true.
+  def adopt(entry, sha256)
+    return false unless sha256 and (blob = blob_path(sha256)).file?
+    link(entry, blob) unless blob_of(entry) == blob
+    note_use(blob)
+    true
+  end # DownloadCache::adopt
+
+  # Moves the newly‐downloaded file “entry” into the store – or, if an identical blob is already there, discards it – & points
+  # “entry” at the blob.  Returns the blob.
+  def store(entry, sha256)
+    blob = blob_path(sha256)
+    blob.dirname.mkpath
+    if blob.file? then entry.unlink
+    else File.rename(entry.to_s, blob.to_s); end
+    link(entry, blob)
+    note_use(blob)
+    blob
+  end # DownloadCache::store
+
+  # Logs a use of “blob”.  Failing to is no reason to fail anything else.
+  def note_use(blob)
+    locked(File::LOCK_SH) { LOG_FILE.open('a') { |f| f.puts "#{Time.now.to_i} #{blob.basename}" } }
+  rescue SystemCallError
+    nil
+  end
+
+  # The octet budget set by $HOMEBREW_CACHE_BUDGET – a number of octets, optionally suffixed by K, M, G or T – or nil.
+  def budget
+    return unless (v = ENV['HOMEBREW_CACHE_BUDGET'].choke) and v =~ /^(\d+(?:\.\d+)?)\s*([kmgt]?)i?b?$/i
+    ($1.to_f * 1024 ** ' kmgt'.index($2.empty? ? ' ' : $2.downcase)).to_i
+  end
+
+  def blobs; Dir[(BLOB_DIR/'??/*').to_s].map{ |p| Pathname(p) }.select(&:file?); end
+
+  # The time each blob was last used, by name, from the log; or, for any the log doesn’t mention, its mtime.
+  def last_used
+    used = {}
+    LOG_FILE.read.each_line{ |line| t, hex = line.split; used[hex] = t.to_i if hex and t.to_i > used[hex].to_i } if LOG_FILE.file?
+    blobs.each{ |b| used[b.basename.to_s] ||= b.mtime.to_i }
+    used
+  end # DownloadCache::last_used
+
+  # Every entry pointing into the store, by the path of its blob.
+  def referrers
+    refs = {}
+    return refs unless HOMEBREW_CACHE.directory?
+    HOMEBREW_CACHE.children.each do |c|
+      blob = blob_of(c)
+      (refs[blob.to_s] ||= []) << c if blob
+    end
+    refs
+  end
+
+  # Evicts the least recently used blobs, & the entries pointing at them, until the store fits within “limit” octets; or, with
+  # “:orphans”, also evicts every blob no entry points at.  Blobs used in the last GRACE seconds are spared.  Unless “:wait”, gives
+  # up at once if another process is evicting.  Returns the octets freed.
+  def evict(limit = budget, options = {})
+    return 0 unless limit or options[:orphans]
+    mode = options[:wait] ? File::LOCK_EX : File::LOCK_EX | File::LOCK_NB
+    locked(mode) do
+      used = last_used
+      refs = referrers
+      now = Time.now.to_i
+      all = blobs.map{ |b| [b, b.size, used[b.basename.to_s]] }.sort_by{ |_, _, t| t }
+      total = all.inject(0){ |sum, (_, size, _)| sum + size }
+      freed = 0
+      all.each do |b, size, t|
+        next if t > now - GRACE
+        next unless (limit and total - freed > limit) or (options[:orphans] and not refs[b.to_s])
+        (refs[b.to_s] || []).each{ |entry| entry.unlink }
+        b.unlink
+        used.delete(b.basename.to_s)
+        freed += size
+      end
+      LOG_FILE.atomic_write(used.sort_by{ |_, t| t }.map{ |hex, t| "#{t} #{hex}\n" }.join) if LOG_FILE.file? or not used.empty?
+      freed
+    end || 0
+  end # DownloadCache::evict
+
+  # Moves every plain download (anything with a version in its name) in HOMEBREW_CACHE into the store, so that duplicates among them
+  # are stored once.  Returns the octets saved.
+  def absorb
+    require 'digest_cache'
+    saved = 0
+    HOMEBREW_CACHE.children.each do |entry|
+      next if own?(entry) or entry.symlink? or not entry.file? or entry.basename.to_s.starts_with?('.') \
+           or %w[.incomplete .lock .marshal].include?(entry.extname) or not entry.version  # Not a download.
+      sha256 = DigestCache.digest(entry, :sha256)
+      saved += entry.size if blob_path(sha256).file?
+      store(entry, sha256)
+    end
+    saved
+  end # DownloadCache::absorb
+
+  # Removes entries whose blobs have been evicted.
+  def prune_dangling
+    return [] unless HOMEBREW_CACHE.directory?
+    HOMEBREW_CACHE.children.select{ |c| c.symlink? and not c.exist? and blob_of(c) }.each{ |c| c.unlink }
+  end
+
+  # Runs the block while holding the store’s lock in the given mode; nil if the lock was asked for without waiting & is taken.
+  def locked(mode)
+    HOMEBREW_CACHE.mkpath
+    LOCK_FILE.open(File::RDWR | File::CREAT) do |lock|
+      return nil unless lock.flock(mode)
+      yield
+    end
+  end # DownloadCache::locked
+end # DownloadCache
@@ -0,0 +1,166 @@
+require 'uri'
+
+# Fetches (& verifies) every download an installation will need – sources, resources, patches & bottles for a formula and its whole
+# dependency closure – in the background, several at once, while the foreground gets on with building whatever is ready.
+#
+# The work is done by a manager process, forked when the scheduler is started, which in turn forks one worker per download:  No
+# more than “concurrency” at a time, and no more than “per_host” from any one server.  A worker simply calls the item’s own #fetch
+# & #verify_download_integrity, so curl’s `-C` resumption and the fallback to mirrors behave exactly as in the foreground; its
+# output goes to a log file rather than the terminal.  As each worker finishes, the manager reports the outcome down a pipe.
+#
+# The foreground calls #wait_for before it needs an item.  That returns once the item is ready (true), has failed (false), or was
+# never scheduled (nil).  Either way the foreground then fetches & verifies as usual; for an item downloaded in the background this
+# finds the file already cached and its digest already remembered, and for one that failed it retries with the normal output.
+class DownloadScheduler
+  DEFAULT_CONCURRENCY = 4
+  DEFAULT_PER_HOST = 2
+
+  class Job < Struct.new(:key, :item, :host, :log, :pid); end
+
+  class << self
+    # The scheduler currently running, if any.
+    attr_accessor :current
+
+    # Wait for an item, if the current scheduler has it; returns as #wait_for does.
+    def wait_for(item); current.wait_for(item) if current; end
+
+    # The download strategy behind a resource, spec, bottle or patch.
+    def downloader_of(item)
+      if item.respond_to?(:downloader) then item.downloader
+      elsif item.respond_to?(:resource) and item.method(:resource).arity == 0 then item.resource.downloader; end
+    end
+
+    # Only plain file downloads are scheduled; version‐control checkouts are left to the foreground.
+    def schedulable?(item); (dl = downloader_of(item)).is_a?(CurlDownloadStrategy) rescue false; end
+  end # << self
+
+  attr_reader :concurrency, :per_host
+
+  def initialize(concurrency = nil, per_host = nil)
+    @concurrency = (concurrency || ENV['HOMEBREW_DOWNLOAD_CONCURRENCY'] || DEFAULT_CONCURRENCY).to_i
+    @per_host = (per_host || ENV['HOMEBREW_DOWNLOAD_PER_HOST'] || DEFAULT_PER_HOST).to_i
+    @concurrency = 1 if @concurrency < 1
+    @per_host = 1 if @per_host < 1
+    @queue = []   # [Job]s not yet started, in the order added
+    @keys = {}    # key => true, for everything scheduled
+    @status = {}  # key => true (ready) or false (failed), as reported so far
+  end # initialize
+
+  # Schedule an item, unless it is already cached (or scheduled), or isn’t a plain file download.
+  def add(item)
+    return self unless DownloadScheduler.schedulable?(item)
+    key = key_for(item)
+    return self if @keys[key] or item.cached_download.exists?
+    @keys[key] = true
+    host = (URI.parse(item.url.to_s).host rescue nil) || ''
+    @queue << Job.new(key, item, host, nil, nil)
+    self
+  end # add
+
+  def empty?; @keys.empty?; end
+
+  # Fork the manager process & return at once.  Does nothing if there is nothing to fetch.
+  def start
+    return self if @queue.empty?
+    require 'tmpdir'
+    @log_dir = Pathname(Dir.mktmpdir('downloads', HOMEBREW_TEMP.to_s))
+    @queue.each{ |job| job.log = @log_dir/"#{File.basename(job.key)}.log" }
+    rd, wr = IO.pipe
+    @owner = Process.pid
+    @pid = fork do
+      begin
+        rd.close
+        Process.setpgrp  # So that #stop can take the workers down along with the manager.
+        manage(wr)
+      ensure
+        exit! 0
+      end
+    end
+    wr.close
+    @reports = rd
+    @queue = []
+    DownloadScheduler.current = self
+    at_exit { stop }
+    self
+  end # start
+
+  # Block until the given item is ready or has failed.  Returns true or false accordingly, or nil if it wasn’t scheduled here.
+  def wait_for(item)
+    key = key_for(item)
+    return nil unless @keys[key]
+    read_report until @status.has_key?(key) or @reports.nil?
+    unless ok = @status[key]
+      log = @log_dir/"#{File.basename(key)}.log" if @log_dir
+      opoo "Background download of #{File.basename(key)} failed#{"; see #{log}" if log and log.file?}" if DEBUG
+    end
+    !!ok
+  end # wait_for
+
+  # Kill off the manager & any workers, if still running, and tidy up.
+  def stop
+    return unless Process.pid == @owner  # Not from some other forked child.
+    if @pid
+      begin
+        Process.kill('TERM', -@pid)
+        Process.waitpid(@pid)
+      rescue Errno::ESRCH, Errno::ECHILD, Errno::EPERM
+      end
+      @pid = nil
+    end
+    @reports.close if @reports and not @reports.closed?
+    @reports = nil
+    @log_dir.rmtree if @log_dir and @log_dir.directory? and not DEBUG
+    DownloadScheduler.current = nil if DownloadScheduler.current.equal?(self)
+  end # stop
+
+  private
+
+  def key_for(item); item.cached_download.to_s; end
+
+  def read_report
+    if line = @reports.gets
+      key, outcome = line.chomp.split("\t", 2)
+      @status[key] = (outcome == 'ok')
+    else  # The manager has finished, and nothing else will be reported.
+      @reports.close; @reports = nil
+      Process.waitpid(@pid) rescue nil
+      @pid = nil
+    end
+  end # read_report
+
+  # The manager’s loop:  Keep as many workers going as the limits allow, & report on each as it finishes.
+  def manage(out)
+    running = {}  # PID => Job
+    queue = @queue
+    until queue.empty? and running.empty?
+      while running.length < @concurrency and job = next_job(queue, running)
+        job.pid = fork { work(job, out) }
+        running[job.pid] = job
+      end
+      pid = Process.wait
+      next unless job = running.delete(pid)
+      out.puts "#{job.key}\t#{$?.success? ? 'ok' : 'failed'}"
+      out.flush
+    end
+  end # manage
+
+  # The first queued job whose host is below its limit, removed from the queue; or nil.
+  def next_job(queue, running)
+    queue.each_with_index do |job, i|
+      next if running.values.select{ |r| r.host == job.host }.length >= @per_host
+      queue.delete_at(i)
+      return job
+    end
+    nil
+  end # next_job
+
+  def work(job, out)
+    out.close
+    $stdout.reopen(job.log.to_s, 'w'); $stderr.reopen($stdout)
+    job.item.verify_download_integrity(job.item.fetch)
+    exit! 0
+  rescue Exception => e
+    puts "#{e.class}: #{e}"
+    exit! 1
+  end # work
+end # DownloadScheduler
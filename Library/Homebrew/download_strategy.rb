@@ -1,4 +1,5 @@
 require 'utils/json'
+require 'staging_extractor'
 
 class AbstractDownloadStrategy
   include FileUtils
@@ -112,8 +113,30 @@ class VCSDownloadStrategy < AbstractDownloadStrategy
 
   def head?; version.head?; end
 
+  # Whether the formula asked (with “:vcs_metadata => true”) for the VCS’s own metadata – `.git`, `CVS` & the like – to be staged
+  # along with the source, say to run `git describe` during the build.  Otherwise only the source tree is staged.
+  def vcs_metadata?; meta.fetch(:vcs_metadata, false); end
+
   private
 
+  # Copies the checkout at “src” into “dst”, leaving out any directory named in “skip” (unless #vcs_metadata?).  Where the filesystem
+  # can clone files (APFS), they are cloned instead, which costs next to nothing.  Hard links would be cheaper still, but builds
+  # modify sources in place often enough that they would corrupt the cache.
+  def copy_tree(src, dst, *skip)
+    skip = [] if vcs_metadata?
+    if MacOS.version >= :high_sierra and quiet_system('/bin/cp', '-cpR', "#{src}/.", dst.to_s)
+      dst.find{ |pn| if pn != dst and pn.directory? and skip.include?(pn.basename.to_s) then rm_rf pn; Find.prune; end }
+      return
+    end
+    src.find do |pn|
+      Find.prune if pn != src and skip.include?(pn.basename.to_s) and pn.directory? and not pn.symlink?
+      target = dst/pn.relative_path_from(src)
+      if pn.symlink? then ln_sf File.readlink(pn), target
+      elsif pn.directory? then target.mkpath
+      else copy_file(pn, target, true); end
+    end
+  end # VCSDownloadStrategy#copy_tree
+
   def cache_tag; '__UNKNOWN__'; end
 
   def cache_filename; "#{name}--#{cache_tag}"; end
@@ -132,22 +155,22 @@ end # VCSDownloadStrategy
 class AbstractFileDownloadStrategy < AbstractDownloadStrategy
   def stage
     case cached_location.compression_type
-      when :bzip2      then safe_system TAR_PATH, '-xjf', cached_location; chdir                            # Tarred
+      when :bzip2      then StagingExtractor.new(:bzip2).untar(cached_location); chdir                      # Tarred
       when :bzip2_only then buffered_write tool_path('bunzip2', 'bzip2'), '-f', cached_location.to_s, '-c'  # Not tarred
       when :compress,
            :tar        then safe_system TAR_PATH, '-xf', cached_location; chdir
-      when :gzip       then safe_system TAR_PATH, '-xzf', cached_location; chdir                             # Tarred
+      when :gzip       then StagingExtractor.new(:gzip).untar(cached_location); chdir                       # Tarred
       when :gzip_only  then with_system_path { buffered_write('gunzip', '-f', cached_location.to_s, '-c') }  # Not tarred
       when :lha        then safe_system tool_path('lha'), 'x', cached_location
-      when :lzip       then Utils.pipe_to_untar(tool_path('lzip'), cached_location); chdir
+      when :lzip       then StagingExtractor.new(:lzip).untar(cached_location); chdir
       when :p7zip      then safe_system '7zr', 'x', cached_location
 #     when :rpm        then ???  # there is no code path to unpack these
       when :rar        then quiet_safe_system 'unrar', 'x', { :quiet_flag => '-inul' }, cached_location
       when :xar        then safe_system '/usr/bin/xar', '-xf', cached_location
-      when :xz         then Utils.pipe_to_untar(tool_path('xz'), cached_location); chdir
+      when :xz         then StagingExtractor.new(:xz).untar(cached_location); chdir
       when :zip        then with_system_path { quiet_safe_system 'unzip', { :quiet_flag => '-qq' }, cached_location }; chdir
       when :zip_only   then with_system_path { quiet_safe_system 'unzip', { :quiet_flag => '-qq' }, cached_location }
-      when :zstd       then Utils.pipe_to_untar(tool_path('zstd'), cached_location); chdir
+      when :zstd       then StagingExtractor.new(:zstd).untar(cached_location); chdir
                        else cp cached_location.to_s, "#{pwd}/#{cachename}"
     end
   end # AbstractFileDownloadStrategy#stage
@@ -200,9 +223,15 @@ class CurlDownloadStrategy < AbstractFileDownloadStrategy
   end # CurlDownloadStrategy#initialize()
 
   def fetch
+    require 'download_cache'  # Not at the top:  This file is loaded before HOMEBREW_CACHE is defined.
     ohai "Downloading #{@url}"
 
-    unless cached_location.exists?
+    if cached_location.exists?
+      puts "Already downloaded: #{cached_location}"
+      if blob = DownloadCache.blob_of(cached_location) then DownloadCache.note_use(blob); end
+    elsif DownloadCache.adopt(cached_location, expected_sha256)
+      puts "Already downloaded (as #{DownloadCache.blob_of(cached_location).basename}):  #{cached_location}"
+    else
       urls = actual_urls
       unless urls.empty?
         ohai "Downloading from #{urls.last}"
@@ -228,9 +257,12 @@ class CurlDownloadStrategy < AbstractFileDownloadStrategy
           raise CurlDownloadStrategyError, @url
         end
       end
-      ignore_interrupts { temporary_path.rename(cached_location) }
-    else
-      puts "Already downloaded: #{cached_location}"
+      ignore_interrupts do
+        temporary_path.rename(cached_location)
+        DownloadCache.store(cached_location, (@download_digests || {})[:sha256] || DigestCache.digest(cached_location, :sha256))
+        DigestCache.remember(cached_location, @download_digests) if @download_digests
+      end
+      DownloadCache.evict
     end
   rescue CurlDownloadStrategyError
     raise if mirrors.empty?
@@ -245,8 +277,18 @@ class CurlDownloadStrategy < AbstractFileDownloadStrategy
 
   private
 
-  # Private method, can be overridden if needed.
-  def _fetch; curl @url, '-C', downloaded_size, '-o', temporary_path; end
+  # Private method, can be overridden if needed.  Curl’s output is hashed as it is written, so that verifying the finished download
+  # needn’t read it all back in.
+  def _fetch
+    require 'digest_cache'
+    @download_digests = nil
+    offset = downloaded_size
+    temporary_path.open(offset > 0 ? 'ab' : 'wb') do |f|
+      tee = DigestCache::Tee.new(f, (temporary_path if offset > 0))
+      curl_stream(@url, '-C', offset) { |chunk| tee.write(chunk) }
+      @download_digests = tee.hexdigests
+    end
+  end # CurlDownloadStrategy#_fetch
 
   # Curl options to be always passed to curl, with raw head calls (`curl -I`) or with actual `fetch`.
   def _curl_opts; copts = []; copts << '--user' << meta.fetch(:user) if meta.key?(:user); copts; end
@@ -260,7 +302,35 @@ class CurlDownloadStrategy < AbstractFileDownloadStrategy
 
   def downloaded_size; temporary_path.size? || 0; end
 
+  # The SHA-256 the download should have, if the formula gives one.
+  def expected_sha256
+    sum = resource.checksum if resource.respond_to?(:checksum)
+    sum.hexdigest if sum and sum.hash_type == :sha256
+  end
+
   def curl(*args); args.concat _curl_opts; args << '--connect-timeout' << '5' unless mirrors.empty?; super; end
+
+  # As #curl, but with the download sent to standard output, each chunk of which is yielded as it arrives.
+  def curl_stream(*args)
+    args.concat _curl_opts; args << '--connect-timeout' << '5' unless mirrors.empty?
+    args = curl_args(*args).map(&:to_s)
+    rd, wr = IO.pipe
+    pid = fork do
+      begin
+        rd.close
+        $stdout.reopen(wr); wr.close
+        exec(CURL_PATH.to_s, *args)
+      rescue Exception
+        exit! 1
+      end
+    end
+    wr.close
+    buf = ''
+    yield buf while rd.read(FILE_BUFSIZE, buf)
+    rd.close
+    Process.wait(pid)
+    raise ErrorDuringExecution.new(CURL_PATH, args) unless $?.success?
+  end # CurlDownloadStrategy#curl_stream
 end # CurlDownloadStrategy
 
 # Detect and download from Apache Mirror
@@ -433,12 +503,36 @@ class GitDownloadStrategy < VCSDownloadStrategy
     @shallow = meta.fetch(:shallow) { true }
   end # GitDownloadStrategy#initialize()
 
-  def stage; super; cp_r cached_location/'.', Dir.pwd; end
+  def stage
+    super
+    if vcs_metadata? then cp_r File.join(cached_location, '.'), Dir.pwd  # Pathname#/ would drop the “.”
+    else check_out_tree(cached_location, Pathname.pwd); end
+  end # GitDownloadStrategy#stage
 
   private
 
   def cache_tag; 'git'; end
 
+  # Writes out the tree checked out at “src” (& those of its submodules) into “dst”, using a throwaway index, so that the cached
+  # clone is left untouched & none of the repository itself is copied.
+  def check_out_tree(src, dst)
+    git_dir = (src/'.git').to_s
+    index_dir = Pathname(Dir.mktmpdir('stage-index', HOMEBREW_TEMP.to_s))
+    old_index = ENV['GIT_INDEX_FILE']
+    begin
+      ENV['GIT_INDEX_FILE'] = (index_dir/'index').to_s
+      dst.cd { safe_system 'git', '--git-dir', git_dir, '--work-tree', '.', 'checkout', '-q', 'HEAD', '--', '.' }
+    ensure
+      ENV['GIT_INDEX_FILE'] = old_index
+      index_dir.rmtree
+    end
+    Utils.popen_read('git', '--git-dir', git_dir, 'ls-tree', '-r', 'HEAD').each_line do |line|
+      next unless line =~ /^160000 commit [0-9a-f]+\t(.+)$/ and (src/$1/'.git').exist?
+      (dst/$1).mkpath
+      check_out_tree(src/$1, dst/$1)
+    end
+  end # GitDownloadStrategy#check_out_tree
+
   def cache_version; 0; end
 
   def update
@@ -535,7 +629,7 @@ class CVSDownloadStrategy < VCSDownloadStrategy
     end
   end # CVSDownloadStrategy#initialize()
 
-  def stage; cp_r cached_location/'.', Dir.pwd; end
+  def stage; copy_tree(cached_location, Pathname.pwd, 'CVS'); end
 
   private
 
@@ -584,7 +678,7 @@ class BazaarDownloadStrategy < VCSDownloadStrategy
   def initialize(name, resource); super; @url = @url.sub(%r{^bzr://}, ''); end
 
   # The export command doesn't work on checkouts; see https://bugs.launchpad.net/bzr/+bug/897511
-  def stage; cp_r cached_location/'.', Dir.pwd; rm_r '.bzr'; end
+  def stage; copy_tree(cached_location, Pathname.pwd, '.bzr'); end
 
   private
 
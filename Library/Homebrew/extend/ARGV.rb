@@ -197,6 +197,21 @@ module HomebrewArgvExtension
 
   def env; value 'env'; end
 
+  # The architectures to thin installed kegs to:  Those listed as `--thin=`<archs>, or, given `--thin` alone (or $HOMEBREW_THIN),
+  # those this Mac runs natively.  Nil if neither was given.
+  def thin_archs
+    @thin_archs ||= if (arg = find{ |a| a =~ /^--thin=./ }) then archs_from(arg.sub('--thin=', ''))
+                    elsif includes?('--thin') or ENV['HOMEBREW_THIN'].choke then Target.native_archs; end
+  end
+
+  # A list of architecture names, separated by commas or spaces, as an architecture list.
+  def archs_from(list)
+    archs = list.split(/[ ,]+/).reject(&:empty?).map(&:to_sym)
+    unknown = archs - CPU.known_archs
+    raise ArgumentError, "Unknown architecture#{plural(unknown.length)}:  #{unknown.list}" unless unknown.empty?
+    archs.extend(ALE)
+  end # archs_from
+
   def forced_install_type
     # These are only equal if both are absent, i.e., nil (-2); & if --build-from-source is only passed by environment variable (-1),
     # --force-bottle being present in any position will override it.
@@ -251,8 +251,9 @@ class Pathname
   end
 
   # @private
-  def sha1; require 'digest/sha1'; incremental_hash(Digest::SHA1); end
-  def sha256; require 'digest/sha2'; incremental_hash(Digest::SHA256); end
+  def sha1; require 'digest_cache'; DigestCache.digest(self, :sha1); end
+  # Files in HOMEBREW_CACHE are hashed once and then remembered for as long as they are unchanged; see {DigestCache}.
+  def sha256; require 'digest_cache'; DigestCache.digest(self, :sha256); end
 
   def start_with?(other); to_s.start_with?(other.to_s); end
   alias_method :starts_with?, :start_with?
@@ -802,7 +802,8 @@ class Formula
   # An array of all installed racks, as {Pathname}s.
   # @private
   def self.racks
-    @racks ||= (HOMEBREW_CELLAR.directory? ? HOMEBREW_CELLAR.subdirs.reject(&:symlink?) : [])
+    require 'installed_index'
+    @racks ||= InstalledIndex.instance.rack_names.map{ |name| HOMEBREW_CELLAR/name }
   end
 
   # An array of all installed {Formula}e, as {Formula}‐subclass instances.
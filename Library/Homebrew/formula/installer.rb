@@ -1,13 +1,20 @@
 require 'cxxstdlib'
+require 'dependency_graph'
+require 'download_scheduler'
 require 'exceptions'
 require 'formula'
 require 'keg'
+require 'keg_cache'
 require 'tab'  # pulls in `utils/json`
 require 'bottles'
+require 'bottle_pourer'
 require 'caveats'
 require 'cleaner'
 require 'formula/cellar_checks'
 require 'install_renamed'
+require 'install_scheduler'
+require 'installed_index'
+require 'rebase_planner'
 require 'cmd/tap'
 require 'cmd/postinstall'
 require 'hooks/bottles'
@@ -142,6 +149,7 @@ class FormulaInstaller
     unless skip_deps_check?
       deps = compute_dependencies
       check_dependencies_bottled(deps) if pour_bottle? and not MacOS.has_apple_developer_tools?
+      schedule_downloads(deps)
       install_dependencies(deps)
     end
     return if deps_do_only?
@@ -179,8 +187,11 @@ class FormulaInstaller
     # Build from source:
     unless poured_bottle_done?
       install_dependencies(compute_dependencies) if poured_bottle_fail? and not skip_deps_check?
-      build
-      clean
+      unless pour_from_keg_cache
+        build
+        clean
+        @built_from_source = true
+      end
     end
     build_bottle_postinstall if build_bottle?
     ofail "#{formula.full_name} was not successfully installed to #{formula.prefix}" unless formula.installed?
@@ -269,10 +280,29 @@ class FormulaInstaller
       eff_b_opt = effective_build_options_for(dependent)
       if (dep.discretionary? and eff_b_opt.without? dep) or (dep.build? and install_bottle_for? dependent, eff_b_opt)
         Dependency.prune
-      elsif dep.satisfied? then Dependency.skip; end
+      elsif dep.satisfied? then settled_dependency_tree?(dep) ? Dependency.prune : Dependency.skip; end
     end
   end # expand_dependencies
 
+  # Whether everything a satisfied dependency depends on, recursively, is also installed, built for every target architecture,
+  # and free of option‐bearing dependencies.  Such a dependency tree can hold nothing to install, so Dependency::expand need not
+  # load & examine each formula in it.  Answered from the dependency graph; when there is no formula snapshot yet to build that
+  # from, or the graph doesn’t know the dependency, or finds a cycle, the tree is expanded as usual.
+  def settled_dependency_tree?(dep)
+    return false unless FormulaSnapshot.available?
+    graph = DependencyGraph.instance
+    return false unless id = graph[dep.name]
+    closure = graph.closure(id)
+    return false unless (closure & ~graph.installed) == 0
+    graph.ids_in(closure).all? do |member|
+      entry = graph.entry_of(member)
+      archs = Keg.new(entry.prefix).built_archs
+      entry.deps.all?{ |d| d.unreserved_tags.empty? } and Target.archset.all?{ |ta| archs.any?{ |ba| ba == ta } }
+    end
+  rescue DependencyGraph::CircularDependencyError
+    false
+  end # settled_dependency_tree?
+
   # “dependent” is a {Formula}‐subclass instance.
   def effective_build_options_for(dependent)
     opt_args  = dependent.build.used_options
@@ -285,11 +315,46 @@ class FormulaInstaller
     if deps.empty? then puts "All dependencies for #{formula.full_name} are satisfied." if deps_do_only?
     else
       oh1 "Installing dependencies for #{formula.full_name}:  #{TTY.green}#{deps.list}#{TTY.reset}"
-      deps.each{ |dep| install_dependency(dep) }
+      if install_concurrently?(deps) then install_dependencies_concurrently(deps)
+      else deps.each{ |dep| install_dependency(dep) }; end
       @show_install_heading = true
     end
   end # install_dependencies
 
+  # Several dependencies can be installed at once, unless the user must be able to interact with them.
+  def install_concurrently?(deps)
+    deps.length > 1 and not (interactive? or debug? or DEBUG or ENV['HOMEBREW_SERIAL_INSTALLS']) \
+      and InstallScheduler.new.slots > 1
+  end
+
+  # Installs each dependency in a child process of its own, as soon as those of the others it depends on are installed; see
+  # {InstallScheduler}.  This process already holds every formula’s lock (see #lock), and the children keep it for their whole run.
+  # “deps” is an {Array} of {Dependency}s, in the order #expand_dependencies put them.
+  def install_dependencies_concurrently(deps)
+    formulae = deps.map(&:to_formula)
+    scheduler = InstallScheduler.new
+    keys = {}  # name or full name => the full name its job goes by
+    formulae.each{ |df| keys[df.name] = keys[df.full_name] = df.full_name }
+    deps.zip(formulae).each do |dep, df|
+      di = dependency_installer_for(dep, df)
+      after = df.recursive_dependencies.map(&:name) + df.recursive_requirements.map(&:default_formula).compact
+      after = after.map{ |name| keys[name.to_s] }.compact.uniq - [df.full_name]
+      scheduler.add(df.full_name, after, :build => !di.pour_bottle?,
+                    :before => lambda { di.planned_downloads.each{ |item| DownloadScheduler.wait_for(item) } }) do
+        DownloadScheduler.current = nil  # The background downloads’ reports are this process’s to read, not the child’s.
+        install_dependency(dep)
+      end
+    end
+    scheduler.run
+  ensure
+    if scheduler
+      formulae.each{ |df| @@attempted << df if [:done, :failed].include? scheduler.state_of(df.full_name) }
+      Homebrew.failed = true if scheduler.any_flagged?
+    end
+    InstalledIndex.reset!  # The children changed the Cellar behind this process’s back.
+    Target.no_universal_binary
+  end # install_dependencies_concurrently
+
   # Installs the relocation tools (as provided by the cctools formula) as a hard dependency for any formula installed from a bottle
   # when the user has no developer tools.  Invoked unless the formula explicitly sets :any_skip_relocation in its bottle DSL.
   def install_relocation_tools
@@ -317,11 +382,7 @@ class FormulaInstaller
       previously_installed = Keg.new(df.spec_prefix(tss))
       ignore_interrupts { previously_installed.rename }
     end
-    di = DependencyInstaller.new(df)
-    di.options           |= tab.used_options
-    di.options           |= Tab.remap_deprecated_options(df.deprecated_options, dep.options)
-    di.force              = force_source? ? :source : false
-    di.verbosity          = verbosity_full? ? :full : false
+    di = dependency_installer_for(dep, df, tab)
     di.prelude
     oh1 "Installing #{formula.full_name} dependency: #{TTY.green}#{dep.name}#{TTY.reset}"
     di.install
@@ -347,6 +408,32 @@ class FormulaInstaller
     Target.no_universal_binary
   end # install_dependency
 
+  def dependency_installer_for(dep, df = dep.to_formula, tab = Tab.for_formula(df, :active))
+    di = DependencyInstaller.new(df)
+    di.options           |= tab.used_options
+    di.options           |= Tab.remap_deprecated_options(df.deprecated_options, dep.options)
+    di.force              = force_source? ? :source : false
+    di.verbosity          = verbosity_full? ? :full : false
+    di
+  end # dependency_installer_for
+
+  # Queue every download this installation will need – for each dependency to be installed, and for the formula itself – to be
+  # fetched in the background, so that downloading overlaps with building.  See {DownloadScheduler}.
+  def schedule_downloads(deps)
+    return if DownloadScheduler.current or ENV['HOMEBREW_NO_BACKGROUND_DOWNLOADS']
+    scheduler = DownloadScheduler.new
+    deps.each{ |dep| dependency_installer_for(dep).planned_downloads.each{ |item| scheduler.add(item) } }
+    planned_downloads.each{ |item| scheduler.add(item) } unless deps_do_only?
+    scheduler.start
+  rescue StandardError => e
+    opoo "Could not schedule background downloads:  #{e}" if DEBUG
+  end # schedule_downloads
+
+  # The resources, specs, bottles & patches this installer will fetch, as things stand.
+  def planned_downloads; pour_bottle? ? [formula.bottle] : source_downloads; end
+
+  def source_downloads; [formula.active_spec] + formula.resources + formula.patchlist.select(&:external?); end
+
   def caveats
     return if deps_do_only?
     audit_installed if DEVELOPER and not formula.keg_only?
@@ -361,8 +448,12 @@ class FormulaInstaller
     return if deps_do_only?
     ohai 'Finishing up' if verbosity?
     install_plist
-    link(keg = Keg.new(formula.prefix))
+    keg = Keg.new(formula.prefix)
+    thin(keg) unless poured_bottle_done?  # A bottle was thinned as it poured.
+    link(keg)
     fix_install_names(keg) unless poured_bottle_done? and formula.bottle_specification.skip_relocation?
+    store_in_keg_cache(keg) if @built_from_source and @keg_cache and not Homebrew.failed?
+    rebase(keg) if RebasePlanner.wanted? and not build_bottle?
     if formula.post_install_defined?
       if build_bottle?
         ohai 'Not running post_install as we’re building a bottle',
@@ -373,6 +464,7 @@ class FormulaInstaller
     t = Tab.from_file formula.prefix/Tab::FILENAME
     t.build_duration = build_times ? build_times[0] + build_times[1] : nil
     t.write
+    InstalledIndex.rack_changed(formula.rack)
     ohai 'Summary' if verbosity? or show_summary_heading?
     puts summary
     # let's reset Utils.git_available? if we just installed git
@@ -428,6 +520,8 @@ class FormulaInstaller
   def build_argv; (sanitized_ARGV_options | Options.create(formula.build.effective_formula_flags)).as_flags; end
 
   def build
+    # Any of this build’s inputs still being fetched in the background must be in hand before it starts.
+    source_downloads.each{ |item| DownloadScheduler.wait_for(item) }
     FileUtils.rm_rf(formula.logs)
     @start_time = Time.now
 
@@ -486,6 +580,65 @@ class FormulaInstaller
     raise 'Empty installation' if Dir["#{formula.prefix}/*"].empty?
   end # build
 
+  # Given $HOMEBREW_KEG_CACHE, pour the copy kept of an earlier build identical to this one, if there is one (see KegCache), instead
+  # of building.  Returns whether it did.
+  def pour_from_keg_cache
+    return false unless KegCache.enabled? and keg_cacheable?
+    @keg_cache = KegCache.new(formula, keg_cache_inputs)
+    return false unless @keg_cache.hit?
+    ohai "Pouring #{@keg_cache.path.basename} from the keg cache"
+    @keg_cache.pour
+    true
+  rescue Exception => e
+    # Any exceptions must leave us with nothing new installed.
+    ignore_interrupts do
+      formula.prefix.rmtree if formula.prefix.directory?
+      formula.rack.rmdir_if_possible
+    end
+    raise if e.is_a? Interrupt
+    onoe e.message
+    ohai e, e.backtrace if debug?
+    opoo 'Pouring from the keg cache failed:  Building from source.'
+    false
+  end # pour_from_keg_cache
+
+  # Builds that depend on something no key could capture – an interactive session, a Git checkout, a moving HEAD – or that leave the
+  # keg in some unusual state are never cached.
+  def keg_cacheable?; not (build_bottle? or debug? or git? or interactive? or formula.head?); end
+
+  # Everything the result of building this formula could depend on, for KegCache:  The formula file itself, the options & build
+  # mode, the compiler, the architectures, this Mac, & the installed version, architectures & options of each dependency & aid.
+  def keg_cache_inputs
+    require 'digest/sha2'
+    compiler = ARGV.cc || (CompilerSelector.select_for(formula) rescue nil)
+    installed = lambda do |f|
+      next "#{f.full_name} -" unless f.opt_prefix.directory?
+      keg = Keg.new(f.opt_prefix.resolved_path)
+      tab = Tab.for_keg(keg.path)
+      "#{f.full_name} #{keg.version} #{tab.built_archs.map(&:to_s).sort * ','} #{tab.used_options.as_flags.sort * ' '}"
+    end
+    deps = formula.recursive_dependencies.map{ |dep| (installed.call(dep.to_formula) rescue "#{dep.name} ?") }
+    { 'formula'  => formula.full_name,
+      'version'  => formula.pkg_version.to_s,
+      'spec'     => (formula.devel? ? 'devel' : 'stable'),
+      'recipe'   => Digest::SHA256.file(formula.path.to_s).hexdigest,
+      'options'  => (build_argv - %w[--quieter --verbose]).sort * ' ',
+      'compiler' => "#{compiler} #{(CompilerSelector.compiler_version(compiler) if compiler rescue nil)}",
+      'archs'    => "#{ARGV.build_mode} #{Target.archset.map(&:to_s).sort * ','} thin:#{(ARGV.thin_archs || []).map(&:to_s).sort * ','}",
+      'system'   => "#{MacOS.version} #{CPU.type} #{CPU.model}",
+      'deps'     => deps.sort * "\n",
+      'aids'     => (ignore_aids? ? [] : formula.active_enhancements.map{ |aid| installed.call(aid) }).sort * "\n", }
+  end # keg_cache_inputs
+
+  # Keep a copy of the keg as just built, for pour_from_keg_cache to find next time.  Failing to is no reason to fail the install.
+  def store_in_keg_cache(keg)
+    ohai 'Storing a copy in the keg cache' if verbosity?
+    @keg_cache.store(keg)
+  rescue Exception => e
+    opoo "Could not store #{formula.full_name} in the keg cache:  #{e.message}"
+    ohai e, e.backtrace if debug?
+  end # store_in_keg_cache
+
   def link(keg)
     if formula.keg_only?
       begin
@@ -591,6 +744,30 @@ class FormulaInstaller
     @show_summary_heading = true
   end # fix_install_names
 
+  # Given `--thin`, cut the keg’s fat files down to the requested architectures; see Keg#thin.
+  def thin(keg)
+    return unless archs = ARGV.thin_archs
+    ohai "Thinning to #{archs.list}" if verbosity?
+    keg.thin(archs)
+  rescue Exception => e
+    opoo 'The thinning step did not complete successfully'
+    puts 'Still, the installation was successful, so we will link it into your prefix'
+    ohai e, e.backtrace if debug?
+    @show_summary_heading = true
+  end # thin
+
+  # Move the keg’s dylibs to load addresses of their own, so dyld needn’t slide them at launch; see RebasePlanner.
+  def rebase(keg)
+    ohai 'Rebasing dylibs' if verbosity?
+    rewritten = RebasePlanner.run([keg])
+    puts "Rebased #{rewritten.length} dylib#{plural(rewritten.length)}" if verbosity? and not rewritten.empty?
+  rescue Exception => e
+    opoo 'The rebasing step did not complete successfully'
+    puts 'Still, the installation was successful; its dylibs will simply load at their old addresses'
+    ohai e, e.backtrace if debug?
+    @show_summary_heading = true
+  end # rebase
+
   def clean
     ohai 'Cleaning' if verbosity?
     Cleaner.new(formula).clean
@@ -621,18 +798,28 @@ class FormulaInstaller
       downloader = LocalBottleDownloadStrategy.new(bottle_path)
     else
       downloader = formula.bottle
+      DownloadScheduler.wait_for(downloader)
       downloader.verify_download_integrity(downloader.fetch)
     end
-    HOMEBREW_CELLAR.cd do
-      downloader.stage
-    end
-
     keg = Keg.new(formula.prefix)
-    keg.relocate_install_names Keg::PREFIX_PLACEHOLDER, HOMEBREW_PREFIX.to_s,
-                               Keg::CELLAR_PLACEHOLDER, HOMEBREW_CELLAR.to_s \
-      unless formula.bottle_specification.skip_relocation?
-    keg.relocate_text_files Keg::PREFIX_PLACEHOLDER, HOMEBREW_PREFIX.to_s,
-                            Keg::CELLAR_PLACEHOLDER, HOMEBREW_CELLAR.to_s
+    if BottlePourer.pourable?(downloader.cached_location)
+      # Text files are relocated as they stream out of the bottle; only the Mach-O files found to need it are left to edit.
+      ohai "Pouring #{downloader.cached_location.basename}"
+      pourer = BottlePourer.new(downloader.cached_location, HOMEBREW_CELLAR).thin_to(ARGV.thin_archs).pour
+      keg.relocate_install_names Keg::PREFIX_PLACEHOLDER, HOMEBREW_PREFIX.to_s,
+                                 Keg::CELLAR_PLACEHOLDER, HOMEBREW_CELLAR.to_s, pourer.mach_o_files \
+        unless formula.bottle_specification.skip_relocation?
+    else
+      HOMEBREW_CELLAR.cd do
+        downloader.stage
+      end
+      keg.thin_files(ARGV.thin_archs) if ARGV.thin_archs
+      keg.relocate_install_names Keg::PREFIX_PLACEHOLDER, HOMEBREW_PREFIX.to_s,
+                                 Keg::CELLAR_PLACEHOLDER, HOMEBREW_CELLAR.to_s \
+        unless formula.bottle_specification.skip_relocation?
+      keg.relocate_text_files Keg::PREFIX_PLACEHOLDER, HOMEBREW_PREFIX.to_s,
+                              Keg::CELLAR_PLACEHOLDER, HOMEBREW_CELLAR.to_s
+    end
 
     Pathname.glob("#{formula.bottle_prefix}/{etc,var}/**/*") do |path|
       path.extend(InstallRenamed)
@@ -649,6 +836,7 @@ class FormulaInstaller
     tab.tap = formula.tap
     tab.poured_from_bottle = true
     tab.write
+    keg.record_thinning(ARGV.thin_archs) if ARGV.thin_archs
   end # pour
 
   def audit_check_output(output)
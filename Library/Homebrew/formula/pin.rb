@@ -1,4 +1,5 @@
 require "keg"
+require "installed_index"
 
 class FormulaPin
   def initialize(f); @f = f; end
@@ -9,11 +10,12 @@ class FormulaPin
     PINDIR.mkpath
     version_path = @f.rack/version
     path.make_relative_symlink(version_path) unless pinned? or not version_path.exists?
+    InstalledIndex.rack_changed(@f.rack)
   end
 
   def pin; pin_at(@f.rack.subdirs.map{ |d| Keg.new(d).version }.first); end
 
-  def unpin; path.unlink if pinned?; PINDIR.rmdir_if_possible; end
+  def unpin; path.unlink if pinned?; PINDIR.rmdir_if_possible; InstalledIndex.rack_changed(@f.rack); end
 
   def pinned?; path.symlink?; end
 
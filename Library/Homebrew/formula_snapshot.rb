@@ -0,0 +1,230 @@
+require 'formula'
+require 'readall_cache'
+
+# A precompiled record of every available formula’s static metadata – names & aliases, versions, description, dependencies (with
+# their tags), requirements, options, and bottle tags – so that read‐only commands can answer most questions without evaluating
+# hundreds of formula files.
+#
+# The snapshot is a single Marshal file in HOMEBREW_CACHE, read in one go.  Where Descriptions::cache_fresh? compares the cache’s
+# mtime with those of the repositories, this compares each formula file’s mtime with the one recorded for it, so that only files
+# which changed (or are new) are evaluated again.  Formulæ that fail to load are remembered as such until their files change.  What a
+# formula evaluates to also depends on Homebrew’s own code, so the whole snapshot is stamped as `brew readall`’s record is (see
+# ReadallCache::library_stamp), & is rebuilt from scratch when that changes.
+class FormulaSnapshot
+  SNAPSHOT_FILE = HOMEBREW_CACHE/'formula_snapshot.marshal'
+  FORMAT_VERSION = 1
+
+  class << self
+    def instance; @instance ||= load.refresh; end
+
+    def reset!; @instance = nil; end
+
+    # Whether a snapshot has already been built, so that using it won’t mean evaluating every formula first.
+    def available?; not @instance.nil? or SNAPSHOT_FILE.file?; end
+
+    def load
+      data = SNAPSHOT_FILE.open('rb') { |f| Marshal.load(f) } if SNAPSHOT_FILE.file?
+      new(data)
+    rescue StandardError
+      new  # A corrupt or foreign snapshot is simply regenerated.
+    end
+
+    # The facts we keep about one formula.  Only the active (default) spec is recorded for dependencies, requirements & options,
+    # because that is what every read‐only command consults.
+    def record_for(f, mtime)
+      deps = []
+      f.deps.each do |dep|
+        if dep.group_dep? then dep.subdeps.each{ |sub| deps << [sub.name, sub.tags.to_a] }
+        else deps << [dep.name, dep.tags.to_a]; end
+      end
+      bottle_spec = f.stable.bottle_specification if f.stable
+      { 'name'         => f.name,
+        'full_name'    => f.full_name,
+        'mtime'        => mtime,
+        'desc'         => f.desc,
+        'oldname'      => f.oldname,
+        'revision'     => f.revision,
+        'version'      => f.version.to_s,
+        'pkg_version'  => f.pkg_version.to_s,
+        'stable'       => (f.stable.version.to_s if f.stable),
+        'devel'        => (f.devel.version.to_s if f.devel),
+        'head'         => !f.head.nil?,
+        'keg_only'     => f.keg_only?,
+        'deps'         => deps,
+        'requirements' => f.requirements.map{ |req| [req.name, req.default_formula, req.tags.to_a] },
+        'options'      => f.options.map{ |opt| [opt.flag, opt.description] },
+        'bottle_tags'  => (bottle_spec ? bottle_spec.collector.keys.map(&:to_s) : []), }
+    end # FormulaSnapshot::record_for
+  end # << self
+
+  # A light stand‐in for a loaded {Formula}, answering from the snapshot.  Call #to_formula for the real thing.
+  class Entry
+    attr_reader :path
+
+    def initialize(path, record); @path = Pathname(path); @r = record; end
+
+    # Stands in for a {SoftwareSpec} where only its version is wanted (as in `f.devel.version`).
+    SpecVersion = Struct.new(:version)
+
+    %w[name full_name desc oldname revision options bottle_tags].each do |field|
+      define_method(field) { @r[field] }
+    end
+
+    def stable; SpecVersion.new(Version.new(@r['stable'])) if @r['stable']; end
+
+    def devel; SpecVersion.new(Version.new(@r['devel'])) if @r['devel']; end
+
+    def head?; @r['head']; end
+
+    def keg_only?; @r['keg_only']; end
+
+    def version; Version.new(@r['version']); end
+
+    def pkg_version; PkgVersion.parse(@r['pkg_version']); end
+
+    def tap
+      if path.to_s =~ HOMEBREW_TAP_DIR_REGEX then "#{$1}/#{$2}"
+      elsif path == Formulary.core_path(name) then 'gsteemso/leopardbrew'; end
+    end
+
+    # The formula’s dependencies, as {Dependency} objects; requirements with default formulæ are not included.
+    def deps; @deps ||= @r['deps'].map{ |name, tags| Dependency.new(name, tags) }; end
+
+    # The formula’s requirements, as [name, default formula, tags] triples.
+    def requirements; @r['requirements']; end
+
+    # The formula names this one depends on, counting requirements’ default formulæ, with the tags of each.
+    def dependency_names_with_tags
+      @r['deps'] + @r['requirements'].select{ |_, default, _| default }.map{ |_, default, tags| [default, tags] }
+    end
+
+    def rack; HOMEBREW_CELLAR/name; end
+
+    def prefix; rack/@r['pkg_version']; end
+
+    def installed?; Formula.is_installed_prefix?(prefix); end
+
+    def any_version_installed?; rack.directory? and rack.subdirs.any?{ |keg| Formula.is_installed_prefix?(keg) }; end
+
+    def to_formula; Formulary.factory(path.to_s); end
+
+    def to_s; name; end
+  end # Entry
+
+  def initialize(data = nil)
+    @stamp = ReadallCache.library_stamp
+    data = nil unless data.is_a?(Hash) and data[:format] == FORMAT_VERSION and data[:library] == HOMEBREW_LIBRARY.to_s and
+                      data[:stamp] == @stamp
+    @current = !data.nil?
+    @records = data ? data[:records] : {}  # formula path => record, or [mtime] for a file that failed to load
+    @aliases = data ? data[:aliases] : {}  # alias (short & fully‐qualified) => formula path
+    @dirty = data.nil?
+  end # initialize
+
+  # Whether this was loaded from a snapshot that is still good for the running code, rather than started afresh.  Only then is
+  # #refresh_files enough to bring it up to date.
+  def current?; @current; end
+
+  # Reëvaluate whichever formula files are new or have changed since they were last recorded, & forget the ones that are gone.
+  def refresh
+    seen = {}
+    Formula.files.each do |file|
+      seen[key = file.to_s] = true
+      mtime = file.mtime.to_i
+      next if (old = @records[key]) and (old.is_a?(Hash) ? old['mtime'] : old[0]) == mtime
+      @records[key] = evaluate(key, mtime)
+      @dirty = true
+    end
+    (@records.keys - seen.keys).each{ |key| @records.delete(key); @dirty = true }
+    refresh_aliases
+  end # refresh
+
+  # Like #refresh, but for just the given formula files – say, those `brew update` saw change – rather than walking every one:
+  # Reëvaluate each that exists, & forget each that doesn’t.
+  def refresh_files(files)
+    files.map(&:to_s).uniq.each do |key|
+      if File.file?(key) then @records[key] = evaluate(key, File.mtime(key).to_i)
+      else @records.delete(key); end
+      @dirty = true
+    end
+    @entries = @by_name = nil
+    refresh_aliases
+  end # refresh_files
+
+  def save
+    return self unless @dirty
+    HOMEBREW_CACHE.mkpath
+    SNAPSHOT_FILE.atomic_write Marshal.dump(:format => FORMAT_VERSION, :library => HOMEBREW_LIBRARY.to_s, :stamp => @stamp,
+                                            :records => @records, :aliases => @aliases)
+    @dirty = false
+    self
+  end # save
+
+  # Every recorded formula, as {Entry} objects sorted by full name.
+  def entries
+    @entries ||= @records.map{ |path, r| Entry.new(path, r) if r.is_a?(Hash) }.compact.sort_by(&:full_name)
+  end
+
+  # Looks up a formula by name, fully‐qualified name, or alias.  Returns nil for anything not (or not loadably) in the snapshot.
+  def [](ref)
+    ref = ref.to_s
+    @by_name ||= begin
+        h = {}
+        entries.each{ |e| h[e.full_name.downcase] = e; h[e.name.downcase] ||= e }
+        h
+      end
+    return @by_name[ref.downcase] if @by_name[ref.downcase]
+    if (path = @aliases[ref]) and (r = @records[path]).is_a?(Hash) then Entry.new(path, r); end
+  end # []
+
+  # Entries for every formula with a rack in the Cellar.  Where formulæ from more than one tap share a rack name, the one chosen is
+  # that which the rack’s active keg was installed from, as Formulary::from_rack would choose it; only a keg whose receipt names no
+  # tap falls back on the core formula.  A rack whose formula is no longer available is left out.
+  def installed
+    require 'installed_index'
+    index = InstalledIndex.instance
+    by_name = {}
+    entries.each{ |e| (by_name[e.name] ||= []) << e }
+    index.rack_names.map{ |name|
+      next unless candidates = by_name[name]
+      tap = ((rack = index.rack(name)) and (keg = rack.active_keg)) ? keg.tap : nil
+      core = candidates.detect{ |e| e.tap == 'gsteemso/leopardbrew' }
+      if not tap then core || candidates.first
+      elsif CORE_OWNERS.include? tap then core
+      else candidates.detect{ |e| e.tap and e.tap.sub('homebrew-', '').downcase == tap.sub('homebrew-', '').downcase }; end
+    }.compact.sort_by(&:full_name)
+  end # installed
+
+  def alias_names; @aliases.keys.sort; end
+
+  private
+
+  def evaluate(key, mtime)
+    self.class.record_for(Formulary.factory(key), mtime)
+  rescue StandardError, ScriptError => e
+    opoo "Failed to import:  #{key}\n#{e}" if DEBUG
+    [mtime]
+  end # evaluate
+
+  def refresh_aliases
+    aliases = gather_aliases
+    @dirty = true unless aliases == @aliases
+    @aliases = aliases
+    save
+  end
+
+  def gather_aliases
+    aliases = {}
+    Pathname.glob("#{HOMEBREW_LIBRARY}/Aliases/*").each do |a|
+      if target = (a.resolved_path.cleanpath.to_s rescue nil) then aliases[a.basename.to_s] = target; end
+    end
+    Tap.each do |tap|
+      tap.alias_files.each do |a|
+        next unless target = (a.resolved_path.cleanpath.to_s rescue nil)
+        aliases["#{tap.name}/#{a.basename}"] = target
+        aliases[a.basename.to_s] ||= target
+      end
+    end
+    aliases
+  end # gather_aliases
+end # FormulaSnapshot
@@ -207,12 +207,18 @@ class Formulary
 
   # Return a Formula instance for the given rack.  Auto‐resolves the formula’s spec when the requested spec is nil.
   def self.from_rack(rack, spec = nil)
-    kegs = rack.directory? ? rack.subdirs.map { |d| Keg.new(d) } : []
-
-    keg = kegs.detect(&:optlinked?) || kegs.detect(&:linked?) || kegs.max_by(&:version)
+    if rack.dirname.to_s == HOMEBREW_CELLAR.to_s
+      # The installed‐state index already knows which keg is active, & what its receipt says.  (Its entry answers #tap & #spec just
+      # as a Tab would.)
+      require 'installed_index'
+      keg = (entry = InstalledIndex.instance.rack(rack.basename.to_s)) ? entry.active_keg : nil
+    else
+      kegs = rack.directory? ? rack.subdirs.map { |d| Keg.new(d) } : []
+      keg = kegs.detect(&:optlinked?) || kegs.detect(&:linked?) || kegs.max_by(&:version)
+    end
     return factory(rack.basename.to_s, spec || :stable) unless keg
 
-    tab = Tab.for_keg(keg)
+    tab = keg.is_a?(Keg) ? Tab.for_keg(keg) : keg
     tap = tab.tap if tab
     spec ||= tab.spec if tab
 
@@ -128,15 +128,23 @@ require 'compat' unless NO_COMPAT
 # Customizeable environment variables:
 # $HOMEBREW_BUILD_BOTTLE         # Always build a bottle instead of a normal installation (see `extend/ARGV.rb`)
 # $HOMEBREW_BUILD_FROM_SOURCE    # Force building from source even when there is a bottle (see `extend/ARGV.rb`)
+# $HOMEBREW_CACHE_BUDGET         # How large (e.g. “20G”) the download cache may grow before evictions (see `download_cache.rb`)
 # $HOMEBREW_CURL_VERBOSE         # Checked by ::curl() in `utils.rb`; deleted by CurlApacheMirrorDownloadStrategy
 # $HOMEBREW_DEBUG_RUBY           # Set if we’re debugging our interaction with the Ruby that we’re running on
 # $HOMEBREW_FAIL_LOG_LINES       # How many lines of system output to log on failure (see `formula.rb`)
-# $HOMEBREW_MAKE_JOBS            # Used in $MAKEFLAGS, prefixed by “-j”
+# $HOMEBREW_INSTALL_JOBS         # How many dependencies to install at once; default, one per CPU core (see `install_scheduler.rb`)
+# $HOMEBREW_KEG_CACHE            # Keep a copy of each keg built from source, to pour instead of rebuilding (see `keg_cache.rb`)
+# $HOMEBREW_MAKE_JOBS            # Used in $MAKEFLAGS, prefixed by “-j”; shared out when installing concurrently
 # $HOMEBREW_NO_GITHUB_API        # Used by GitHub.open & GitHub.print_pull_requests_matching in `utils.rb`
 # $HOMEBREW_NO_INSECURE_REDIRECT # Tested in CurlDownloadStrategy#fetch if an https → http redirect is encountered.
+# $HOMEBREW_NO_REBASE            # Never move installed dylibs’ load addresses, even on Tiger & Leopard (see `rebase_planner.rb`)
 # $HOMEBREW_PREFER_64_BIT        # Build 64‐bit by default (req’d for Leopard :universal; see `macos.rb`) – “force” to use on Tiger
+# $HOMEBREW_REBASE               # Move installed dylibs’ load addresses apart even after Leopard (see `rebase_planner.rb`)
 # $HOMEBREW_SANDBOX              # hells if I know (see `extend/ARGV.rb`)
+# $HOMEBREW_SERIAL_INSTALLS      # Install dependencies one at a time (see `formula/installer.rb`)
+# $HOMEBREW_THIN                 # Thin installed kegs to this Mac’s native architectures, as with `brew install --thin`
 # $HOMEBREW_UNIVERSAL_MODE       # “native” | “local” | “cross”; if building :universal, do it this way (see `extend/ARGV.rb`)
+# $HOMEBREW_UPDATE_JOBS          # How many taps `brew update` pulls at once; default, 4 (see `cmd/update.rb`)
 # $HOMEBREW_VERBOSE_USING_DOTS   # Print heartbeat dots during long system calls (see `formula.rb`)
 
 # Superenv environment variables:
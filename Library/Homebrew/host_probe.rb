@@ -0,0 +1,124 @@
+# This file is loaded before `global.rb`, so must eschew many brew‐isms at eval time.
+require 'pathname'
+
+# Facts about the host – its CPU, and where & which developer tools are installed – that are costly to learn (each takes at least
+# one subprocess), yet almost never change.  They are learnt once and remembered across `brew` runs in HOMEBREW_CACHE, against a
+# fingerprint of the host:  When the machine has been rebooted (which every OS or hardware change requires) or Xcode or the
+# Command Line Tools have been installed, moved, updated or switched between (with `xcode-select`, or for one run with DEVELOPER_DIR,
+# which `xcode-select` obeys), everything is forgotten and learnt afresh.
+#
+# Every sysctl value CPU wants is read by a single run of `sysctl`, rather than one run per key.
+module HostProbe
+  FORMAT_VERSION = 1
+
+  # The sysctl keys read in one go.  Those found on every version of Mac OS come first, in case an old `sysctl` gives up at the
+  # first key it doesn’t know.
+  SYSCTL_KEYS = %w[
+    hw.cputype
+    hw.cpusubtype
+    hw.cpufamily
+    hw.physicalcpu_max
+    hw.cpu64bit_capable
+    hw.optional.altivec
+    hw.optional.sse3
+    hw.optional.supplementalsse3
+    hw.optional.sse4_1
+    hw.optional.sse4_2
+    hw.optional.aes
+    hw.optional.avx1_0
+    hw.optional.avx2_0
+    machdep.cpu.extmodel
+    machdep.cpu.features
+    machdep.cpu.extfeatures
+    machdep.cpu.leaf7_features
+  ].freeze
+
+  # Rewritten by syslogd at every boot.  (Should it be missing, the boot time is asked of `sysctl` instead.)
+  BOOT_STAMP = '/var/run/syslog.pid'
+
+  # Whatever changes when developer tools are installed, updated, or chosen amongst with `xcode-select`.
+  DEVELOPER_STAMPS = %w[
+    /Applications/Xcode.app
+    /Developer
+    /Library/Developer/CommandLineTools
+    /usr/share/xcode-select/xcode_dir_path
+    /var/db/xcode_select_link
+    /var/db/receipts
+  ].freeze
+
+  extend self
+
+  # The value of a sysctl key, as a string; nil if this host hasn’t got it.
+  def sysctl(key)
+    values = fetch(:sysctl) { probe_sysctl(SYSCTL_KEYS) }
+    return values[key] if values.has_key?(key)
+    fetch("sysctl #{key}") { probe_sysctl([key])[key] }  # Not one of the usual keys; ask for it alone.
+  end # sysctl
+
+  # The remembered value of “key”; or, if there is none, the block’s value, which is then remembered.  Nil is remembered too.
+  def fetch(key)
+    values = state[:values]
+    return values[key] if values.has_key?(key)
+    values[key] = yield
+    save
+    values[key]
+  end # fetch
+
+  # Forget only what this process has loaded, so the cache file is reread on next use.
+  def reset!; @state = nil; end
+
+  def cache_file
+    @cache_file ||= if defined?(HOMEBREW_CACHE) then HOMEBREW_CACHE/'host_probe.marshal'
+                    elsif ENV['HOMEBREW_CACHE'] then Pathname.new(ENV['HOMEBREW_CACHE'])/'host_probe.marshal'
+                    end
+  end # cache_file
+
+  # Parses `sysctl` output (“key: value” lines, or “key = value” on older systems) into a hash.
+  def parse_sysctl(output)
+    h = {}
+    output.each_line{ |line| h[$1] = $2.strip if line =~ /\A([\w.]+)(?::| =) ?(.*)\z/m }
+    h
+  end # parse_sysctl
+
+  # Does stat calls only:  Cheap enough to check on every run.
+  def fingerprint
+    boot = File.exist?(BOOT_STAMP) ? File.mtime(BOOT_STAMP).to_i : Utils.popen_read('/usr/sbin/sysctl', '-n', 'kern.boottime')
+    [boot, ENV['HOMEBREW_OS_VERSION'], DEVELOPER_STAMPS.map{ |p| File.exist?(p) ? File.mtime(p).to_i : nil }, ENV['DEVELOPER_DIR']]
+  end # fingerprint
+
+  private
+
+  def state
+    @state ||= begin
+        fp = fingerprint
+        data = (cache_file and cache_file.file?) ? cache_file.open('rb') { |f| Marshal.load(f) } : nil
+        data = nil unless data.is_a?(Hash) and data[:format] == FORMAT_VERSION and data[:fingerprint] == fp
+        data || { :format => FORMAT_VERSION, :fingerprint => fp, :values => {} }
+      rescue StandardError
+        { :format => FORMAT_VERSION, :fingerprint => fingerprint, :values => {} }  # A corrupt cache is simply started over.
+      end
+  end # state
+
+  # Reads the given keys in one go.  If more than one went unanswered, each is then tried singly, lest an unknown key have made an
+  # old `sysctl` stop short; a key no run answers for is recorded as nil.
+  def probe_sysctl(keys)
+    values = parse_sysctl(Utils.popen_read('/usr/sbin/sysctl', *keys))
+    missing = keys - values.keys
+    if missing.length > 1
+      missing.each{ |k| v = Utils.popen_read('/usr/sbin/sysctl', '-n', k).strip; values[k] = v unless v.empty? }
+    end
+    keys.each{ |k| values[k] = nil unless values.has_key?(k) }
+    values
+  end # probe_sysctl
+
+  # Written whole to a temporary file & renamed into place, so concurrent `brew` runs never see half a cache.
+  def save
+    return unless (file = cache_file)
+    file.dirname.mkpath
+    temp = "#{file}.#{Process.pid}"
+    File.open(temp, 'wb') { |f| Marshal.dump(@state, f) }
+    File.rename(temp, file.to_s)
+  rescue SystemCallError
+    File.unlink(temp) rescue nil  # Not being able to remember is no reason to fail.
+  end # save
+end # HostProbe
@@ -0,0 +1,139 @@
+require 'tmpdir'
+
+# Runs a set of installations – dependency builds & bottle pours – concurrently wherever the dependency graph allows, rather than
+# strictly one after another.
+#
+# Each job names the jobs it must follow.  Whenever a job’s predecessors have all succeeded, it is started in a forked child, up to
+# “slots” jobs at a time.  A build is handed its share of the make‐jobs budget, which is what is left of the budget once builds
+# already running have had theirs, divided amongst the builds starting alongside it; that share reaches `make` as
+# $HOMEBREW_MAKE_JOBS.  Pours are disk‐bound, so take no share.  The children’s output goes to one log file apiece, each of which is
+# copied to the terminal whole once its job has finished, so that concurrent jobs’ output is never interleaved.
+#
+# When a job fails, only the jobs that follow it (directly or otherwise) are cancelled; everything else still runs.  The first
+# failure is re‐raised once every job has finished or been cancelled.
+class InstallScheduler
+  class Job < Struct.new(:name, :after, :build, :before, :work, :jobs, :pid, :state, :log, :error, :failed)
+    def build?; build; end
+  end
+
+  attr_reader :budget, :slots
+
+  # The budget defaults to what `make` would be given for a lone build; the slots, to one per CPU core.
+  def initialize(budget = nil, slots = nil)
+    @budget = (budget || ENV['HOMEBREW_MAKE_JOBS'].nope || 4 * CPU.cores).to_i
+    @slots = (slots || ENV['HOMEBREW_INSTALL_JOBS'].nope || CPU.cores).to_i
+    @budget = 1 if @budget < 1
+    @slots = 1 if @slots < 1
+    @jobs = []    # [Job]s, in the order added
+    @named = {}   # name => Job
+  end # initialize
+
+  # Add a job.  “after” lists the names of jobs it must follow; any not added here are taken to be already done.  With
+  # “:build => true” it is given a share of the make‐jobs budget.  The “:before” proc, if any, runs in this process immediately
+  # before the job is started – for example, to wait on its downloads.  The block runs in the child, & is passed the job’s share.
+  def add(name, after = [], options = {}, &work)
+    raise ArgumentError, "Job #{name} was added twice" if @named[name]
+    job = Job.new(name, after, options[:build], options[:before], work, 0, nil, :waiting)
+    @jobs << job
+    @named[name] = job
+    self
+  end # add
+
+  def empty?; @jobs.empty?; end
+
+  # The state of the named job:  :waiting, :running, :done, :failed or :cancelled.
+  def state_of(name); (job = @named[name]) ? job.state : nil; end
+
+  # The share of the make‐jobs budget the named job was started with.
+  def jobs_of(name); (job = @named[name]) ? job.jobs : nil; end
+
+  # Whether any job that succeeded reported Homebrew.failed (a failed link, say) from its child.
+  def any_flagged?; @jobs.any?(&:failed); end
+
+  # Run every job to completion, failure or cancellation.
+  def run
+    @log_dir = Pathname(Dir.mktmpdir('installs', HOMEBREW_TEMP.to_s))
+    running = {}  # PID => Job
+    ignore_interrupts(:quietly) do  # The children will receive any interrupt, & report it back as their failure.
+      loop do
+        start_ready(running)
+        break if running.empty?
+        pid = Process.wait
+        next unless job = running.delete(pid)
+        finish(job, $?)
+      end
+    end
+    report
+  ensure
+    if @log_dir and @log_dir.directory?
+      if @jobs.any?{ |job| job.state == :failed } or DEBUG then opoo "Installation logs were kept in #{@log_dir}"
+      else @log_dir.rmtree; end
+    end
+  end # run
+
+  private
+
+  # Start as many ready jobs as there are free slots, sharing out whatever budget the running builds have left.
+  def start_ready(running)
+    free = @slots - running.length
+    return if free < 1
+    ready = @jobs.select{ |job| job.state == :waiting and job.after.all?{ |a| (pred = @named[a]).nil? or pred.state == :done } }
+    ready = ready[0, free]
+    return if ready.empty?
+    builds = ready.select(&:build?)
+    spare = @budget - running.values.select(&:build?).inject(0){ |sum, job| sum + job.jobs }
+    builds.each_with_index{ |job, i| job.jobs = [spare / builds.length + (i < spare % builds.length ? 1 : 0), 1].max }
+    ready.each do |job|
+      job.before.call if job.before
+      job.log = @log_dir/"#{job.name.tr('/', '-')}.log"
+      job.state = :running
+      job.pid = fork { work(job) }
+      running[job.pid] = job
+    end
+  end # start_ready
+
+  def work(job)
+    $stdin.reopen('/dev/null')
+    $stdout.reopen(job.log.to_s, 'w'); $stdout.sync = true
+    $stderr.reopen($stdout)
+    ENV['HOMEBREW_MAKE_JOBS'] = job.jobs.to_s if job.build?
+    job.work.call(job.jobs)
+    File.open("#{job.log}.outcome", 'wb') { |f| Marshal.dump(Homebrew.failed?, f) }
+    exit! 0
+  rescue Exception => e
+    e = RuntimeError.new("#{e.class}:  #{e.message}") unless (Marshal.dump(e) rescue nil)
+    File.open("#{job.log}.outcome", 'wb') { |f| Marshal.dump(e, f) } rescue nil
+    exit! 1
+  end # work
+
+  def finish(job, status)
+    outcome = (File.open("#{job.log}.outcome", 'rb') { |f| Marshal.load(f) } rescue nil)
+    $stdout.write(job.log.read) if job.log.file?
+    if status.success? and not outcome.is_a?(Exception)
+      job.state = :done
+      job.failed = outcome
+    else
+      job.state = :failed
+      job.error = outcome.is_a?(Exception) ? outcome \
+                  : RuntimeError.new("Installing #{job.name} failed silently, with status “#{status.exitstatus}”")
+      onoe "#{job.name}:  #{job.error.message}" unless job.error.is_a?(Interrupt)
+      cancel_dependents_of(job)
+    end
+  end # finish
+
+  def cancel_dependents_of(failed)
+    @jobs.each do |job|
+      next unless job.state == :waiting and job.after.include?(failed.name)
+      job.state = :cancelled
+      opoo "Not installing #{job.name}, because #{failed.name} failed"
+      cancel_dependents_of(job)
+    end
+  end # cancel_dependents_of
+
+  def report
+    failures = @jobs.select{ |job| job.state == :failed }
+    return self if failures.empty?
+    raise Interrupt if failures.any?{ |job| job.error.is_a?(Interrupt) }
+    raise failures.first.error
+  end # report
+end # InstallScheduler
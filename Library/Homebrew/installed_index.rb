@@ -0,0 +1,229 @@
+require 'keg'
+require 'tab'
+
+# A persistent record of what is installed:  For every rack, its kegs & which of them are linked, optlinked & pinned; & for every
+# keg, the facts from its install receipt that read‐only commands consult (tap, spec, built archs, options, whether it was poured
+# from a bottle, & what it was built to depend on), along with its size.  `brew list`, `outdated`, `leaves` & `cleanup` (and so
+# Formula::installed) can then answer from the index, without parsing a receipt or resolving an opt or LinkedKegs symlink apiece.
+#
+# The index lives in HOMEBREW_CACHE.  Installing, uninstalling, linking, unlinking, optlinking & pinning each reindex the one rack
+# they touched, as part of the same step.  On reading, only the Cellar’s mtime (for racks come or gone) & the mtime of each rack
+# actually asked about (for kegs come or gone) are checked.  Anything done to the Cellar behind Homebrew’s back is caught by
+# `--rebuild`, which `list`, `outdated`, `leaves` & `cleanup` accept:  It reindexes everything from scratch, & reports which racks
+# had drifted.
+#
+# Each save happens under a lock & is merged, rack by rack, into whatever is on disk by then, so concurrent `brew` processes never
+# undo one another’s updates.
+class InstalledIndex
+  INDEX_FILE = HOMEBREW_CACHE/'installed_index.marshal'
+  LOCK_FILE = HOMEBREW_CACHE/'installed_index.lock'
+  FORMAT_VERSION = 1
+
+  # What is recorded about one keg.  The “stamp” is what must stay the same for the rest to remain valid.
+  class KegEntry < Struct.new(:path, :tap, :spec, :built_archs, :used_options, :poured_from_bottle, :dependencies, :git_head_SHA1,
+                              :size, :file_count, :stamp)
+    def keg; Keg.new(path); end
+
+    def version
+      require 'pkg_version'
+      PkgVersion.parse(File.basename(path, Keg::REINSTALL_SUFFIX))
+    end
+  end # KegEntry
+
+  # What is recorded about one rack.  “linked”, “opt” & “pinned” are the keg paths those records point at, or nil.
+  class RackEntry < Struct.new(:name, :mtime, :kegs, :linked, :opt, :pinned)
+    def path; HOMEBREW_CELLAR/name; end
+
+    def versions; kegs.map(&:version); end
+
+    def keg_at(keg_path); keg_path = keg_path.to_s; kegs.detect{ |k| k.path == keg_path }; end
+
+    def linked_keg; keg_at(linked) if linked; end
+
+    def opt_keg; keg_at(opt) if opt; end
+
+    def pinned_keg; keg_at(pinned) if pinned; end
+
+    # The keg that best represents the rack:  The optlinked one, else the linked one, else the newest.
+    def active_keg; opt_keg or linked_keg or kegs.max_by(&:version); end
+  end # RackEntry
+
+  class << self
+    # The index for the current Cellar, loaded (& freshened) or built as needed – or, if “rebuild” is true, rebuilt and verified.
+    # Commands that accept `--rebuild` pass it in here before anything else consults the index.
+    def instance(rebuild = false)
+      @instance = self.rebuild if rebuild
+      @instance ||= load.refresh
+    end
+
+    def reset!; @instance = nil; end
+
+    # Reindex a rack that was just changed.  Does nothing unless an index has already been built.
+    def rack_changed(rack)
+      return unless @instance or INDEX_FILE.file?
+      (@instance || load).index_rack(rack.basename.to_s).save
+    rescue StandardError => e
+      opoo "Could not update the installed‐state index:  #{e}" if DEBUG
+    end
+
+    # Reindexes every rack from scratch, reports any that the index had got wrong, & returns the new index.
+    def rebuild
+      old = load
+      fresh = new.scan_cellar
+      drifted = (old.rack_names | fresh.rack_names).reject{ |name| old.signature(name) == fresh.signature(name) }
+      if drifted.empty? then ohai 'The installed‐state index was up to date'
+      else opoo "The installed‐state index was out of date for #{drifted.length} rack#{plural(drifted.length)}:",
+                drifted.sort * ' '; end
+      fresh.save(true)
+    end # InstalledIndex::rebuild
+
+    def load
+      new(read)
+    rescue StandardError
+      new  # A corrupt or foreign index is simply rebuilt.
+    end
+
+    def read; INDEX_FILE.open('rb') { |f| Marshal.load(f) } if INDEX_FILE.file?; end
+
+    # Runs the block while holding the index’s lock.
+    def locked
+      HOMEBREW_CACHE.mkpath
+      LOCK_FILE.open(File::RDWR | File::CREAT) do |lock|
+        lock.flock(File::LOCK_EX)
+        yield
+      end
+    end # InstalledIndex::locked
+  end # << self
+
+  def initialize(data = nil)
+    data = nil unless compatible?(data)
+    @racks = data ? data[:racks] : {}  # rack name => RackEntry
+    @cellar_mtime = data ? data[:cellar_mtime] : nil
+    @changed = {}                      # rack name => true, for each rack reindexed (or forgotten) since loading
+    @verified = {}                     # rack name => true, for each rack whose mtime has been checked since loading
+    @cellar_changed = data.nil?
+  end # initialize
+
+  # Notice racks that have come or gone since the Cellar was last looked at.
+  def refresh
+    scan_cellar unless (HOMEBREW_CELLAR.mtime.to_i if HOMEBREW_CELLAR.directory?) == @cellar_mtime
+    save
+  end
+
+  # Index any racks not yet in the index, & forget any no longer in the Cellar.
+  def scan_cellar
+    @cellar_mtime = HOMEBREW_CELLAR.mtime.to_i if HOMEBREW_CELLAR.directory?
+    names = @cellar_mtime ? HOMEBREW_CELLAR.subdirs.reject(&:symlink?).map{ |rack| rack.basename.to_s } : []
+    names.each{ |name| index_rack(name) unless @racks[name] }
+    (@racks.keys - names).each{ |name| forget_rack(name) }
+    @cellar_changed = true
+    self
+  end # scan_cellar
+
+  # The names of every rack, sorted.
+  def rack_names; @racks.keys.sort; end
+
+  # The entry for the named rack, reindexed first if kegs have come or gone; nil if there is no such rack.
+  def rack(name)
+    name = name.to_s
+    unless @verified[name]
+      @verified[name] = true
+      entry = @racks[name]
+      dir = HOMEBREW_CELLAR/name
+      current = (dir.directory? and not dir.symlink?) ? dir.mtime.to_i : nil
+      if current != (entry.mtime if entry) then index_rack(name).save; end
+    end
+    @racks[name]
+  end # rack
+
+  # The entries for every rack, sorted by name.
+  def racks; rack_names.map{ |name| rack(name) }.compact; end
+
+  # The versions installed in the named rack; empty if there is none.
+  def versions(name); (entry = rack(name)) ? entry.versions : []; end
+
+  # What is recorded about the named rack, less the mtimes by which staleness is judged; for comparing one index with another.
+  def signature(name)
+    return unless (entry = @racks[name])
+    [entry.kegs.map{ |k| k.to_a[0..-2] }, entry.linked, entry.opt, entry.pinned]
+  end
+
+  def index_rack(name)
+    dir = HOMEBREW_CELLAR/name
+    unless dir.directory? and not dir.symlink?
+      forget_rack(name)
+      return self
+    end
+    old = @racks[name]
+    kegs = dir.subdirs.map do |keg_dir|
+      stamp = keg_stamp(keg_dir)
+      known = old.keg_at(keg_dir) if old
+      (known and known.stamp == stamp) ? known : index_keg(keg_dir, stamp)
+    end
+    @racks[name] = RackEntry.new(name, dir.mtime.to_i, kegs.sort_by(&:path),
+                                 record_target(LINKDIR/name), record_target(OPTDIR/name), record_target(PINDIR/name))
+    @changed[name] = true
+    self
+  end # index_rack
+
+  # Write out whatever has changed:  Under the lock, the on‐disk index is reread and the racks changed here are laid over it, so that
+  # changes made meanwhile by other processes are kept.  With “whole”, this index replaces the on‐disk one outright.
+  def save(whole = false)
+    return self if @changed.empty? and not @cellar_changed and not whole
+    self.class.locked do
+      data = (self.class.read rescue nil) unless whole
+      if compatible?(data)
+        racks = data[:racks]
+        @changed.each_key{ |name| if @racks[name] then racks[name] = @racks[name]; else racks.delete(name); end }
+        @racks = racks
+        @cellar_mtime = data[:cellar_mtime] unless @cellar_changed
+      end
+      INDEX_FILE.atomic_write Marshal.dump(:format => FORMAT_VERSION, :cellar => HOMEBREW_CELLAR.to_s,
+                                           :cellar_mtime => @cellar_mtime, :racks => @racks)
+    end
+    @changed = {}
+    @cellar_changed = false
+    self
+  end # save
+
+  private
+
+  def compatible?(data); data.is_a?(Hash) and data[:format] == FORMAT_VERSION and data[:cellar] == HOMEBREW_CELLAR.to_s; end
+
+  def forget_rack(name)
+    @racks.delete(name)
+    @changed[name] = true
+  end
+
+  def record_target(record); record.resolved_path.to_s if record.symlink?; rescue SystemCallError; nil; end
+
+  # A keg’s entry stays valid while neither its top level nor its receipt is touched.
+  def keg_stamp(keg_dir)
+    tabfile = keg_dir/Tab::FILENAME
+    [keg_dir.mtime.to_i, (tabfile.mtime.to_i if tabfile.file?)]
+  end
+
+  def index_keg(keg_dir, stamp)
+    entry = KegEntry.new(keg_dir.to_s)
+    entry.stamp = stamp
+    entry.size = entry.file_count = 0
+    keg_dir.find do |pn|
+      next unless (st = File.lstat(pn) rescue nil) and st.file?
+      entry.size += st.size
+      entry.file_count += 1 unless pn.basename.to_s == '.DS_Store'
+    end
+    # The receipt is read as plain JSON:  Tab::from_file would also load a formula for each of its active aids.
+    attrs = (Utils::JSON.load(File.read(keg_dir/Tab::FILENAME)) rescue nil) if stamp[1]
+    attrs ||= {}
+    source = attrs['source'] || {}
+    tap = source['tap'] || (attrs['tapped_from'] if attrs['tapped_from'] != 'path or URL')
+    entry.tap = (tap == 'mxcl/master') ? 'Homebrew/homebrew' : tap
+    entry.spec = (source['spec'] || (entry.version.head? ? 'head' : 'stable')).to_sym
+    entry.built_archs = (attrs['built_archs'] || []).map(&:to_sym)
+    entry.used_options = attrs['used_options'] || []
+    entry.poured_from_bottle = attrs['poured_from_bottle']
+    entry.dependencies = attrs['dependencies']  # Nil for kegs whose receipts predate the field.
+    entry.git_head_SHA1 = attrs['git_head_SHA1']
+    entry
+  end # index_keg
+end # InstalledIndex
@@ -1,5 +1,7 @@
 require 'extend/pathname'
 require 'keg_relocate'
+require 'keg_link_plan'
+require 'keg_thin'
 require 'formula/lock'
 require 'ostruct'
 require 'tab'
@@ -27,6 +29,9 @@ class Keg
   end # LinkError
 
   class ConflictError < LinkError
+    # How many more conflicts were found besides this one.
+    attr_accessor :other_conflicts
+
     def suggestion
       conflict = Keg.for(lnk)
     rescue NotAKegError, Errno::ENOENT
@@ -42,6 +47,8 @@ class Keg
       s = []
       s << "Could not symlink #{tgt}"
       s << "Object at #{lnk}" << suggestion
+      s << "#{other_conflicts} other file#{plural(other_conflicts)} also conflict#{plural(other_conflicts, '', 's')}.\n" \
+        if other_conflicts and other_conflicts > 0
       s << <<-EOS.undent
           To force the link and overwrite all conflicting files:
               brew link --overwrite #{keg.name}
@@ -172,31 +179,16 @@ class Keg
     path.parent.rmdir_if_possible
     remove_opt_record if optlinked?
     remove_oldname_opt_record
+    note_change
   end # uninstall
 
   def unlink(mode = OpenStruct.new)
     ObserverPathnameExtension.reset_counts!
-    dirs = []
-    TOP_LEVEL_DIRECTORIES.map { |d| path/d }.each do |dir|
-      next unless dir.exists?
-      dir.find do |tgt|
-        lnk = HOMEBREW_PREFIX/tgt.relative_path_from(path)
-        lnk.extend(ObserverPathnameExtension)
-        next unless lnk.exists?
-        if lnk.symlink? and tgt == lnk.resolved_path  # only unlink a file from the current keg
-          if mode.dry_run then puts lnk
-          else
-            lnk.uninstall_info if lnk.to_s =~ INFOFILE_RX
-            lnk.unlink
-          end
-        end
-        if tgt.directory? then if tgt.symlink? then Find.prune; else dirs << lnk; end; end
-      end # find |tgt|
-    end # each top‐level directory |dir|
+    plan = LinkPlan.new(mode)
+    plan.add_unlink(self)
+    plan.apply
     remove_linked_keg_record if linked? and not mode.dry_run
-    dirs.reverse_each do |d|
-      if mode.dry_run then puts "Would attempt to remove #{d}"; else d.rmdir_if_possible; end
-    end
+    note_change unless mode.dry_run
 
     ObserverPathnameExtension.total
   end # unlink
@@ -256,20 +248,23 @@ class Keg
       end if OPTDIR.directory?
   end # oldname_opt_record
 
+  # Links the keg into the prefix:  The whole of it is planned first, so that any conflict is found before anything is touched.
+  # See {LinkPlan}.
   def link(mode = OpenStruct.new)
     raise AlreadyLinkedError.new(self) if linked_keg_record.directory?
     ObserverPathnameExtension.reset_counts!
-    link_dir('Frameworks', mode) do |relative_path|
+    plan = LinkPlan.new(mode)
+    plan.add_dir(self, 'Frameworks') do |relative_path|
         # Frameworks have symlinks pointing into a subdir, so we must use :link; but for Foo.framework & Foo.framework/Versions, we
         # must use :mkpath so that multiple formula versions can link into it and still have `brew [un]link` work.
         (relative_path.to_s =~ %r{[^/]*\.framework(/Versions)?$}) \
                                             ? :mkdir \
                                             : :link
-      end # link_dir Frameworks
-    link_dir('bin',        mode) {            :skip_dirs }
-    link_dir('etc',        mode) {            :link_tree }
-    link_dir('include',    mode) {            :link      }
-    link_dir('lib',        mode) do |relative_path|
+      end # add_dir Frameworks
+    plan.add_dir(self, 'bin')     { :skip_dirs }
+    plan.add_dir(self, 'etc')     { :link_tree }
+    plan.add_dir(self, 'include') { :link      }
+    plan.add_dir(self, 'lib') do |relative_path|
         case relative_path.to_s
           when 'charset.alias'           then :skip_this
           # cmake & pkg-config databases, plus lib/<language> folders, get explicitly created
@@ -278,9 +273,9 @@ class Keg
                                          then :mkdir
                                          else :link   # Everything else is symlinked to the cellar
         end
-      end # link_dir lib
-    link_dir('sbin',       mode) {            :skip_dirs }
-    link_dir('share',      mode) do |relative_path|
+      end # add_dir lib
+    plan.add_dir(self, 'sbin')    { :skip_dirs }
+    plan.add_dir(self, 'share') do |relative_path|
         case relative_path.to_s
           when %r{^icons/.*/icon-theme\.cache$},
                'locale/locale.alias'     then :skip_this
@@ -295,7 +290,8 @@ class Keg
                                          then :link_tree
                                          else :link
         end
-      end # link_dir share
+      end # add_dir share
+    plan.apply
     make_relative_symlink(linked_keg_record, path, mode) unless mode.dry_run
   rescue LinkError
     unlink
@@ -317,6 +313,13 @@ class Keg
     mode.overwrite = true
     make_relative_symlink(opt_record, path, mode)
     make_relative_symlink(oldname_opt_record, path, mode) if oldname_opt_record
+    note_change
+  end
+
+  # Keeps the {LinkageIndex} & {InstalledIndex} (if they have been built) in step with what was just done to this keg.
+  def note_change
+    require 'linkage_index'; LinkageIndex.keg_changed(self)
+    require 'installed_index'; InstalledIndex.rack_changed(rack)
   end
 
   def delete_pyc_files!; find { |pn| pn.delete if pn.extname == '.pyc' }; end
@@ -346,31 +349,6 @@ class Keg
 
   private
 
-  def resolve_any_conflicts(lnk, linkage_type, mode)
-    return true if lnk.real_directory?  # Means a conflict has _already been_ resolved & we need to skip over it.
-    return false unless lnk.symlink?
-    tgt = lnk.resolved_path
-    # Check lstat to be sure we have a directory, and not a symlink pointing at one (which would need to be treated as a file).  In
-    # other words, only resolve one symlink.
-    begin
-      stat = tgt.lstat
-    rescue Errno::ENOENT  # lnk is a broken symlink, so remove it.
-      lnk.unlink unless mode.dry_run
-      return false
-    end
-    if stat.directory?
-      begin
-        keg = Keg.for(tgt)
-      rescue NotAKegError
-        puts "Won’t resolve conflicts for symlink #{lnk} as it doesn’t resolve into the Cellar" if VERBOSE
-        return false
-      end
-      lnk.unlink unless mode.dry_run
-      keg.link_dir(tgt, mode) { linkage_type }
-      return true
-    end
-  end # resolve_any_conflicts
-
   def make_relative_symlink(lnk, tgt, mode)
     _targ = mode.dry_run ? HOMEBREW_CELLAR/name/version_s/tgt.relative_path_from(path) : tgt
     if lnk.symlink? and lnk.resolved_path == _targ
@@ -396,58 +374,4 @@ class Keg
   rescue SystemCallError => e
     raise LinkError.new(self, tgt.relative_path_from(path), lnk, e)
   end # make_relative_symlink
-
-  protected
-
-  def make_path(dst, mode); if mode.dry_run then puts "Make #{dst}"; else; dst.mkpath; end; end
-
-  # symlinks the contents of path/relative_dir recursively into #{HOMEBREW_PREFIX}/relative_dir
-  def link_dir(relative_dir, mode)
-    root = path/relative_dir
-    return unless root.exists?
-    root.find do |tgt|
-      next if tgt == root
-      (lnk = HOMEBREW_PREFIX/tgt.relative_path_from(path)).extend ObserverPathnameExtension
-      yielded = yield (relpath = tgt.relative_path_from(root))
-      unknown_linkage_msg = "Unknown linkage type “:#{yielded.to_s}” specified for #{relative_dir}/#{relpath}"
-      if tgt.symlink? or tgt.file?
-        next if tgt.basename == '.DS_Store' or
-                (tgt.exists? and tgt.realpath == lnk) or
-                # Don’t link pyc files because Python overwrites them and the next time brew wants to link, they’re in the way.
-                (tgt.extname == '.pyc' and tgt.to_s =~ %r{site-packages})
-        case yielded
-          when :info
-            next if tgt.basename == 'dir'  # skip historical local 'dir' files
-            make_relative_symlink(lnk, tgt, mode)
-            if mode.dry_run then puts " -> info #{relative_dir}/#{relpath}"
-            else lnk.install_info; end
-          when :link, :link_tree, :skip_dirs then make_relative_symlink(lnk, tgt, mode)
-          when :mkdir, :skip_this, nil       then next
-          else raise LinkError.new(self, tgt, lnk, unknown_linkage_msg)
-        end
-      else # directory
-        # .app bundles needn’t be in the path.  A user can just use Spotlight or “open”, & real Mac apps use an equivalent.
-        Find.prune if tgt.extname == '.app'
-        case yielded
-          when :info
-            raise LinkError.new(self, tgt, lnk, ":info linkage specified for a directory:  #{relative_dir}/#{relpath}")
-          when :link
-            unless resolve_any_conflicts(lnk, :link, mode)
-              make_relative_symlink(lnk, tgt, mode)
-              Find.prune
-            end
-          when :link_tree
-            unless lnk.real_directory?
-              resolve_any_conflicts(lnk, :link_tree, mode) or make_path(lnk, mode)
-            end
-          when :mkdir
-            unless lnk.real_directory?
-              resolve_any_conflicts(lnk, :link, mode) or make_path(lnk, mode)
-            end
-          when :skip_dirs, :skip_this, nil then Find.prune
-          else raise LinkError.new(self, tgt, lnk, unknown_linkage_msg)
-        end
-      end # tgt.type?
-    end # do find
-  end # link_dir
 end # Keg
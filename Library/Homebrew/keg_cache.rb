@@ -0,0 +1,63 @@
+require 'digest/sha2'
+require 'keg'
+require 'bottle_writer'
+require 'bottle_pourer'
+
+# Keeps a copy of each keg built from source, so that building the same thing again – after an uninstall, say, or in switching back
+# to an older version – pours the copy instead.  Opt‐in, by setting $HOMEBREW_KEG_CACHE.
+#
+# A copy is made much as `brew bottle` makes a bottle:  The keg’s install names & text files have the prefix & Cellar swapped for
+# Keg::PREFIX_PLACEHOLDER & Keg::CELLAR_PLACEHOLDER, & it is written out by BottleWriter.  As the keg is by then linked & may be in
+# use, that is done to a staged duplicate of it, never to the keg itself.  Pouring a stored copy is thus an ordinary BottlePourer
+# pour.  Copies live in HOMEBREW_CACHE/kegs, named for the formula, its version, & a SHA-256 of everything the build depended on
+# (see FormulaInstaller#keg_cache_inputs):  If any of it differs, the copy simply isn’t found.
+class KegCache
+  DIR = HOMEBREW_CACHE/'kegs'
+  EXTNAME = '.tar.gz'
+
+  def self.enabled?; not ENV['HOMEBREW_KEG_CACHE'].choke.nil?; end
+
+  attr_reader :key
+
+  # “inputs” is a hash of string => string, naming everything that could make one build of “formula” differ from another.
+  def initialize(formula, inputs)
+    @formula = formula
+    @key = Digest::SHA256.hexdigest(inputs.keys.sort.map{ |k| "#{k}=#{inputs[k]}\n" }.join)
+  end
+
+  def path; DIR/"#{@formula.name}--#{@formula.pkg_version}--#{@key[0, 32]}#{EXTNAME}"; end
+
+  def hit?; path.file?; end
+
+  # Saves a copy of “keg”, which must be unchanged from when this build finished.  The keg is only read:  It is duplicated into a
+  # staging Cellar under HOMEBREW_TEMP, & the duplicate is relocated & written out.
+  def store(keg)
+    prefix, cellar = HOMEBREW_PREFIX.to_s, HOMEBREW_CELLAR.to_s
+    rel = keg.path.relative_path_from(HOMEBREW_CELLAR).to_s
+    HOMEBREW_TEMP.mkpath
+    staging = Pathname(Dir.mktmpdir('keg_cache', HOMEBREW_TEMP.to_s))
+    (staging/rel).dirname.mkpath
+    FileUtils.cp_r keg.path.to_s, (staging/rel).to_s, :preserve => true
+    staged = Keg.new(staging/rel, staging)
+    staged.relocate_install_names prefix, Keg::PREFIX_PLACEHOLDER, cellar, Keg::CELLAR_PLACEHOLDER
+    staged.relocate_text_files prefix, Keg::PREFIX_PLACEHOLDER, cellar, Keg::CELLAR_PLACEHOLDER
+    DIR.mkpath
+    temp = DIR/".#{path.basename}.#{$$}"
+    temp.open('wb') { |out| BottleWriter.new(staging, [rel]).write(out) }
+    File.rename(temp.to_s, path.to_s)
+    path
+  ensure
+    temp.unlink if temp and temp.file?
+    staging.rmtree if staging and staging.directory?
+  end # store
+
+  # Pours the copy into the Cellar, relocated for this prefix.  Returns the keg.
+  def pour
+    pourer = BottlePourer.new(path, HOMEBREW_CELLAR).pour
+    keg = Keg.new(@formula.prefix)
+    keg.relocate_install_names Keg::PREFIX_PLACEHOLDER, HOMEBREW_PREFIX.to_s, Keg::CELLAR_PLACEHOLDER, HOMEBREW_CELLAR.to_s,
+                               pourer.mach_o_files
+    FileUtils.touch path.to_s  # For `brew cleanup`, which drops copies unused for a while.
+    keg
+  end # pour
+end # KegCache
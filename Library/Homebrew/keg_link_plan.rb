@@ -0,0 +1,348 @@
+class Keg
+  # Links (or unlinks) a keg in two phases.  The first works out every directory to make, symlink to create, and object to move out
+  # of the way – checking each against what the prefix already holds, and against what the plan itself will have done by then – and
+  # notes every conflict, all without touching the prefix.  Only a conflict‐free plan is then carried out; should that fail partway
+  # (a full disk, say, or an interrupt), whatever it had done is undone, so a keg is never left half‐linked.
+  #
+  # The prefix is read sparingly while planning:  Each directory is listed once, and only names that turn up in a listing are ever
+  # lstat’ed or readlink’ed, each at most once.  A dry run is just a plan that is printed instead of carried out.
+  class LinkPlan
+    # One step:  :mkdir, :link, :move_aside (with a “reason” of :victim, :broken or :take_over), or :unlink.
+    class Op < Struct.new(:action, :path, :target, :keg, :info, :reason, :conflict, :was)
+      # The path within its keg, as shown in error messages.
+      def relative_target; keg ? target.relative_path_from(keg.path) : target; end
+    end
+
+    attr_reader :ops
+
+    def initialize(mode = OpenStruct.new)
+      @mode = mode
+      @ops = []
+      @listings = {}  # directory => { entry name => true }, or nil if it isn’t a directory
+      @lstats = {}    # path => File::Stat, or nil if there is nothing there
+      @planned = {}   # path => :dir, :gone, or the Pathname a planned symlink will point at
+      @dirs = []      # directories to try removing after unlinking
+    end # initialize
+
+    def conflicts; @ops.select(&:conflict); end
+
+    def empty?; @ops.empty? and @dirs.empty?; end
+
+    ### Planning a link ###
+
+    # Plans the linking of keg/relative_dir into the prefix.  The block is given each path relative to that directory, and answers
+    # how to treat it (see Keg#link).
+    def add_dir(keg, relative_dir, &rule)
+      root = keg.path/relative_dir
+      return unless root.exists?
+      root.find do |tgt|
+        next if tgt == root
+        lnk = HOMEBREW_PREFIX/tgt.relative_path_from(keg.path)
+        relpath = tgt.relative_path_from(root)
+        kind = rule.call(relpath)
+        unknown_linkage_msg = "Unknown linkage type “:#{kind.to_s}” specified for #{relative_dir}/#{relpath}"
+        st = File.lstat(tgt)
+        if st.symlink? or st.file?
+          next if tgt.basename.to_s == '.DS_Store' or
+                  (st.symlink? and tgt.exists? and tgt.realpath == lnk) or
+                  # Don’t link pyc files because Python overwrites them and the next time brew wants to link, they’re in the way.
+                  (tgt.extname == '.pyc' and tgt.to_s =~ %r{site-packages})
+          case kind
+            when :info
+              next if tgt.basename.to_s == 'dir'  # skip historical local 'dir' files
+              add_link(keg, lnk, tgt, true)
+            when :link, :link_tree, :skip_dirs then add_link(keg, lnk, tgt)
+            when :mkdir, :skip_this, nil       then next
+            else raise LinkError.new(keg, tgt, lnk, RuntimeError.new(unknown_linkage_msg))
+          end
+        else # directory
+          # .app bundles needn’t be in the path.  A user can just use Spotlight or “open”, & real Mac apps use an equivalent.
+          Find.prune if tgt.extname == '.app'
+          case kind
+            when :info
+              raise LinkError.new(keg, tgt, lnk,
+                                  RuntimeError.new(":info linkage specified for a directory:  #{relative_dir}/#{relpath}"))
+            when :link
+              unless take_over(lnk, :link)
+                add_link(keg, lnk, tgt)
+                Find.prune
+              end
+            when :link_tree, :mkdir
+              unless real_directory?(lnk)
+                take_over(lnk, kind == :mkdir ? :link : :link_tree) or add_mkdir(keg, lnk, tgt)
+              end
+            when :skip_dirs, :skip_this, nil then Find.prune
+            else raise LinkError.new(keg, tgt, lnk, RuntimeError.new(unknown_linkage_msg))
+          end
+        end # tgt.type?
+      end # do find
+    end # add_dir
+
+    ### Planning an unlink ###
+
+    # Plans the removal of every symlink in the prefix that points into the keg, & of the directories they leave empty.
+    def add_unlink(keg)
+      TOP_LEVEL_DIRECTORIES.map{ |d| keg.path/d }.each do |dir|
+        next unless dir.exists?
+        dir.find do |tgt|
+          lnk = HOMEBREW_PREFIX/tgt.relative_path_from(keg.path)
+          next unless present?(lnk) and lnk.exists?
+          if symlink?(lnk) and target_of(lnk) == tgt  # only unlink a file from the current keg
+            @ops << Op.new(:unlink, lnk, tgt, keg, lnk.to_s =~ INFOFILE_RX)
+            Find.prune if tgt.directory?  # Whatever is beneath came through this symlink, & goes with it.
+          elsif tgt.directory?
+            # Beneath a symlink (on either side), nothing further can be this keg’s to unlink.
+            if tgt.symlink? or not real_directory?(lnk) then Find.prune; else @dirs << lnk; end
+          end
+        end # find |tgt|
+      end # each top‐level directory |dir|
+    end # add_unlink
+
+    ### Carrying it out ###
+
+    # Prints what a dry run would do:  With `--overwrite`, just the files that would be deleted; otherwise every step, conflicts
+    # included.
+    def print_dry_run
+      @ops.each do |op|
+        if @mode.overwrite
+          puts op.path if op.action == :move_aside and op.reason == :victim
+          next
+        end
+        case op.action
+          when :mkdir
+            puts conflict_message(op) if op.conflict
+            puts "Make #{op.path}"
+          when :link
+            puts conflict_message(op) if op.conflict
+            puts "#{op.path} -> #{op.target}"
+            puts " -> info #{op.relative_target}" if op.info
+          when :unlink then puts op.path
+        end
+      end # each |op|
+      @dirs.reverse_each{ |d| puts "Would attempt to remove #{d}" } unless @mode.overwrite
+    end # print_dry_run
+
+    # Carries out the plan, unless it is a dry run or has conflicts (in which case the first is raised).  Everything done is undone
+    # again if any step fails.
+    def apply
+      return print_dry_run if @mode.dry_run
+      raise_conflicts
+      # Info files are deregistered while their symlinks still exist, and registered once theirs do.
+      @ops.each{ |op| op.path.extend(ObserverPathnameExtension).uninstall_info if op.action == :unlink and op.info }
+      done = []
+      begin
+        @ops.each do |op|
+          carry_out(op)
+          done << op
+        end
+      rescue Exception => e
+        ignore_interrupts { done.reverse_each{ |op| undo(op) } }
+        raise unless e.is_a?(SystemCallError)
+        op = @ops[done.length]
+        error = e.is_a?(Errno::EACCES) ? DirectoryNotWritableError : LinkError
+        raise error.new(op.keg, op.relative_target, op.path, e)
+      end
+      done.each{ |op| discard_aside(op) if op.action == :move_aside }
+      @ops.each{ |op| op.path.extend(ObserverPathnameExtension).install_info if op.action == :link and op.info }
+      @dirs.reverse_each{ |d| d.extend(ObserverPathnameExtension).rmdir_if_possible }
+      self
+    end # apply
+
+    private
+
+    def conflict_message(op)
+      if op.conflict == :unwritable then "Conflict!  #{op.path.dirname} is not writable"
+      else "Conflict!  #{op.path} already exists and is #{op.conflict}"; end
+    end
+
+    ### The prefix as it stands, overlaid with the plan so far ###
+
+    def listing(dir)
+      key = dir.to_s
+      return @listings[key] if @listings.has_key?(key)
+      @listings[key] = begin
+          h = {}
+          Dir.entries(key).each{ |e| h[e] = true }
+          h
+        rescue SystemCallError
+          nil
+        end
+    end # listing
+
+    # Whether anything at all (even a broken symlink) is at the path.
+    def present?(path)
+      if (p = @planned[path.to_s]) then p != :gone
+      elsif path.to_s == HOMEBREW_PREFIX.to_s then true
+      elsif (parent = @planned[path.dirname.to_s]) then parent.is_a?(Pathname) ? (parent/path.basename).exists? : false
+      else (l = listing(path.dirname)) ? l.has_key?(path.basename.to_s) : false
+      end
+    end # present?
+
+    def lstat(path)
+      return nil unless present?(path)
+      key = path.to_s
+      @lstats[key] = (File.lstat(key) rescue nil) unless @lstats.has_key?(key)
+      @lstats[key]
+    end # lstat
+
+    def symlink?(path)
+      p = @planned[path.to_s]
+      return p.is_a?(Pathname) if p
+      (st = lstat(path)) ? st.symlink? : false
+    end
+
+    def real_directory?(path)
+      p = @planned[path.to_s]
+      return p == :dir if p
+      (st = lstat(path)) ? st.directory? : false
+    end
+
+    # Where a symlink points, resolved (one level) against its own directory.
+    def target_of(path)
+      p = @planned[path.to_s]
+      return p if p.is_a?(Pathname)
+      path.resolved_path
+    end
+
+    def description_of(path)
+      if symlink?(path) then "a link to #{target_of(path)}"
+      elsif (st = lstat(path)) then "a #{st.ftype}"
+      else 'in the way'; end
+    end
+
+    def writable_dir?(dir)
+      (@writable ||= {})[dir.to_s] ||= [(@planned[dir.to_s] == :dir or not present?(dir) or File.writable?(dir.to_s))]
+      @writable[dir.to_s][0]
+    end
+
+    ### Building the plan ###
+
+    # Plans the creation of any missing directories down to “dir”.
+    def add_parents(keg, dir, tgt)
+      return if dir.to_s == HOMEBREW_PREFIX.to_s or real_directory?(dir) or (symlink?(dir) and dir.directory?)
+      add_parents(keg, dir.dirname, tgt)
+      add_mkdir(keg, dir, tgt)
+    end
+
+    def add_mkdir(keg, lnk, tgt)
+      op = Op.new(:mkdir, lnk, tgt, keg)
+      if present?(lnk)
+        return if symlink?(lnk) and lnk.directory?  # A symlink to a directory is mkpath’d through, as ever.
+        op.conflict = description_of(lnk) unless move_aside(keg, lnk, tgt)
+      end
+      add_parents(keg, lnk.dirname, tgt)
+      op.conflict ||= :unwritable unless writable_dir?(lnk.dirname)
+      @ops << op
+      @planned[lnk.to_s] = :dir
+    end # add_mkdir
+
+    def add_link(keg, lnk, tgt, info = false)
+      if symlink?(lnk) and target_of(lnk) == tgt
+        puts "Skipping; link already exists:  #{lnk}" if VERBOSE
+        return
+      end
+      op = Op.new(:link, lnk, tgt, keg, info)
+      if present?(lnk)
+        if symlink?(lnk) and not @planned[lnk.to_s] and not lnk.exists?  # A broken symlink is simply replaced.
+          move_aside(keg, lnk, tgt, :broken)
+        else
+          op.conflict = description_of(lnk) unless move_aside(keg, lnk, tgt)
+        end
+      end # something is in the way
+      add_parents(keg, lnk.dirname, tgt)
+      op.conflict ||= :unwritable unless writable_dir?(lnk.dirname)
+      @ops << op
+      @planned[lnk.to_s] = tgt
+    end # add_link
+
+    # Plans moving something out of the way, if allowed (i.e., it is a broken symlink, or we are overwriting).  Returns whether it is.
+    def move_aside(keg, lnk, tgt, reason = :victim)
+      return false if reason == :victim and not @mode.overwrite
+      op = Op.new(:move_aside, lnk, tgt, keg)
+      op.reason = reason
+      @ops << op
+      @planned[lnk.to_s] = :gone
+      true
+    end
+
+    # Where the prefix holds a symlink to a directory in another keg, that is replaced by a real directory with the other keg’s
+    # contents linked into it – so that both kegs can share it.  Returns whether the path now is (or is to be) a real directory.
+    def take_over(lnk, kind)
+      return true if real_directory?(lnk)  # Means a conflict has _already been_ resolved & we need to skip over it.
+      return false unless symlink?(lnk)
+      tgt = target_of(lnk)
+      # Check lstat to be sure we have a directory, and not a symlink pointing at one (which would need to be treated as a file).
+      # In other words, only resolve one symlink.
+      begin
+        stat = File.lstat(tgt)
+      rescue Errno::ENOENT  # lnk is a broken symlink, so remove it.
+        move_aside(nil, lnk, tgt, :broken)
+        return false
+      end
+      return false unless stat.directory?
+      begin
+        other = Keg.for(tgt)
+      rescue NotAKegError
+        puts "Won’t resolve conflicts for symlink #{lnk} as it doesn’t resolve into the Cellar" if VERBOSE
+        return false
+      end
+      move_aside(other, lnk, tgt, :take_over)
+      add_mkdir(other, lnk, tgt)
+      add_dir(other, tgt.relative_path_from(other.path)) { kind }
+      true
+    end # take_over
+
+    def raise_conflicts
+      return if (found = conflicts).empty?
+      op = found.first
+      if op.conflict == :unwritable
+        raise DirectoryNotWritableError.new(op.keg, op.relative_target, op.path, Errno::EACCES.new(op.path.dirname.to_s))
+      end
+      error = ConflictError.new(op.keg, op.relative_target, op.path, Errno::EEXIST.new(op.path.to_s))
+      error.other_conflicts = found.length - 1
+      raise error
+    end # raise_conflicts
+
+    ### Doing & undoing ###
+
+    def aside_path(path); path.dirname/".#{path.basename}.#{Process.pid}.linking"; end
+
+    def carry_out(op)
+      case op.action
+        when :mkdir
+          Dir.mkdir(op.path.to_s)
+          puts "mkdir #{op.path}" if VERBOSE
+          ObserverPathnameExtension.d += 1
+        when :link
+          rel = op.target.relative_path_from(op.path.dirname)
+          File.symlink(rel.to_s, op.path.to_s)
+          puts "ln -s #{rel} #{op.path.basename}" if VERBOSE
+          ObserverPathnameExtension.n += 1
+        when :move_aside then File.rename(op.path.to_s, aside_path(op.path).to_s)
+        when :unlink
+          op.was = File.readlink(op.path.to_s)  # Exactly as it was, for #undo.
+          File.unlink(op.path.to_s)
+          puts "rm #{op.path}" if VERBOSE
+          ObserverPathnameExtension.n += 1
+      end
+    end # carry_out
+
+    def undo(op)
+      case op.action
+        when :mkdir then Dir.rmdir(op.path.to_s)
+        when :link then File.unlink(op.path.to_s)
+        when :move_aside then File.rename(aside_path(op.path).to_s, op.path.to_s)
+        when :unlink
+          File.symlink(op.was, op.path.to_s)
+          op.path.extend(ObserverPathnameExtension).install_info if op.info
+      end
+    rescue SystemCallError => e
+      opoo "Could not undo #{op.action} of #{op.path}:  #{e}"
+    end # undo
+
+    def discard_aside(op)
+      aside = aside_path(op.path)
+      if aside.symlink? then aside.unlink; else aside.rmtree; end
+    end
+  end # LinkPlan
+end # Keg
@@ -29,8 +29,9 @@ class Keg
     end # each symlink |file|
   end # fix_install_names
 
-  def relocate_install_names(old_prefix, new_prefix, old_cellar, new_cellar)
-    mach_o_files.each do |file|
+  # “files” may name just those Mach-O files known to need it (see {BottlePourer#mach_o_files}); by default, it is all of them.
+  def relocate_install_names(old_prefix, new_prefix, old_cellar, new_cellar, files = mach_o_files)
+    files.each do |file|
       file.ensure_writable do
         if file.dylib?
           id = dylib_id_for(file).sub(old_prefix, new_prefix)
@@ -46,8 +47,8 @@ class Keg
     end # each Mach-O |file|
   end # relocate_install_names
 
-  def relocate_text_files(old_prefix, new_prefix, old_cellar, new_cellar)
-    files = text_files | libtool_files
+  # “files” may name the text files if they are already known, to save looking for them again.
+  def relocate_text_files(old_prefix, new_prefix, old_cellar, new_cellar, files = text_files | libtool_files)
     files.group_by { |f| f.stat.ino }.each_value do |first, *rest|
       s = first.open("rb", &:read)
       changed = s.gsub!(old_cellar, new_cellar)
@@ -123,7 +124,7 @@ class Keg
     # work_name is now definitely an absolute path.  If it’s in our own installed prefix, or anywhere else in the Cellar, it _will_
     # break if its referent has been moved for reïnstallation.
     if work_name.starts_with? HOMEBREW_CELLAR.to_s
-      keg = Keg.for(work_name)
+      keg = keg_for(work_name)
       return work_name.sub(keg.path.to_s, keg.opt_record.to_s)
     # If work_name is one of our symlinks in the PREFIX, it will break
     # when its target is unlinked.
@@ -131,7 +132,7 @@ class Keg
       return work_name if work_name.starts_with? OPTDIR.to_s
       bad_path = Pathname(work_name)
       return work_name unless bad_path.symlink? and (real_bad = bad_path.resolved_real_path).starts_with? HOMEBREW_CELLAR
-      return work_name.sub(HOMEBREW_PREFIX.to_s, (Keg.for(real_bad)).opt_record.to_s)
+      return work_name.sub(HOMEBREW_PREFIX.to_s, keg_for(real_bad).opt_record.to_s)
     end # is it in the Cellar or the PREFIX?
     opoo "Could not fix #{bad_name} in #{file}"
     bad_name
@@ -158,7 +159,18 @@ class Keg
     opt_record/relative_dirname/dylib_basename
   end # dylib_id_for
 
-  def find_dylib(name); lib.find { |pn| break pn if pn.basename == name } if lib.directory?; end
+  def find_dylib(name)
+    return unless lib.directory?
+    # The index only knows this keg once it has been optlinked, which a freshly‐built keg hasn’t yet; search for it if need be.
+    if (index = linkage_index) and index.indexed?(self) then index.find_in_keg(self, name, 'lib')
+    else lib.find { |pn| break pn if pn.basename == name }; end
+  end # find_dylib
+
+  def keg_for(path); (index = linkage_index) ? index.keg_for(path) : Keg.for(path); end
+
+  # The {LinkageIndex}, if one has already been built; nil otherwise, as building one here would mean walking the entire Cellar just
+  # to fix one keg’s install names.
+  def linkage_index; require 'linkage_index'; LinkageIndex.instance if LinkageIndex.available?; end
 
   def mach_o_files
     mach_o_files = []
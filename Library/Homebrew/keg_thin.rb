@@ -0,0 +1,88 @@
+require 'utils/fork'
+
+# Thinning a keg cuts every fat Mach-O file & `ar` archive in it down to the slices for a chosen set of architectures – usually
+# those this Mac runs natively – and records the keg as built for only those.  Our bottles are universal, but any one Mac only ever
+# uses one slice of each file; the rest just take up disk & page cache, and make dyld read larger files at every launch.
+class Keg
+  class << self
+    # Of the architectures in “archs”, those held by the fat file at “pn” – if that is some, but not all, of its slices.  Otherwise
+    # nil, as the file needn’t (or can’t usefully) be thinned.
+    def slices_to_keep(pn, archs)
+      held = pn.fat_slice_archs
+      keep = held & archs
+      keep.extend(ALE) unless keep.empty? or keep.length == held.length
+    end
+
+    # Where a thinned copy of “pn” is written before taking its place.
+    def thin_temp(pn); pn.dirname/".#{pn.basename}.thin"; end
+
+    # The `lipo` command line that writes a copy of “pn”, holding only the slices for “keep”, to “out”.
+    def lipo_thin_args(pn, keep, out)
+      slices = (keep.length == 1) ? ['-thin', keep.first.to_s] : keep.flat_map{ |a| ['-extract', a.to_s] }
+      [MacOS.lipo.to_s, pn.to_s] + slices + ['-output', out.to_s]
+    end
+
+    # Puts the thinned copy “temp” in the place of “pn”, with the same permissions & times.  Returns the number of octets saved.
+    def replace_thinned(pn, temp)
+      st = pn.stat
+      File.chmod(st.mode & 07777, temp.to_s)
+      File.utime(st.atime, st.mtime, temp.to_s)
+      saved = st.size - temp.size
+      File.rename(temp.to_s, pn.to_s)
+      saved
+    end # Keg::replace_thinned
+
+    # Thins the file at “pn” in place, keeping the slices for “keep”.  Returns the number of octets saved.  A file `lipo` fails on is
+    # simply left fat, as when pouring – slices are told apart by CPU type alone, so a file whose slices are all for subtypes (say,
+    # ppc7400 & ppc970) can’t be thinned to plain “ppc”.
+    def thin_file(pn, keep)
+      temp = thin_temp(pn)
+      if quiet_system(*lipo_thin_args(pn, keep, temp)) and temp.file? then replace_thinned(pn, temp)
+      else
+        opoo "Could not thin #{pn}" if DEBUG
+        0
+      end
+    ensure
+      temp.unlink if temp and temp.exist?
+    end # Keg::thin_file
+  end # << self
+
+  # Each fat Mach-O file & `ar` archive in the keg holding slices other than those for “archs”, paired with the slices it is to keep.
+  # Hard‐linked files are left alone, as replacing one would sever it from its twin.
+  def thinnable_files(archs)
+    files = []
+    path.find do |pn|
+      next unless (st = File.lstat(pn) rescue nil) and st.file? and st.nlink == 1
+      keep = Keg.slices_to_keep(pn, archs)
+      files << [pn, keep] if keep
+    end
+    files
+  end # thinnable_files
+
+  # Thins every file #thinnable_files finds, “jobs” at a time, without touching the install receipt.  Returns the octets saved.
+  def thin_files(archs, jobs = CPU.cores)
+    Utils.parallel_map(thinnable_files(archs), jobs){ |pn, keep| Keg.thin_file(pn, keep) }.inject(0){ |sum, n| sum + n }
+  end
+
+  # Thins the keg to those of “archs” it was built for, & records as much.  Returns the number of octets saved.
+  def thin(archs, jobs = CPU.cores)
+    saved = thin_files(archs, jobs)
+    record_thinning(archs)
+    saved
+  end # thin
+
+  # Narrows the built architectures in the install receipt to those of “archs”, so that it agrees with what #reconstruct_built_archs
+  # would now find.  A universal build mode thinned to a single architecture becomes plain.
+  def record_thinning(archs)
+    return unless (path/Tab::FILENAME).file?
+    t = Tab.for_keg(path)
+    built = t.built_archs
+    kept = built & archs
+    return if kept.empty? or kept.length == built.length
+    t.built_archs = kept.map(&:to_s)
+    t.build_mode = 'plain' if kept.length == 1 and [:cross, :local, :native].include?(t.build_mode)
+    t.write
+    @tab = nil
+    note_change
+  end # record_thinning
+end # Keg
@@ -0,0 +1,190 @@
+require 'keg'
+
+# A persistent map from every path by which a brewed dylib may be referenced – its real path in the Cellar, its path through the
+# opt prefix, & (when linked) its path in HOMEBREW_PREFIX – to the keg that owns it, along with that keg’s formula name and tap.
+# Linkage checks can then answer “who owns this install name?” without a realpath walk (Keg::for) or a receipt parse (Tab::for_keg)
+# per reference.
+#
+# The index lives in HOMEBREW_CACHE.  Each time it is loaded, every rack’s mtime & opt/linked records are compared with what was
+# seen when that rack was last indexed, & only the racks that differ are rescanned – so a full build happens only once.  Keg#optlink,
+# Keg#unlink & Keg#uninstall also push their changes in directly.  Indexing reads Mach-O headers only; it never runs `otool`.
+class LinkageIndex
+  INDEX_FILE = HOMEBREW_CACHE/'linkage_index.marshal'
+  FORMAT_VERSION = 1
+
+  class << self
+    # The index for the current Cellar, loaded (& freshened) or built as needed.
+    def instance; @instance ||= load.refresh; end
+
+    def reset!; @instance = nil; end
+
+    # Whether an index has already been built, so that consulting it won’t mean first indexing the whole Cellar.
+    def available?; !!(@instance or INDEX_FILE.file?); end
+
+    # Reindex the rack of a keg that was just linked, unlinked, optlinked or uninstalled.  Does nothing unless an index has already
+    # been built.
+    def keg_changed(keg)
+      return unless available?
+      instance.index_rack(keg.rack).save
+    rescue StandardError => e
+      opoo "Could not update the linkage index:  #{e}" if DEBUG
+    end
+
+    def load
+      data = INDEX_FILE.open('rb') { |f| Marshal.load(f) } if INDEX_FILE.file?
+      new(data)
+    rescue StandardError
+      new  # A corrupt or foreign index is simply rebuilt.
+    end
+  end # << self
+
+  # The owning keg of an indexed path, with the facts about it that linkage checking needs.
+  class Owner < Struct.new(:path, :name, :tap)
+    def keg; Keg.new(path); end
+
+    # The name to report the owner by:  Bare for core formulæ, fully qualified for tapped ones.
+    def formula_name; (not tap or CORE_OWNERS.include? tap) ? name : "#{tap}/#{name}"; end
+  end # Owner
+
+  def initialize(data = nil)
+    data = nil unless data.is_a?(Hash) and data[:format] == FORMAT_VERSION and data[:cellar] == HOMEBREW_CELLAR.to_s
+    @racks = data ? data[:racks] : {}  # rack name => [signature, [keg paths]]
+    @kegs  = data ? data[:kegs]  : {}  # keg path  => [name, tap, [dylib paths, relative to the keg]]
+    @paths = data ? data[:paths] : {}  # absolute reference path => keg path
+    @dirty = data.nil?
+    @misses = {}                       # Per‐process memo of Keg::for results for paths outside the index,
+    @strays = {}                       #   & of the facts about any unindexed kegs those turned up.
+  end # initialize
+
+  # Rescan whichever racks have changed since they were last indexed, & drop the ones that have gone away.
+  def refresh
+    seen = {}
+    racks = HOMEBREW_CELLAR.directory? ? HOMEBREW_CELLAR.subdirs.reject(&:symlink?) : []
+    racks.each do |rack|
+      seen[name = rack.basename.to_s] = true
+      index_rack(rack) unless (entry = @racks[name]) and entry[0] == rack_signature(rack)
+    end
+    (@racks.keys - seen.keys).each{ |name| forget_rack(name) }
+    save
+  end # refresh
+
+  def save
+    if @dirty
+      HOMEBREW_CACHE.mkpath
+      INDEX_FILE.atomic_write Marshal.dump(:format => FORMAT_VERSION, :cellar => HOMEBREW_CELLAR.to_s,
+                                           :racks => @racks, :kegs => @kegs, :paths => @paths)
+      @dirty = false
+    end
+    self
+  end # save
+
+  def index_rack(rack)
+    name = rack.basename.to_s
+    forget_rack(name)
+    if rack.directory? and not rack.symlink?
+      opt = linked_target(OPTDIR/name); lnk = linked_target(LINKDIR/name)
+      kegs = rack.subdirs.map(&:to_s)
+      kegs.each{ |keg_path| index_keg(keg_path, name, keg_path == opt, keg_path == lnk) }
+      @racks[name] = [rack_signature(rack), kegs]
+    end
+    @dirty = true
+    self
+  end # index_rack
+
+  # Returns the {Owner} of the given install name or path, or nil if it isn’t in the Cellar.  Raises Errno::ENOENT for a brewed (or
+  # otherwise unindexed) path that doesn’t exist, exactly as Keg::for would.
+  def owner_of(install_name)
+    name = install_name.to_s
+    # The index records what was there when the rack was last scanned; trust it only while the file is still there, &, for a link in
+    # the prefix or the opt tree, while it still leads into the keg recorded for it.
+    if (keg_path = @paths[name]) and File.exist?(name) and (name.starts_with?("#{HOMEBREW_CELLAR}/") or leads_into?(name, keg_path))
+      return owner_for(keg_path)
+    end
+    if name.starts_with?("#{HOMEBREW_CELLAR}/") or name.starts_with?("#{HOMEBREW_PREFIX}/")
+      raise Errno::ENOENT, name unless File.exist?(name)
+      # Present but not a dylib we indexed (a plain file, or a keg added behind our back):  Fall through to the slow path.
+    end
+    unless @misses.has_key?(name)
+      @misses[name] = begin Keg.for(name).path.to_s
+                      rescue NotAKegError then nil
+                      rescue Errno::ENOENT then :missing; end
+    end
+    case found = @misses[name]
+      when :missing then raise Errno::ENOENT, name
+      when nil then nil
+      else owner_for(found)
+    end
+  end # owner_of
+
+  # The {Keg} containing the given path, via the index where possible.  Raises as Keg::for does.
+  def keg_for(path)
+    (owner = owner_of(path)) ? owner.keg : raise(NotAKegError, path)
+  end
+
+  # Finds a dylib with the given basename among those indexed for the given keg – optionally, only within one of its subdirectories
+  # – or nil if there is none (or the keg isn’t indexed).
+  def find_in_keg(keg, basename, subdir = nil)
+    return unless entry = @kegs[keg.path.to_s]
+    basename = basename.to_s
+    rel = entry[2].detect{ |r| File.basename(r) == basename and (subdir.nil? or r.starts_with?("#{subdir}/")) }
+    keg.path/rel if rel
+  end
+
+  # Whether the given keg has been indexed.
+  def indexed?(keg); @kegs.has_key?(keg.path.to_s); end
+
+  # All the keg paths the index knows about, in a stable order.
+  def keg_paths; @kegs.keys.sort; end
+
+  private
+
+  def owner_for(keg_path)
+    unless entry = (@kegs[keg_path] || @strays[keg_path])  # Found the slow way; not (yet) indexed.
+      tab = Tab.for_keg(Pathname(keg_path)) rescue nil
+      entry = @strays[keg_path] = [File.basename(File.dirname(keg_path)), (tab.tap if tab), []]
+    end
+    Owner.new(keg_path, entry[0], entry[1])
+  end # owner_for
+
+  def linked_target(record); record.realpath.to_s if record.symlink?; rescue SystemCallError; nil; end
+
+  def leads_into?(name, keg_path)
+    @real_kegs ||= {}
+    real_keg = (@real_kegs[keg_path] ||= Pathname(keg_path).realpath.to_s)
+    Pathname(name).realpath.to_s.starts_with?("#{real_keg}/")
+  rescue SystemCallError
+    false
+  end # leads_into?
+
+  # What must stay the same for a rack’s entry to remain valid:  The rack’s own mtime (kegs added, removed or renamed), & where its
+  # opt & linked records point.
+  def rack_signature(rack)
+    name = rack.basename.to_s
+    [rack.mtime.to_i, linked_target(OPTDIR/name), linked_target(LINKDIR/name)]
+  end
+
+  def forget_rack(name)
+    return unless entry = @racks.delete(name)
+    entry[1].each do |keg_path|
+      @kegs.delete(keg_path)
+      @paths.delete_if{ |_, owner| owner == keg_path }
+    end
+    @dirty = true
+  end # forget_rack
+
+  def index_keg(keg_path, name, optlinked, linked)
+    root = Pathname(keg_path)
+    tab = Tab.for_keg(root) rescue nil
+    dylibs = []
+    root.find do |pn|
+      next unless pn.file? and pn.dylib?  # Follows symlinks, so versioned aliases (libfoo.1.dylib → libfoo.1.2.3.dylib) count too.
+      rel = pn.relative_path_from(root).to_s
+      dylibs << rel
+      @paths[pn.to_s] = keg_path
+      @paths[pn.realpath.to_s] ||= keg_path
+      @paths["#{OPTDIR}/#{name}/#{rel}"] = keg_path if optlinked
+      @paths["#{HOMEBREW_PREFIX}/#{rel}"] = keg_path if linked
+    end
+    @kegs[keg_path] = [name, (tab.tap if tab), dylibs]
+  end # index_keg
+end # LinkageIndex
@@ -96,6 +96,13 @@ module MachO  # only useable when included in Pathname
       0x0000000c => :MH_FILESET       # “set of Mach‐Os”
     }.freeze
   MAX_N_FAT = 30.freeze  # 3 times Apple’s historical limit
+  CPU_TYPE_ARCHS = {
+      0x00000007 => :i386,
+      0x00000012 => :ppc,
+      0x01000007 => :x86_64,
+      0x0100000c => :arm64,
+      0x01000012 => :ppc64,
+    }.freeze
 
   # Mach-O binary methods.  See <mach-o/loader.h> and <mach-o/fat.h>.
   # @private
@@ -115,13 +122,7 @@ module MachO  # only useable when included in Pathname
                                          # offset + 12, respectively) matter here.  One holds the CPU type & flags; the other holds
                                          # the Mach file type.
           sig, rvsd, cpu_type = machO_sig_at?(offset)
-          next unless sig == :MH_MAGIC and arch = case cpu_type
-                                                    when 0x00000007 then :i386
-                                                    when 0x00000012 then :ppc
-                                                    when 0x01000007 then :x86_64
-                                                    when 0x0100000c then :arm64
-                                                    when 0x01000012 then :ppc64
-                                                  end
+          next unless sig == :MH_MAGIC and arch = CPU_TYPE_ARCHS[cpu_type]
           data << { :arch => arch, :ftype => MACH_FILE_TYPE[binread(4, offset + 12).unpack(rvsd ? 'V' : 'N').first] }
         end # each offset
         data.uniq
@@ -143,6 +144,14 @@ module MachO  # only useable when included in Pathname
   end # arch
 
   def fat_container?; m = mach_data; @fat_container; end  # Generate @mach_data to ensure @fat_container is set correctly.
+
+  # The architecture of each slice in a fat container, as read from its `struct fat_arch` list.  Unlike #archs, this counts slices
+  # which are `ar` archives rather than Mach-O files, as in a universal static library.  Empty for anything not a fat container.
+  def fat_slice_archs
+    if (sig_array = machO_sig_at? 0) then sig, rvsd, n_fat = *sig_array; end
+    return [].extend(ALE) unless sig == :FAT_MAGIC and size >= n_fat * 20 + 8
+    (0...n_fat).map{ |i| CPU_TYPE_ARCHS[binread(4, 8 + 20*i).unpack(rvsd ? 'V' : 'N').first] }.compact.uniq.extend(ALE)
+  end # fat_slice_archs
   def fat?; archs.fat?; end
   def powerpc?; archs.powerpc?; end
   def intel?; archs.intel?; end
@@ -0,0 +1,310 @@
+require 'pathname'
+
+# Moves a Mach-O dylib’s preferred load address by rewriting the file in place.  Within each architecture slice, every segment &
+# section address, every symbol defined in a section, every local relocation (or, in newer files, every location the rebase info
+# names), every non‐lazy pointer to a local symbol, & the initialization routine’s address are slid together – just as dyld slides
+# them at launch when a library can’t be loaded at its preferred address.  Once no two libraries a process loads want the same
+# address, dyld needn’t slide anything; see {RebasePlanner}.
+#
+# Only what a dylib can safely hold is handled.  A slice with anything else – a code signature, split segments, or a relocation of a
+# kind dyld would not slide – raises UnsupportedError before anything is changed.
+class MachRebaser
+  class UnsupportedError < RuntimeError; end
+
+  # One architecture slice:  Where it starts in the file, its architecture, & the address span its segments occupy.  The rest is
+  # what rewriting it needs to know.
+  class Slice < Struct.new(:offset, :arch, :base, :size, :endian, :is64, :filetype, :flags, :commands, :segments); end
+
+  # One segment, & its sections.  Every “pos” is the position in the file of the field after which it is named.
+  class Segment < Struct.new(:pos, :vmaddr, :vmsize, :fileoff, :filesize, :initprot, :sections); end
+  class Section < Struct.new(:pos, :addr, :size, :offset, :flags, :reserved1); end
+
+  FAT_MAGIC = 0xcafebabe
+  MH_MAGIC = 0xfeedface
+  MH_MAGIC_64 = 0xfeedfacf
+  MH_DYLIB = 6
+  MH_SPLIT_SEGS = 0x20
+
+  LC_SEGMENT = 0x1
+  LC_SYMTAB = 0x2
+  LC_DYSYMTAB = 0xb
+  LC_ROUTINES = 0x11
+  LC_SEGMENT_64 = 0x19
+  LC_ROUTINES_64 = 0x1a
+  LC_CODE_SIGNATURE = 0x1d
+  LC_DYLD_INFO = 0x22
+  LC_DYLD_INFO_ONLY = 0x80000022
+
+  S_NON_LAZY_SYMBOL_POINTERS = 0x6
+  INDIRECT_SYMBOL_LOCAL = 0x80000000
+  N_STAB = 0xe0
+  N_TYPE = 0x0e
+  N_SECT = 0x0e
+  VM_PROT_WRITE = 0x2
+
+  # The scattered relocation type of a lazy pointer, which holds its target’s address in r_value.
+  PB_LA_PTR = { :ppc => 7, :ppc64 => 7, :i386 => 3 }.freeze
+
+  MASK = { false => 0xffffffff, true => 0xffffffffffffffff }.freeze
+
+  attr_reader :path, :slices
+
+  def initialize(path)
+    @path = Pathname.new(path.to_s)
+    @data = File.open(@path.to_s, 'rb') { |f| f.read }
+    @slices = find_slices
+  end # initialize
+
+  # Slides each slice named in “bases” (a hash of architecture => new base address) to that base.  Every slice is checked before
+  # any is changed.  Returns self.
+  def rebase(bases)
+    moving = @slices.select{ |s| bases[s.arch] and bases[s.arch] != s.base }
+    moving.each{ |s| check(s) }
+    moving.each{ |s| slide(s, bases[s.arch] - s.base) }
+    @slices = find_slices
+    self
+  end # rebase
+
+  # Writes the rewritten file back, keeping its permissions.
+  def write
+    @path.ensure_writable { @path.atomic_write(@data) }
+    self
+  end
+
+  private
+
+  def find_slices
+    if u32(0, 'N') == FAT_MAGIC
+      n = u32(4, 'N')
+      return [] if n > MachO::MAX_N_FAT  # A Java class file.
+      (0...n).map{ |i| slice_at(u32(8 + 20*i + 8, 'N')) }.compact
+    else [slice_at(0)].compact; end
+  end # find_slices
+
+  # Parses the Mach-O header & load commands at “off”; nil if there is no Mach-O file there (it might be an `ar` archive).
+  def slice_at(off)
+    return nil if @data.length < off + 28
+    e = [MH_MAGIC, MH_MAGIC_64].include?(u32(off, 'N')) ? 'N' \
+        : [MH_MAGIC, MH_MAGIC_64].include?(u32(off, 'V')) ? 'V' : nil
+    return nil unless e
+    is64 = (u32(off, e) == MH_MAGIC_64)
+    s = Slice.new(off, MachO::CPU_TYPE_ARCHS[u32(off + 4, e)], 0, 0, e, is64, u32(off + 12, e), u32(off + 24, e), [], [])
+    pos = off + (is64 ? 32 : 28)
+    u32(off + 16, e).times do
+      cmd, size = u32(pos, e), u32(pos + 4, e)
+      raise UnsupportedError, "#{@path} has a malformed load command" if size < 8 or pos + size > @data.length
+      s.commands << [cmd, pos]
+      s.segments << segment_at(s, pos) if cmd == (is64 ? LC_SEGMENT_64 : LC_SEGMENT)
+      pos += size
+    end
+    unless s.segments.empty?
+      s.base = s.segments.first.vmaddr
+      s.size = s.segments.map{ |seg| seg.vmaddr + seg.vmsize }.max - s.base
+    end
+    s
+  end # slice_at
+
+  def segment_at(s, pos)
+    if s.is64
+      seg = Segment.new(pos, u64(pos + 24, s.endian), u64(pos + 32, s.endian), u64(pos + 40, s.endian), u64(pos + 48, s.endian),
+                        u32(pos + 60, s.endian), [])
+      u32(pos + 64, s.endian).times do |i|
+        sp = pos + 72 + 80*i
+        seg.sections << Section.new(sp, u64(sp + 32, s.endian), u64(sp + 40, s.endian), u32(sp + 48, s.endian),
+                                    u32(sp + 64, s.endian), u32(sp + 68, s.endian))
+      end
+    else
+      seg = Segment.new(pos, u32(pos + 24, s.endian), u32(pos + 28, s.endian), u32(pos + 32, s.endian), u32(pos + 36, s.endian),
+                        u32(pos + 44, s.endian), [])
+      u32(pos + 48, s.endian).times do |i|
+        sp = pos + 56 + 68*i
+        seg.sections << Section.new(sp, u32(sp + 32, s.endian), u32(sp + 36, s.endian), u32(sp + 40, s.endian),
+                                    u32(sp + 56, s.endian), u32(sp + 60, s.endian))
+      end
+    end
+    seg
+  end # segment_at
+
+  def command(s, *cmds); (c = s.commands.detect{ |cmd, _| cmds.include? cmd }) ? c[1] : nil; end
+
+  def check(s)
+    raise UnsupportedError, "#{@path} (#{s.arch}) is not a dylib" unless s.filetype == MH_DYLIB
+    raise UnsupportedError, "#{@path} (#{s.arch}) has split segments" if s.flags & MH_SPLIT_SEGS != 0
+    raise UnsupportedError, "#{@path} (#{s.arch}) is code‐signed" if command(s, LC_CODE_SIGNATURE)
+    raise UnsupportedError, "#{@path} (#{s.arch}) has no segments" if s.segments.empty?
+    # A dry run over the relocations & rebase info finds anything unsupported before a byte is changed.
+    @dry_run = true
+    slide_pointers(s, 0)
+  ensure
+    @dry_run = false
+  end # check
+
+  def slide(s, delta)
+    slide_pointers(s, delta)
+    if symtab = command(s, LC_SYMTAB) then slide_symbols(s, symtab, delta); end
+    if dysymtab = command(s, LC_DYSYMTAB) then slide_module_table(s, dysymtab, delta); end
+    if routines = command(s, LC_ROUTINES, LC_ROUTINES_64) then add_word(s, routines + 8, delta); end
+    s.segments.each do |seg|
+      add_word(s, seg.pos + 24, delta)
+      seg.sections.each{ |sect| add_word(s, sect.pos + 32, delta) }
+    end
+  end # slide
+
+  # Slides the pointers dyld would slide:  Those the rebase info names, or else those with local relocations, along with non‐lazy
+  # pointers to local symbols.
+  def slide_pointers(s, delta)
+    dysymtab = command(s, LC_DYSYMTAB)
+    if dyld_info = command(s, LC_DYLD_INFO, LC_DYLD_INFO_ONLY)
+      slide_rebase_info(s, s.offset + u32(dyld_info + 8, s.endian), u32(dyld_info + 12, s.endian), delta)
+    elsif dysymtab
+      slide_local_relocations(s, dysymtab, delta)
+      slide_local_pointers(s, dysymtab, delta)
+    end
+  end # slide_pointers
+
+  # Local relocation addresses count from the first segment – or, for x86_64, from the first writable one.
+  def relocation_base(s)
+    seg = (s.arch == :x86_64) ? s.segments.detect{ |sg| sg.initprot & VM_PROT_WRITE != 0 } : s.segments.first
+    seg ? seg.vmaddr : s.base
+  end
+
+  def slide_local_relocations(s, dysymtab, delta)
+    e = s.endian
+    off, n = u32(dysymtab + 72, e), u32(dysymtab + 76, e)
+    base = relocation_base(s)
+    n.times do |i|
+      pos = s.offset + off + 8*i
+      w0, w1 = u32(pos, e), u32(pos + 4, e)
+      if s.arch != :x86_64 and w0 & 0x80000000 != 0  # Scattered:  The address is in w0, & the target’s address in w1.
+        type, length, pcrel = (w0 >> 24) & 0xf, (w0 >> 28) & 3, (w0 & 0x40000000 != 0)
+        unless length == 2 and not pcrel and (type == 0 or type == PB_LA_PTR[s.arch])
+          raise UnsupportedError, "#{@path} (#{s.arch}) has a scattered relocation of type #{type}"
+        end
+        at = file_pos(s, base + (w0 & 0xffffff))
+        next if @dry_run
+        # A lazy pointer still aimed at its stub helper moves with it; one prebound to another library does not.
+        set_u32(at, u32(at, e) + delta, e) if type == 0 or u32(at, e) == w1
+        set_u32(pos + 4, w1 + delta, e)
+      else
+        if e == 'V' then pcrel, length, extern, type = (w1 >> 24) & 1, (w1 >> 25) & 3, (w1 >> 27) & 1, w1 >> 28
+        else pcrel, length, extern, type = (w1 >> 7) & 1, (w1 >> 5) & 3, (w1 >> 4) & 1, w1 & 0xf; end
+        unless type == 0 and pcrel == 0 and extern == 0 and length >= 2
+          raise UnsupportedError, "#{@path} (#{s.arch}) has a local relocation of type #{type}"
+        end
+        at = file_pos(s, base + w0)
+        next if @dry_run
+        if length == 3 then set_u64(at, u64(at, e) + delta, e)
+        else set_u32(at, u32(at, e) + delta, e); end
+      end
+    end # each relocation
+  end # slide_local_relocations
+
+  def slide_local_pointers(s, dysymtab, delta)
+    return if @dry_run
+    e = s.endian
+    indirect = s.offset + u32(dysymtab + 56, e)
+    width = s.is64 ? 8 : 4
+    s.segments.each do |seg|
+      seg.sections.each do |sect|
+        next unless sect.flags & 0xff == S_NON_LAZY_SYMBOL_POINTERS
+        (sect.size / width).times do |i|
+          next unless u32(indirect + 4*(sect.reserved1 + i), e) == INDIRECT_SYMBOL_LOCAL  # Not also INDIRECT_SYMBOL_ABS.
+          add_word(s, s.offset + sect.offset + width*i, delta)
+        end
+      end
+    end
+  end # slide_local_pointers
+
+  # Walks the rebase opcodes (see <mach-o/loader.h>), sliding each location they name.
+  def slide_rebase_info(s, pos, size, delta)
+    stop = pos + size
+    width = s.is64 ? 8 : 4
+    type = 0; seg = nil; seg_off = 0
+    rebase = lambda do
+      raise UnsupportedError, "#{@path} (#{s.arch}) has rebase info outside any segment" unless seg
+      at = s.offset + seg.fileoff + seg_off
+      case type
+        when 1 then add_word(s, at, delta) unless @dry_run
+        when 2 then set_u32(at, u32(at, s.endian) + delta, s.endian) unless @dry_run
+        when 3 then set_u32(at, u32(at, s.endian) - delta, s.endian) unless @dry_run
+        else raise UnsupportedError, "#{@path} (#{s.arch}) has rebase info of type #{type}"
+      end
+    end
+    while pos < stop
+      byte = @data[pos, 1].unpack('C').first; pos += 1
+      imm = byte & 0x0f
+      case byte & 0xf0
+        when 0x00 then break
+        when 0x10 then type = imm
+        when 0x20 then seg = s.segments[imm]; seg_off, pos = uleb(pos)
+        when 0x30 then n, pos = uleb(pos); seg_off = (seg_off + n) & MASK[true]
+        when 0x40 then seg_off += imm * width
+        when 0x50 then imm.times{ rebase.call; seg_off += width }
+        when 0x60 then n, pos = uleb(pos); n.times{ rebase.call; seg_off += width }
+        when 0x70 then rebase.call; n, pos = uleb(pos); seg_off = (seg_off + n + width) & MASK[true]
+        when 0x80
+          n, pos = uleb(pos); skip, pos = uleb(pos)
+          n.times{ rebase.call; seg_off += skip + width }
+        else raise UnsupportedError, "#{@path} (#{s.arch}) has an unknown rebase opcode #{byte}"
+      end
+    end # while opcodes remain
+  end # slide_rebase_info
+
+  def slide_symbols(s, symtab, delta)
+    e = s.endian
+    off, n = u32(symtab + 8, e), u32(symtab + 12, e)
+    width = s.is64 ? 16 : 12
+    n.times do |i|
+      pos = s.offset + off + width*i
+      n_type, n_sect = @data[pos + 4, 2].unpack('CC')
+      in_section = (n_type & N_STAB != 0) ? n_sect != 0 : (n_type & N_TYPE == N_SECT)
+      add_word(s, pos + 8, delta) if in_section
+    end
+  end # slide_symbols
+
+  # The module table’s entries each record the address of their Objective-C module info, if any.
+  def slide_module_table(s, dysymtab, delta)
+    e = s.endian
+    off, n = u32(dysymtab + 40, e), u32(dysymtab + 44, e)
+    n.times do |i|
+      pos = s.offset + off + (s.is64 ? 56*i + 48 : 52*i + 44)
+      add_word(s, pos, delta) unless (s.is64 ? u64(pos, e) : u32(pos, e)) == 0
+    end
+  end # slide_module_table
+
+  # The position in the file of the (old) address “addr”.
+  def file_pos(s, addr)
+    seg = s.segments.detect{ |sg| addr >= sg.vmaddr and addr < sg.vmaddr + sg.filesize }
+    raise UnsupportedError, "#{@path} (#{s.arch}) relocates an address outside its file" unless seg
+    s.offset + seg.fileoff + (addr - seg.vmaddr)
+  end
+
+  def uleb(pos)
+    value = 0; shift = 0
+    begin
+      byte = @data[pos, 1].unpack('C').first; pos += 1
+      value |= (byte & 0x7f) << shift; shift += 7
+    end while byte & 0x80 != 0
+    [value, pos]
+  end # uleb
+
+  def add_word(s, pos, delta)
+    if s.is64 then set_u64(pos, u64(pos, s.endian) + delta, s.endian)
+    else set_u32(pos, u32(pos, s.endian) + delta, s.endian); end
+  end
+
+  def u32(pos, e); @data[pos, 4].unpack(e).first; end
+
+  def set_u32(pos, value, e); @data[pos, 4] = [value & MASK[false]].pack(e); end
+
+  def u64(pos, e)
+    hi, lo = (e == 'N') ? [u32(pos, e), u32(pos + 4, e)] : [u32(pos + 4, e), u32(pos, e)]
+    (hi << 32) | lo
+  end
+
+  def set_u64(pos, value, e)
+    value &= MASK[true]
+    hi, lo = value >> 32, value & MASK[false]
+    @data[pos, 8] = (e == 'N') ? [hi, lo].pack('NN') : [lo, hi].pack('VV')
+  end
+end # MachRebaser
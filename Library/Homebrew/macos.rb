@@ -84,7 +84,7 @@ module MacOS
     # xcode-select was introduced in Xcode 3 on Leopard
     @active_developer_dir ||= Pathname(version < :leopard \
         ? '/Developer' \
-        : Utils.popen_read('/usr/bin/xcode-select', '-print-path').strip
+        : HostProbe.fetch(:active_developer_dir) { Utils.popen_read('/usr/bin/xcode-select', '-print-path').strip }
       )
   end # active_developer_dir
 
@@ -1,12 +1,15 @@
 require "set"
 require "keg"
 require "formula"
+require "linkage_index"
 
 class LinkageChecker
   attr_reader :keg, :formula, :brewed_dylibs, :system_dylibs, :broken_dylibs, :variable_dylibs, :undeclared_deps, :reverse_links
 
-  def initialize(keg, formula = nil)
+  # “index” is the {LinkageIndex} to resolve dylib owners through; the current Cellar’s, unless one is supplied.
+  def initialize(keg, formula = nil, index = LinkageIndex.instance)
     @keg = keg
+    @index = index
     @formula = formula || resolve_formula(keg)
     @brewed_dylibs = Hash.new { |h, k| h[k] = Set.new }
     @system_dylibs = Set.new
@@ -26,13 +29,11 @@ class LinkageChecker
         if dylib.starts_with? '@'
           @variable_dylibs << dylib
         else
-          begin owner = Keg.for dylib
-          rescue NotAKegError; @system_dylibs << dylib
+          begin owner = @index.owner_of dylib
           rescue Errno::ENOENT; @broken_dylibs << dylib
           else
-            t = Tab.for_keg(owner); tap = t.tap if t
-            f_name = (not tap or CORE_OWNERS.include? tap) ? owner.name : "#{tap}/#{owner.name}"
-            @brewed_dylibs[f_name] << dylib
+            if owner then @brewed_dylibs[owner.formula_name] << dylib
+            else @system_dylibs << dylib; end
           end
         end # does dylib start with '@'?
       end # each |dylib|
@@ -41,11 +41,9 @@ module MacOS
 
     def outdated?; version < latest_version; end
 
+    # Remembered between runs (see HostProbe), as finding it may mean asking Spotlight.
     def prefix
-      dir = MacOS.active_developer_dir
-      @prefix ||= (dir.nil? or dir.to_s == MacOS::CLT::MAVERICKS_PKG_PATH or not dir.directory?) \
-                    ? if (path = bundle_path) then path/'Contents/Developer'; end \
-                    : dir
+      @prefix ||= if (found = HostProbe.fetch(:xcode_prefix) { uncached_prefix }) then Pathname(found); end
     end # prefix
 
     def provides_autotools?; (version < "4.3") && (version > "2.5"); end  # Xcode 2.5's autotools are now too old to rely on.
@@ -56,13 +54,22 @@ module MacOS
 
     def toolchain_path; Pathname("#{prefix}/Toolchains/XcodeDefault.xctoolchain") if installed? and version >= "4.3"; end
 
-    # This may return nil or a version string guessed based on the compiler, so don’t use it to check if Xcode is installed.
-    def version; @version ||= uncached_version; end
+    # This may return nil or a version string guessed based on the compiler, so don’t use it to check if Xcode is installed.  It is
+    # remembered between runs (see HostProbe).
+    def version; @version ||= HostProbe.fetch(:xcode_version) { uncached_version }; end
 
     def without_clt?; installed? and version >= "4.3" and not MacOS::CLT.installed?; end
 
     private
 
+    def uncached_prefix
+      dir = MacOS.active_developer_dir
+      path = (dir.nil? or dir.to_s == MacOS::CLT::MAVERICKS_PKG_PATH or not dir.directory?) \
+               ? if (path = bundle_path) then path/'Contents/Developer'; end \
+               : dir
+      path.to_s if path
+    end # uncached_prefix
+
     # This had to be factored out as you can’t cache a block’s value when you return from the middle, which we do many times here.
     def uncached_version
       return nil unless MacOS::Xcode.installed? or MacOS::CLT.installed?
@@ -114,7 +121,7 @@ module MacOS
       }.freeze
 
     # Returns true even if outdated tools are installed, e.g. tools from Xcode 4.x on 10.9
-    def installed?; !!detect_version; end
+    def installed?; !!version; end
 
     def latest_clang_version; (found = LATEST_CLANG[MacOS.version]) ? found : raise("Mac OS “#{MacOS.version}” is unknown"); end
 
@@ -125,7 +132,8 @@ module MacOS
     end
 
     # Version string (a pretty long one) of the CLT package.  Note that installing it differently yields different version numbers.
-    def version; @version ||= detect_version; end
+    # It is remembered between runs (see HostProbe).
+    def version; @version ||= HostProbe.fetch(:clt_version) { detect_version }; end
 
     def detect_version
       # CLT wasn’t a distinct entity pre-4.3, and pkgutil doesn’t exist at all on Tiger, so just call it installed if Xcode is.
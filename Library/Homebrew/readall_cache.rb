@@ -0,0 +1,54 @@
+require 'digest/sha2'
+
+# Remembers which formula files `brew readall` found sound, so that the next run need only load the ones that have changed.  A file
+# is passed over while its content (by SHA-256) is what it was when it last loaded cleanly; files that failed are always tried again.
+#
+# Whether a file loads depends on Homebrew’s own code & on the Ruby running it as well as on the file, so the record is kept under a
+# stamp of both – the path, size & mtime of every library file, & the Ruby version – and is discarded whole when that changes.
+class ReadallCache
+  CACHE_FILE = HOMEBREW_CACHE/'readall.marshal'
+  LOCK_FILE = HOMEBREW_CACHE/'readall.lock'
+  FORMAT_VERSION = 1
+
+  class << self
+    def load
+      new(read)
+    rescue StandardError
+      new  # A corrupt or foreign record is simply started afresh.
+    end
+
+    def read; CACHE_FILE.open('rb') { |f| Marshal.load(f) } if CACHE_FILE.file?; end
+
+    def digest(file); Digest::SHA256.file(file.to_s).hexdigest; end
+
+    # What must stay the same for the record to remain valid.
+    def library_stamp
+      files = Dir["#{HOMEBREW_RUBY_LIBRARY}/**/*.rb"].reject{ |f| f.include?('/vendor/') or f.include?('/test/') }.sort
+      Digest::SHA256.hexdigest(files.map{ |f| st = File.stat(f); "#{f} #{st.size} #{st.mtime.to_i}\n" }.join + RUBY_VERSION)
+    end
+  end # << self
+
+  def initialize(data = nil)
+    @stamp = self.class.library_stamp
+    @passed = (data.is_a?(Hash) and data[:format] == FORMAT_VERSION and data[:stamp] == @stamp) ? data[:passed] : {}  # path => SHA-256
+    @changed = false
+  end
+
+  # Whether “file” loaded cleanly as it now stands.
+  def passed?(file, sha256 = self.class.digest(file)); @passed[file.to_s] == sha256; end
+
+  def pass(file, sha256); @passed[file.to_s] = sha256; @changed = true; self; end
+
+  def fail(file); @changed = true if @passed.delete(file.to_s); self; end
+
+  def save
+    return self unless @changed
+    HOMEBREW_CACHE.mkpath
+    LOCK_FILE.open(File::RDWR | File::CREAT) do |lock|
+      lock.flock(File::LOCK_EX)
+      CACHE_FILE.atomic_write Marshal.dump(:format => FORMAT_VERSION, :stamp => @stamp, :passed => @passed)
+    end
+    @changed = false
+    self
+  end # save
+end # ReadallCache
@@ -0,0 +1,163 @@
+require 'keg'
+require 'mach_rebaser'
+require 'utils/fork'
+
+# Gives every brewed dylib a preferred load address clear of every other’s, so dyld need not slide any of them at launch.  Our dylibs
+# are all linked to load at address 0, so each one a process loads after the first must be slid:  Every pointer it holds to itself
+# is rewritten, dirtying pages that would otherwise be shared straight from the file.  Tiger & Leopard feel this the most, as their
+# dyld can also use prebinding (see redo_prebinding(1)), which only holds good for libraries loaded where they asked to be.
+#
+# The plan – which addresses each dylib’s slices were given – lives in HOMEBREW_CACHE, so that after an installation only the new
+# keg’s dylibs need places found.  A dylib keeps its place for as long as it still fits; places of dylibs that have gone are freed.
+# Addresses are handed out first‐fit, per architecture, from a region clear of Apple’s own libraries.  A dylib the rewriter can’t
+# handle is left where it was, without a place.
+class RebasePlanner
+  PLAN_FILE = HOMEBREW_CACHE/'rebase_plan.marshal'
+  LOCK_FILE = HOMEBREW_CACHE/'rebase_plan.lock'
+  FORMAT_VERSION = 1
+
+  # The address ranges handed out, for 32‐ & 64‐bit slices.  Both start above where executables load, and stop short of the system
+  # libraries.
+  REGIONS = { false => [0x20000000, 0x8fe00000], true => [0x200000000, 0x7fff00000000] }.freeze
+  ALIGNMENT = 0x1000
+
+  # What the plan holds for one dylib:  Each slice’s place as an architecture => [base, size] hash, & the file’s size & mtime as of
+  # when it was last found at those places.
+  class Entry < Struct.new(:places, :stamp); end
+
+  class << self
+    # Whether to rebase as kegs are installed:  Always on Tiger & Leopard, or elsewhere when $HOMEBREW_REBASE is set.
+    def wanted?
+      return false if ENV['HOMEBREW_NO_REBASE'].choke
+      MacOS.version <= :leopard or ENV['HOMEBREW_REBASE'].choke
+    end
+
+    # Loads the plan, rebases the given kegs’ dylibs according to it, & saves it, all under a lock so that concurrent installations
+    # never hand out the same place twice.  See #rebase for the options.
+    def run(kegs, options = {})
+      locked do
+        planner = load
+        rewritten = planner.rebase(kegs, options)
+        planner.save unless options[:dry_run]
+        rewritten
+      end
+    end # RebasePlanner::run
+
+    def load
+      new(PLAN_FILE.file? ? PLAN_FILE.open('rb') { |f| Marshal.load(f) } : nil)
+    rescue StandardError
+      new  # A corrupt or foreign plan is simply started afresh.
+    end
+
+    def locked
+      HOMEBREW_CACHE.mkpath
+      LOCK_FILE.open(File::RDWR | File::CREAT) do |lock|
+        lock.flock(File::LOCK_EX)
+        yield
+      end
+    end # RebasePlanner::locked
+  end # << self
+
+  def initialize(data = nil)
+    @entries = compatible?(data) ? data[:entries] : {}  # path => Entry
+  end
+
+  # Every dylib in the plan, by path.
+  def paths; @entries.keys.sort; end
+
+  # The place (as [base, size]) the plan gives the named file’s slice for “arch”, if any.
+  def place_of(path, arch); (e = @entries[path.to_s]) ? e.places[arch] : nil; end
+
+  # Finds places for the dylibs in “kegs”, & moves each one not already at its place there – “:jobs” at a time (by default, one per
+  # CPU core).  With “:dry_run”, nothing is written.  With “:prebind”, the kegs’ dylibs are then prebound, if redo_prebinding(1) is
+  # available.  Returns the paths of the dylibs that were (or would be) moved.
+  def rebase(kegs, options = {})
+    forget_missing
+    work = plan(kegs.map{ |keg| keg.mach_o_files.select(&:dylib?) }.flatten)
+    return work.map(&:first) if options[:dry_run]
+    results = Utils.parallel_map(work, options[:jobs] || CPU.cores) do |path, bases|
+      begin
+        MachRebaser.new(path).rebase(bases).write
+        nil
+      rescue MachRebaser::UnsupportedError => e
+        e.message
+      end
+    end
+    rewritten = []
+    work.zip(results).each do |(path, _), failure|
+      if failure
+        opoo "Not rebasing #{failure}" if DEBUG
+        @entries.delete(path.to_s)
+      else
+        @entries[path.to_s].stamp = stamp_of(path)
+        rewritten << path
+      end
+    end
+    prebind(kegs) if options[:prebind]
+    rewritten
+  end # rebase
+
+  # Finds a place for each slice of each of “files”, keeping existing places that still fit.  Returns, for each file not already at
+  # its places, the file & an architecture => base hash.
+  def plan(files)
+    work = []
+    files.each do |pn|
+      key = pn.to_s
+      stamp = stamp_of(pn)
+      next if (e = @entries[key]) and e.stamp == stamp  # Untouched since it was put in its place.
+      slices = (MachRebaser.new(pn).slices rescue [])
+      next if slices.empty?
+      old = e ? e.places : {}
+      places = {}
+      slices.each do |s|
+        size = align(s.size)
+        had = old[s.arch]
+        places[s.arch] = (had and had[1] >= size) ? had : find_place(s.arch, s.is64, size, key)
+      end
+      places.delete_if{ |_, place| place.nil? }
+      if places.empty? then @entries.delete(key); next; end
+      @entries[key] = Entry.new(places, nil)
+      if slices.all?{ |s| places[s.arch].nil? or places[s.arch][0] == s.base }
+        @entries[key].stamp = stamp
+      else
+        work << [pn, Hash[*places.map{ |arch, place| [arch, place[0]] }.flatten]]
+      end
+    end # each file
+    work
+  end # plan
+
+  def save
+    PLAN_FILE.atomic_write Marshal.dump(:format => FORMAT_VERSION, :cellar => HOMEBREW_CELLAR.to_s, :entries => @entries)
+    self
+  end
+
+  private
+
+  def compatible?(data); data.is_a?(Hash) and data[:format] == FORMAT_VERSION and data[:cellar] == HOMEBREW_CELLAR.to_s; end
+
+  def forget_missing; @entries.delete_if{ |path, _| not File.file?(path) }; end
+
+  def stamp_of(pn); st = File.stat(pn.to_s); [st.size, st.mtime.to_i]; end
+
+  def align(n); (n + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; end
+
+  # The lowest base in the region where “size” octets fit between the places already given for “arch” (bar those of the file “key”,
+  # which is being placed afresh); nil if there is no room.
+  def find_place(arch, is64, size, key)
+    low, high = REGIONS[is64]
+    taken = @entries.map{ |path, e| e.places[arch] unless path == key }.compact.sort
+    base = low
+    taken.each do |b, sz|
+      break if base + size <= b
+      base = [base, b + sz].max
+    end
+    [base, size] if base + size <= high
+  end # find_place
+
+  def prebind(kegs)
+    return unless tool = MacOS.locate('redo_prebinding')
+    kegs.each do |keg|
+      keg.mach_o_files.select(&:dylib?).each{ |pn| quiet_system tool.to_s, '-i', pn.to_s }
+    end
+  end # prebind
+end # RebasePlanner
@@ -70,7 +70,7 @@ class SoftwareSpec
   attr_reader :bottle_specification, :build, :compiler_failures, :dependency_collector, :deprecated_actuals, :deprecated_options,
               :active_enhancements, :named_enhancements, :patches, :resources, :symbol
 
-  def_delegators :@resource, :cached_download, :checksum, :clear_cache, :fetch, :mirror, :mirrors, :specs, :stage, :using,
+  def_delegators :@resource, :cached_download, :checksum, :clear_cache, :downloader, :fetch, :mirror, :mirrors, :specs, :stage, :using,
                              :verify_download_integrity, :version, *Checksum::TYPES
 
   def initialize(symbol = :stable)
@@ -0,0 +1,84 @@
+# Unpacks a compressed tarball into the current directory, for staging sources.  The decompressor writes straight into `tar` through a
+# pipe – nothing passes through Ruby, & nothing is written to disk but the unpacked files – and `tar` keeps the archived permissions
+# & symbolic links.
+#
+# Where a parallel decompressor is installed (lbzip2 or pbzip2 for bzip2, pigz for gzip, plzip for lzip), it is used in preference
+# to the stock tool, as is xz’s own threading; each is given as many threads as the make‐jobs budget allows, up to one per CPU core.
+# lbzip2 & pbzip2 split a bzip2 stream at its block boundaries and decompress the blocks side by side, as xz & plzip do for their
+# formats’ independent blocks; pigz cannot split a gzip stream, but still moves reading, checksumming & writing onto threads of their
+# own.  Otherwise the stock tool is used alone.
+class StagingExtractor
+  # For each compression type, the decompressors to look for, best first, each with (if it takes one) the switch setting its thread
+  # count.
+  DECOMPRESSORS = {
+    :bzip2 => [['lbzip2', '-n %d'], ['pbzip2', '-p%d'], ['bzip2']],
+    :gzip  => [['pigz', '-p %d'], ['gzip']],
+    :lzip  => [['plzip', '-n %d'], ['lzip']],
+    :xz    => [['xz', '-T %d']],
+    :zstd  => [['zstd']],
+  }.freeze
+
+  class << self
+    def handles?(type); DECOMPRESSORS.key? type; end
+
+    # Where to find a tool:  The brewed one if installed, else the system’s, if any.
+    def locate(tool)
+      brewed = OPTDIR/tool/'bin'/tool
+      brewed.executable? ? brewed : which(tool, '/usr/bin:/bin')
+    end
+
+    # Whether the xz at “path” understands the threads switch, which arrived with XZ Utils 5.
+    def xz_threads?(path); (Utils.popen_read(path.to_s, '--version')[/(\d+)\.\d+/, 1] || 0).to_i >= 5; end
+  end # << self
+
+  attr_reader :type, :threads
+
+  def initialize(type, threads = nil)
+    raise ArgumentError, "Can’t stream‐extract #{type} archives" unless self.class.handles? type
+    @type = type
+    @threads = (threads || [ENV.make_jobs.to_i, CPU.cores].min).to_i
+    @threads = 1 if @threads < 1
+  end # initialize
+
+  # The command line (less the archive) of the best decompressor available.
+  def decompressor
+    DECOMPRESSORS[@type].each do |tool, switch|
+      next unless path = self.class.locate(tool)
+      args = [path.to_s, '-dc']
+      args += (switch % @threads).split(' ') if switch and @threads > 1 and (tool != 'xz' or self.class.xz_threads?(path))
+      return args
+    end
+    raise "No #{DECOMPRESSORS[@type].last.first} could be found to unpack this #{@type} archive"
+  end # decompressor
+
+  # Unpacks “archive” into the current directory.
+  def untar(archive)
+    unpack = decompressor + [archive.to_s]
+    untar = [TAR_PATH.to_s, '-xipf', '-']
+    rd, wr = IO.pipe
+    unpacker = fork do
+      begin
+        rd.close
+        $stdout.reopen(wr)
+        exec(*unpack)
+      rescue Exception
+        exit! 1
+      end
+    end
+    untarrer = fork do
+      begin
+        wr.close
+        $stdin.reopen(rd)
+        exec(*untar)
+      rescue Exception
+        exit! 1
+      end
+    end
+    rd.close; wr.close
+    Process.wait(untarrer); untarred = $?.success?
+    Process.wait(unpacker); unpacked = $?.success?
+    raise ErrorDuringExecution.new(untar.first, untar[1..-1]) unless untarred
+    raise ErrorDuringExecution.new(unpack.first, unpack[1..-1]) unless unpacked
+    self
+  end # untar
+end # StagingExtractor
@@ -19,6 +19,7 @@ class Tab < OpenStruct
         'built_archs'        => archs,
         'built_as_bottle'    => formula.build.bottle?,
         'compiler'           => compiler,
+        'dependencies'       => dependency_names(formula),
         'git_head_SHA1'      => Homebrew.git_head,
         'poured_from_bottle' => false,
         'source'             => {
@@ -44,6 +45,7 @@ class Tab < OpenStruct
         'built_archs'        => [],
         'built_as_bottle'    => false,
         'compiler'           => nil,
+        'dependencies'       => nil,
         'git_head_SHA1'      => nil,
         'poured_from_bottle' => false,
         'source'             => {
@@ -60,6 +62,13 @@ class Tab < OpenStruct
       new(attributes)
     end # Tab::empty
 
+    # The full names of the formulæ a build depends on:  Those it declares, less any optional or recommended ones not used.
+    def dependency_names(formula)
+      formula.deps.reject{ |dep| dep.discretionary? and not formula.build.with?(dep) }.map{ |dep|
+        dep.to_formula.full_name rescue dep.name
+      }
+    end
+
     def for_formula?(f, prefer = :current)  # Pass _anything_ else to prefer an active version over the latest one.
       paths = []
       if prefer == :current
@@ -212,6 +221,7 @@ class Tab < OpenStruct
       'built_archs'        => built_archs.map(&:to_s),
       'built_as_bottle'    => built_as_bottle,
       'compiler'           => compiler.to_s,
+      'dependencies'       => dependencies,
       'git_head_SHA1'      => git_head_SHA1,
       'poured_from_bottle' => poured_from_bottle,
       'source'             => source,
@@ -0,0 +1,77 @@
+# Stand‐ins for `otool -L`, `lipo` & `install_name_tool`, for running the benchmarks where Apple’s tools don’t exist.  The runner
+# installs a wrapper for each as HOMEBREW_PREFIX/opt/cctools/bin/<tool> – where MacOS.otool & friends look first – which runs this as
+#     ruby cctools.rb <tool> <arguments>
+# Only the forms Homebrew itself uses are understood, & only for files MachOFixture can read; the output is formatted as Apple’s
+# tools format it, since that is what Homebrew parses.
+require File.expand_path('../mach_o_fixture', __FILE__)
+
+module StandInTools
+  module_function
+
+  def read(file); File.open(file, 'rb') { |f| f.read }; end
+
+  def write(file, data); File.open(file, 'wb') { |f| f.write(data) }; end
+
+  def usage(tool); abort "#{tool} (stand‐in):  unsupported usage"; end
+
+  # Lists a file’s install names, its own first if it is a dylib.  A fat file is listed for its first architecture only, as `otool`
+  # lists one for the host’s.
+  def otool(args)
+    usage('otool') unless args.length == 2 and args.first == '-L'
+    file = args.last
+    slice = MachOFixture.parse(MachOFixture.slices(read(file)).first[1])
+    puts "#{file}:"
+    ([slice.id] + slice.dylibs).compact.each{ |name| puts "\t#{name} (compatibility version 1.0.0, current version 1.0.0)" }
+  end # otool
+
+  def lipo(args)
+    output = (i = args.index('-output')) ? args.slice!(i, 2).last : nil
+    if args.first == '-info'
+      file = args[1]
+      archs = MachOFixture.slices(read(file)).map{ |arch, _| arch }
+      if MachOFixture.fat?(read(file)) then puts "Architectures in the fat file: #{file} are: #{archs * ' '} "
+      else puts "Non-fat file: #{file} is architecture: #{archs.first}"; end
+    elsif args.first == '-create' and output
+      write(output, MachOFixture.build(args[1..-1].map{ |f| data = read(f); [MachOFixture.arch_of(data), data] }))
+    elsif output and (args.include?('-thin') or args.include?('-extract'))  # Each flag takes an arch; what remains is the file.
+      wanted = []
+      while (i = args.index('-thin') || args.index('-extract')) do wanted << args.slice!(i, 2).last.to_sym; end
+      kept = MachOFixture.slices(read(args.first)).select{ |arch, _| wanted.include?(arch) }
+      abort "lipo (stand‐in):  #{args.first} does not contain #{wanted * ', '}" if kept.empty?
+      write(output, MachOFixture.build(kept))
+    else usage('lipo'); end
+  end # lipo
+
+  # Rewrites every slice, as the real tool does; fails, as it does, if the longer names no longer fit in the header padding.
+  def install_name_tool(args)
+    file = args.pop
+    id = nil
+    changes = {}
+    until args.empty?
+      case args.shift
+        when '-id'     then id = args.shift
+        when '-change' then old = args.shift; changes[old] = args.shift
+        else usage('install_name_tool')
+      end
+    end
+    slices = MachOFixture.slices(read(file)).map do |arch, data|
+      slice = MachOFixture.parse(data)
+      slice.id = id if id and slice.id
+      slice.dylibs = slice.dylibs.map{ |name| changes.fetch(name, name) }
+      slice
+    end
+    write(file, MachOFixture.build(slices))
+  rescue MachOFixture::Error => e
+    abort "install_name_tool (stand‐in):  #{e.message}:  #{file}"
+  end # install_name_tool
+end # StandInTools
+
+if $0 == __FILE__
+  tool = ARGV.shift
+  StandInTools.usage(tool) unless %w[otool lipo install_name_tool].include?(tool)
+  begin
+    StandInTools.send(tool, ARGV.dup)
+  rescue MachOFixture::Error, SystemCallError => e
+    abort "#{tool} (stand‐in):  #{e.message}"
+  end
+end
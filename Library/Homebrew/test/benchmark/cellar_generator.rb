@@ -0,0 +1,178 @@
+require 'keg'
+require 'tab'
+require File.expand_path('../mach_o_fixture', __FILE__)
+
+# Fills the sandbox with a synthetic installation:  “kegs” core formulæ, each installed & optlinked, each keg holding “files” files.
+#
+# Every keg has what a typical autotools build leaves – a fat dylib (& its unversioned symlink), a fat executable & a fat bundle that
+# link against it, a static library (fat, with an `ar` archive per architecture), a libtool archive, a pkg-config file, a `-config`
+# script, & a header – all as the build left them:  Install names still point into the Cellar, as they do before fix_install_names.
+# The rest of the “files” are documentation (a third of it mentioning the prefix), more headers, binary data, & a farm of symbolic
+# links to the documentation.  Formula number i depends on numbers i/2, i/3 & i − 7 (where those are lower), so the dependency graph
+# is broad near the bottom & deep at the top; every fifth formula has moved on to version 1.1, leaving its keg outdated.
+class CellarGenerator
+  KEG_VERSION = '1.0'
+  SYSTEM_DYLIBS = %w[/usr/lib/libSystem.B.dylib /usr/lib/libiconv.2.dylib].freeze
+  FIXED_FILES = 10  # Files every keg has, however few are asked for.
+
+  attr_reader :kegs, :files, :archs
+
+  def initialize(kegs, files, archs)
+    @kegs, @files, @archs = kegs, [files, FIXED_FILES].max, archs
+    @built = {}  # Mach-O path => its data as built; absolute symlink path => its target.
+  end
+
+  def name(i); format('bench%04d', i); end
+
+  def names; (0...kegs).map{ |i| name(i) }; end
+
+  def deps(i); [i / 2, i / 3, i - 7].select{ |j| j >= 0 and j < i }.uniq; end
+
+  def version(i); i % 5 == 4 ? '1.1' : KEG_VERSION; end
+
+  def formula_path(i); HOMEBREW_LIBRARY/'Formula'/name(i)[0, 1]/"#{name(i)}.rb"; end
+
+  def keg_path(i); HOMEBREW_CELLAR/name(i)/KEG_VERSION; end
+
+  def formula_paths; (0...kegs).map{ |i| formula_path(i) }; end
+
+  def keg_objects; (0...kegs).map{ |i| Keg.new(keg_path(i)) }; end
+
+  def generate
+    (0...kegs).each do |i|
+      write_formula(i)
+      write_keg(i)
+      Keg.new(keg_path(i)).optlink
+    end
+    self
+  end # generate
+
+  # Puts a keg’s Mach-O files & absolute symbolic links back as they were built, undoing fix_install_names.
+  def restore(keg)
+    prefix = "#{keg.path}/"
+    @built.each do |path, built|
+      next unless path.starts_with?(prefix)
+      if built.is_a?(Pathname) then FileUtils.ln_sf built.to_s, path
+      else File.open(path, 'wb') { |f| f.write(built) }; end
+    end
+  end # restore
+
+  private
+
+  def write(path, content, binary = false)
+    path.dirname.mkpath
+    path.open(binary ? 'wb' : 'w') { |f| f.write(content) }
+  end
+
+  # Bytes standing in for code:  A function prologue, over & over.
+  def code(octets); "\x55\x89\xe5\x83\xec\x18\x90\x90".unpack('C*').pack('C*') * (octets / 8); end
+
+  def write_mach_o(path, filetype, id, dylibs, octets)
+    data = MachOFixture.build(archs.map{ |a| MachOFixture::Slice.new(a, filetype, id, dylibs, code(octets)) })
+    write(path, data, true)
+    @built[path.to_s] = data
+  end # write_mach_o
+
+  def write_formula(i)
+    n = name(i)
+    write formula_path(i), <<-EOS.undent
+      class #{Formulary.class_s(n)} < Formula
+        desc "Synthetic formula #{i}, for benchmarking"
+        homepage "https://example.com/#{n}"
+        url "https://example.com/#{n}-#{version(i)}.tar.gz"
+        sha256 "#{format('%064x', i)}"
+
+        option :universal
+        option "with-extras", "Build the extras as well"
+
+        #{deps(i).map{ |j| %(depends_on "#{name(j)}") } * "\n  "}
+
+        def install
+          system "./configure", "--prefix=\#{prefix}"
+          system "make", "install"
+        end
+      end
+    EOS
+  end # write_formula
+
+  def write_keg(i)
+    n = name(i)
+    keg = keg_path(i)
+    dylib = "lib#{n}.1.dylib"
+    dep_dylibs = deps(i).map{ |j| "#{keg_path(j)}/lib/lib#{name(j)}.1.dylib" }
+    write_mach_o keg/'lib'/dylib, :dylib, "#{keg}/lib/#{dylib}", dep_dylibs + SYSTEM_DYLIBS, 16384
+    write_mach_o keg/'bin'/n, :execute, nil, ["#{keg}/lib/#{dylib}"] + SYSTEM_DYLIBS, 8192
+    write_mach_o keg/'lib'/n/"#{n}.bundle", :bundle, nil, [dylib] + SYSTEM_DYLIBS, 4096
+    (keg/"lib/lib#{n}.dylib").make_symlink(dylib)
+    (link = keg/"lib/lib#{n}.1.0.dylib").make_symlink(keg/'lib'/dylib)  # Absolute, as some `make install`s leave them.
+    @built[link.to_s] = keg/'lib'/dylib
+    write keg/"lib/lib#{n}.a", MachOFixture.build(archs.map{ |a|
+        [a, MachOFixture.archive(%w[core.o util.o].map{ |o| [o, MachOFixture::Slice.new(a, :object, nil, [], code(2048)).to_s] })]
+      }), true
+    write keg/"lib/lib#{n}.la", <<-EOS.undent
+      # lib#{n}.la - a libtool library file
+      dlname='#{dylib}'
+      library_names='#{dylib} lib#{n}.dylib'
+      old_library='lib#{n}.a'
+      dependency_libs=' #{deps(i).map{ |j| "#{keg_path(j)}/lib/lib#{name(j)}.la" } * ' '} -liconv'
+      installed=yes
+      libdir='#{keg}/lib'
+    EOS
+    write keg/"lib/pkgconfig/#{n}.pc", <<-EOS.undent
+      prefix=#{keg}
+      exec_prefix=${prefix}
+      libdir=${exec_prefix}/lib
+      includedir=${prefix}/include
+
+      Name: #{n}
+      Version: #{KEG_VERSION}
+      Requires: #{deps(i).map{ |j| name(j) } * ', '}
+      Libs: -L${libdir} -l#{n}
+      Cflags: -I${includedir}/#{n} -I#{HOMEBREW_PREFIX}/include
+    EOS
+    write keg/"bin/#{n}-config", <<-EOS.undent
+      #!/bin/sh
+      prefix="#{keg}"
+      case "$1" in
+        --prefix) echo "$prefix" ;;
+        --cflags) echo "-I$prefix/include/#{n} -I#{HOMEBREW_PREFIX}/include" ;;
+        --libs)   echo "-L$prefix/lib -l#{n}" ;;
+      esac
+    EOS
+    (keg/"bin/#{n}-config").chmod 0755
+    write keg/"include/#{n}/#{n}.h", header(n, 0)
+    (0...(files - FIXED_FILES)).each do |j|
+      case j % 5
+        when 0, 1 then write keg/"share/#{n}/doc/note#{j}.txt", note(n, keg, j)
+        when 2 then write keg/"include/#{n}/part#{j}.h", header(n, j)
+        when 3 then write keg/"share/#{n}/data/table#{j}.dat", [i, j].pack('NN') * 512, true
+        when 4 then (keg/"share/#{n}/farm").mkpath; (keg/"share/#{n}/farm/note#{j - 4}.txt").make_symlink("../doc/note#{j - 4}.txt")
+      end
+    end
+    write_tab(i)
+  end # write_keg
+
+  def header(n, j)
+    guard = "#{n.upcase}_#{j}_H"
+    "#ifndef #{guard}\n#define #{guard}\n\n" + (0...40).map{ |k| "int #{n}_#{j}_fn#{k}(const char *path, long size);\n" }.join +
+      "\n#endif /* #{guard} */\n"
+  end
+
+  # Every third note mentions where the keg is installed, as generated documentation often does.
+  def note(n, keg, j)
+    text = "#{n} note #{j}.\n" + "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor.\n" * 24
+    text << "Installed under #{keg}; configuration lives in #{HOMEBREW_PREFIX}/etc/#{n}.\n" if j % 3 == 0
+    text
+  end
+
+  def write_tab(i)
+    tab = Tab.empty
+    tab.tabfile = keg_path(i)/Tab::FILENAME
+    tab.built_archs = archs.map(&:to_s)
+    tab.compiler = 'gcc_4_2'
+    tab.dependencies = deps(i).map{ |j| name(j) }
+    tab.source = { 'path' => formula_path(i).to_s, 'spec' => 'stable', 'tap' => 'Homebrew/homebrew' }
+    tab.time = Time.now.to_i
+    tab.write
+  end # write_tab
+end # CellarGenerator
@@ -0,0 +1,32 @@
+# Compares two sets of benchmark results, as written by `run.rb --json=FILE`:
+#
+#     ruby Library/Homebrew/test/benchmark/compare.rb BEFORE.json AFTER.json [--threshold=PERCENT]
+#
+# For each benchmark both ran, prints the median time of each & the change between them, marking changes larger than PERCENT (by
+# default 10) as slower or faster.  Exits non‐zero if anything got slower by more than that, so it can gate a release.  Results are
+# only comparable when measured alike – the same installation size, on the same host, with the same tools – so any difference in
+# those is pointed out first.
+$:.unshift File.expand_path('../../..', __FILE__)
+require 'vendor/okjson'
+
+threshold = 10.0
+files = ARGV.reject{ |arg| threshold = $1.to_f if arg =~ /^--threshold=(\d+(?:\.\d+)?)$/ }
+abort "Usage:  ruby #{$0} BEFORE.json AFTER.json [--threshold=PERCENT]" unless files.length == 2
+before, after = files.map{ |f| Vendor::OkJson.decode(File.read(f)) }
+
+(before['parameters'].keys | after['parameters'].keys).sort.each do |key|
+  next if key == 'revision' or before['parameters'][key] == after['parameters'][key]
+  puts "Warning:  #{key} differs (#{before['parameters'][key].inspect} → #{after['parameters'][key].inspect})"
+end
+puts format('%-28s %12s %12s %9s', '', before['parameters']['revision'], after['parameters']['revision'], 'change')
+
+slower = []
+old = {}; before['results'].each{ |r| old[r['name']] = r }
+after['results'].each do |r|
+  next unless (o = old[r['name']])
+  change = (r['median'] - o['median']) / o['median'] * 100
+  verdict = change > threshold ? 'slower' : (change < -threshold ? 'faster' : '')
+  slower << r['name'] if verdict == 'slower'
+  puts format('%-28s %10.4f s %10.4f s %+8.1f%%  %s', r['name'], o['median'], r['median'], change, verdict).rstrip
+end
+exit 1 unless slower.empty?
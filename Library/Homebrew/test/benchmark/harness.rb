@@ -0,0 +1,52 @@
+require 'utils/json'
+
+# Runs & records the benchmarks.  Each is run once untimed, to load whatever code & warm whatever caches it needs, then “iterations”
+# times with a clock around it; anything passed as :setup runs before each iteration, outside the clock.  Results go to standard
+# output as they come, & can be written out as JSON for `compare.rb`.
+class BenchmarkHarness
+  FORMAT_VERSION = 1
+
+  attr_reader :results
+
+  def initialize(iterations, only = nil)
+    @iterations, @only = iterations, only
+    @results = []
+  end
+
+  # The clock:  Monotonic where this Ruby can read one.
+  def now
+    defined?(Process::CLOCK_MONOTONIC) ? Process.clock_gettime(Process::CLOCK_MONOTONIC) : Time.now.to_f
+  end
+
+  # “only” lists the beginnings of the names of the benchmarks to run; nil, to run them all.
+  def selected?(name); @only.nil? or @only.any?{ |start| name.starts_with?(start) }; end
+
+  # “units” is how many things one iteration deals with (kegs, say), for the per‐unit figure.
+  def measure(name, units = 1, setup = nil)
+    return unless selected?(name)
+    setup.call if setup
+    yield
+    samples = (1..@iterations).map do
+      setup.call if setup
+      start = now
+      yield
+      now - start
+    end
+    sorted = samples.sort
+    median = sorted.length.odd? ? sorted[sorted.length / 2] : (sorted[sorted.length / 2 - 1] + sorted[sorted.length / 2]) / 2
+    result = { 'name' => name, 'units' => units, 'samples' => samples, 'min' => sorted.first, 'median' => median,
+               'mean' => samples.inject(0.0){ |sum, s| sum + s } / samples.length, 'max' => sorted.last }
+    @results << result
+    puts format('%-28s %10.4f s  (min %.4f, max %.4f)  %10.2f ms per unit', name, median, sorted.first, sorted.last,
+                median * 1000 / units)
+    $stdout.flush
+    result
+  end # measure
+
+  def write_json(path, parameters)
+    File.open(path, 'w') do |f|
+      f.write Utils::JSON.dump('format' => FORMAT_VERSION, 'time' => Time.now.to_i, 'parameters' => parameters,
+                               'results' => @results)
+    end
+  end # write_json
+end # BenchmarkHarness
@@ -0,0 +1,178 @@
+# Writes, reads & edits small but well‐formed Mach-O files, fat containers, & `ar` archives:  The benchmarks’ synthetic kegs are
+# made of them, & on hosts without Apple’s tools the stand‐ins in `cctools.rb` use this to play `otool`, `lipo` & `install_name_tool`
+# on them.  Only what Homebrew asks of those tools is modelled – the header, one __TEXT segment holding one section, & the dylib load
+# commands (LC_ID_DYLIB & LC_LOAD_DYLIB) – but the layout is the real one (see <mach-o/loader.h> & <mach-o/fat.h>), so Homebrew’s own
+# header parsing (see `mach.rb`) reads these files exactly as it reads a compiler’s.
+#
+# The stand‐in tools load this file alone, so it must not depend on any of Homebrew’s libraries.
+module MachOFixture
+  Error = Class.new(StandardError)
+
+  # arch => [cputype, cpusubtype, 64‐bit?, big‐endian?]
+  ARCHS = {
+    :ppc    => [0x00000012, 0, false, true],
+    :ppc64  => [0x01000012, 0, true,  true],
+    :i386   => [0x00000007, 3, false, false],
+    :x86_64 => [0x01000007, 3, true,  false],
+    :arm64  => [0x0100000c, 0, true,  false],
+  }.freeze
+  FILETYPES = { :object => 1, :execute => 2, :dylib => 6, :bundle => 8 }.freeze
+
+  FAT_MAGIC     = 0xcafebabe
+  MH_MAGIC      = 0xfeedface
+  MH_MAGIC_64   = 0xfeedfacf
+  LC_SEGMENT    = 0x01
+  LC_LOAD_DYLIB = 0x0c
+  LC_ID_DYLIB   = 0x0d
+  LC_SEGMENT_64 = 0x19
+  AR_MAGIC      = "!<arch>\n"
+  PAGE          = 0x1000  # Fat slices are page‐aligned; so is each slice’s __text section, which makes the room after the load
+                          # commands – the “header padding” that `install_name_tool` must fit longer names into – most of a page.
+
+  # One architecture’s worth of Mach-O file.  “id” is a dylib’s install name; “dylibs” are the install names it links against.
+  class Slice
+    attr_accessor :arch, :filetype, :id, :dylibs, :text
+
+    def initialize(arch, filetype, id = nil, dylibs = [], text = '')
+      raise Error, "unknown architecture:  #{arch}" unless ARCHS[arch]
+      @arch, @filetype, @id, @dylibs, @text = arch, filetype, id, dylibs, text
+    end
+
+    def wide?; ARCHS[arch][2]; end
+
+    # Packs 32‐bit fields in this slice’s byte order.
+    def u32(*values); values.pack(ARCHS[arch][3] ? 'N*' : 'V*'); end
+
+    # A 64‐bit field, as two 32‐bit halves in this slice’s byte order.
+    def u64(value); hi, lo = value >> 32, value & 0xffffffff; ARCHS[arch][3] ? u32(hi, lo) : u32(lo, hi); end
+
+    def addr(value); wide? ? u64(value) : u32(value); end
+
+    def header_size; wide? ? 32 : 28; end
+
+    def to_s
+      cputype, cpusubtype, = ARCHS[arch]
+      cmds = [segment_command]
+      cmds << dylib_command(LC_ID_DYLIB, id) if id
+      dylibs.each{ |name| cmds << dylib_command(LC_LOAD_DYLIB, name) }
+      sizeofcmds = cmds.inject(0){ |sum, c| sum + c.length }
+      raise Error, 'larger updated load commands do not fit (the program must be relinked)' if header_size + sizeofcmds > PAGE
+      data = u32(wide? ? MH_MAGIC_64 : MH_MAGIC, cputype, cpusubtype, FILETYPES.fetch(filetype), cmds.length, sizeofcmds, 0x85)
+      data << u32(0) if wide?
+      data << cmds.join
+      data << "\0" * (PAGE - data.length)
+      data << MachOFixture.binary(text)
+    end # to_s
+
+    private
+
+    # __TEXT, holding just the __text section.
+    def segment_command
+      size = PAGE + text.length
+      vmsize = (size + PAGE - 1) / PAGE * PAGE
+      section = ['__text', '__TEXT'].pack('a16a16') + addr(PAGE) + addr(text.length) + u32(PAGE, 2, 0, 0, 0x80000400, 0, 0)
+      section << u32(0) if wide?
+      cmd = u32(wide? ? LC_SEGMENT_64 : LC_SEGMENT, (wide? ? 72 : 56) + section.length) + ['__TEXT'].pack('a16')
+      cmd << addr(0) + addr(vmsize) + addr(0) + addr(size) + u32(7, 5, 1, 0) + section
+    end # segment_command
+
+    # Names are NUL‐terminated & padded to the pointer size, as `ld` does.
+    def dylib_command(cmd, name)
+      align = wide? ? 8 : 4
+      name = MachOFixture.binary(name)
+      name += "\0" * (align - name.length % align)
+      u32(cmd, 24 + name.length, 24, 2, 0x10000, 0x10000) + name
+    end
+  end # Slice
+
+  module_function
+
+  # The same octets, marked as such, so that they can be joined with packed fields whatever encoding they came in.
+  def binary(s); s.respond_to?(:force_encoding) ? s.dup.force_encoding('BINARY') : s; end
+
+  def cpu_arch(cputype); ARCHS.keys.detect{ |a| ARCHS[a][0] == cputype }; end
+
+  def fat?(data); data[0, 4].unpack('N').first == FAT_MAGIC; end
+
+  def archive?(data); data[0, 8] == AR_MAGIC; end
+
+  # Parses one thin Mach-O file.
+  def parse(data)
+    magic = data[0, 4].unpack('N').first
+    big = (magic == MH_MAGIC or magic == MH_MAGIC_64)
+    raise Error, 'not a Mach-O file' unless big or [MH_MAGIC, MH_MAGIC_64].include?(data[0, 4].unpack('V').first)
+    f = big ? 'N' : 'V'
+    cputype, _, filetype, ncmds = data[4, 16].unpack("#{f}4")
+    raise Error, "unknown CPU type:  #{cputype}" unless (arch = cpu_arch(cputype))
+    slice = Slice.new(arch, FILETYPES.invert[filetype] || filetype)
+    offset = slice.header_size
+    text_offset = text_size = 0
+    ncmds.times do
+      cmd, cmdsize = data[offset, 8].unpack("#{f}2")
+      case cmd
+        when LC_ID_DYLIB, LC_LOAD_DYLIB
+          name_offset = data[offset + 8, 4].unpack(f).first
+          name = data[offset + name_offset, cmdsize - name_offset].unpack('Z*').first
+          if cmd == LC_ID_DYLIB then slice.id = name else slice.dylibs << name; end
+        when LC_SEGMENT, LC_SEGMENT_64  # The size & offset of the first section.
+          sect = offset + (slice.wide? ? 72 : 56)
+          if slice.wide? then text_size, text_offset = data[sect + 40, 12].unpack("#{f}3").values_at(big ? 1 : 0, 2)
+          else text_size, text_offset = data[sect + 36, 8].unpack("#{f}2"); end
+      end
+      offset += cmdsize
+    end
+    slice.text = data[text_offset, text_size].to_s if text_offset > 0
+    slice
+  end # parse
+
+  # The architecture of a thin Mach-O file, or of the first Mach-O member of an `ar` archive.
+  def arch_of(data)
+    if archive?(data) then archive_members(data).each{ |_, d| (a = arch_of(d) rescue nil) and return a }; nil
+    else parse(data).arch; end
+  end
+
+  # [[arch, data]] for each slice of a fat container, or for the one slice of a thin file.
+  def slices(data)
+    return [[arch_of(data), data]] unless fat?(data)
+    (0...data[4, 4].unpack('N').first).map do |i|
+      cputype, _, offset, size = data[8 + 20*i, 16].unpack('N4')
+      [cpu_arch(cputype), data[offset, size]]
+    end
+  end # slices
+
+  # A thin file if given one slice, or else a fat container of them all.  Each is a Slice or the data of one (e.g. an archive).
+  def build(slice_list)
+    slice_list = slice_list.map{ |s| s.is_a?(Slice) ? [s.arch, s.to_s] : s }
+    return slice_list.first[1] if slice_list.length == 1
+    offset = (8 + 20 * slice_list.length + PAGE - 1) / PAGE * PAGE
+    header = [FAT_MAGIC, slice_list.length].pack('N2')
+    body = ''
+    slice_list.each do |arch, data|
+      cputype, cpusubtype, = ARCHS.fetch(arch)
+      header << [cputype, cpusubtype, offset + body.length, data.length, 12].pack('N5')
+      body << data << "\0" * ((PAGE - data.length % PAGE) % PAGE)
+    end
+    header + "\0" * (offset - header.length) + body
+  end # build
+
+  # An `ar` archive of [[name, data]], led by a symbol table as `ranlib` leaves it.
+  def archive(members)
+    members = [['__.SYMDEF SORTED', "\0" * 8]] + members
+    members.inject(AR_MAGIC.dup) do |ar, (name, data)|
+      ar << format('%-16s%-12d%-6d%-6d%-8o%-10d`', name, 0, 0, 0, 0100644, data.length) << "\n" << data
+      ar << "\n" if data.length.odd?
+      ar
+    end
+  end # archive
+
+  def archive_members(data)
+    members = []
+    offset = 8
+    while offset + 60 <= data.length
+      name, size = data[offset, 16].strip, data[offset + 48, 10].to_i
+      members << [name, data[offset + 60, size]]
+      offset += 60 + size + (size & 1)
+    end
+    members
+  end # archive_members
+end # MachOFixture
@@ -0,0 +1,165 @@
+# Times the operations Homebrew spends its days on – linking & unlinking kegs, fixing & relocating install names & text files,
+# checking linkage, merging per‐architecture builds, the everyday read‐only commands, & loading formulæ – against a synthetic
+# installation made to order (see CellarGenerator), in a throwaway prefix (see `sandbox.rb`).
+#
+#     ruby Library/Homebrew/test/benchmark/run.rb [--kegs=N] [--files=M] [--archs=ppc,i386] [--iterations=N] [--only=NAMES]
+#                                                  [--json=FILE] [--root=DIR] [--stand-ins]
+#
+#   --kegs, --files  The installation’s size:  How many kegs, & how many files in each.  (Default 40 & 40.)
+#   --archs          The architectures of its Mach-O files.  (Default ppc,i386, as a Leopard universal build makes them.)
+#   --iterations     How many timed runs of each benchmark, after one untimed warm‐up.  (Default 5.)
+#   --only           Runs just the benchmarks whose names begin with one of NAMES, separated by commas (e.g. “keg,brew”).
+#   --json           Also writes the results, with the parameters & host they were measured on, to FILE (see `compare.rb`).
+#   --root           Builds the sandbox in DIR, & leaves it there, rather than in a temporary directory that is then removed.
+#   --stand-ins      Uses the stand‐ins in `cctools.rb` for `otool`, `lipo` & `install_name_tool` even on a Mac.  Elsewhere, they
+#                    are always used; so compare only runs made alike.
+#
+# Run from a checkout, this times that checkout’s code:  Benchmark two releases by running each one’s copy & comparing the JSON.
+require 'tmpdir'
+require 'fileutils'
+
+$VERBOSE = nil  # As `brew` runs.
+
+options = { 'kegs' => '40', 'files' => '40', 'archs' => 'ppc,i386', 'iterations' => '5' }
+ARGV.each do |arg|
+  if arg =~ /^--(kegs|files|archs|iterations|only|json|root)=(.+)$/ then options[$1] = $2
+  elsif arg == '--stand-ins' then options['stand-ins'] = true
+  else abort "Unknown option:  #{arg}  (see the top of #{__FILE__})"; end
+end
+ARGV.clear  # Lest `global.rb` take any of them to heart.
+
+root = options['root'] ? File.expand_path(options['root']) : Dir.mktmpdir('leopardbrew-benchmark')
+at_exit { FileUtils.rm_rf root } unless options['root']
+ENV['HOMEBREW_BENCHMARK_ROOT'] = root
+require File.expand_path('../sandbox', __FILE__)
+$:.unshift BenchmarkSandbox::RUBY_LIBRARY
+require 'global'
+require 'merge'
+require 'macos/linkage_checker'
+require File.expand_path('../cellar_generator', __FILE__)
+require File.expand_path('../harness', __FILE__)
+
+BENCHMARK_DIR = File.expand_path('..', __FILE__)
+STAND_INS = (options['stand-ins'] or not BenchmarkSandbox::ON_A_MAC)
+
+# Where the Merge benchmarks build:  A stand‐in for a formula, with a build directory holding per‐architecture stashes.
+class MergeWorkspace
+  include Merge
+  attr_reader :buildpath, :prefix
+
+  def initialize(dir); @buildpath = dir/'build'; @prefix = dir/'prefix'; end
+
+  def system(cmd, *args); Homebrew.system(cmd, *args); end
+end # MergeWorkspace
+
+# Installs the stand‐in tools where MacOS.otool & friends look first.
+def install_stand_ins
+  bin = OPTDIR/'cctools/bin'
+  bin.mkpath
+  ruby = "'#{HOMEBREW_RUBY_PATH}'#{' --disable-gems' if RUBY_VERSION >= '1.9'}"
+  %w[install_name_tool lipo otool].each do |tool|
+    (bin/tool).open('w') { |f| f.puts "#!/bin/sh", %(exec #{ruby} '#{BENCHMARK_DIR}/cctools.rb' #{tool} "$@") }
+    (bin/tool).chmod 0755
+  end
+end # install_stand_ins
+
+# Runs a `brew` command as a user would, but in the sandbox; its output is thrown away unless it fails.
+def brew(*args)
+  log = HOMEBREW_TEMP/'brew.log'
+  ok = Homebrew._system(HOMEBREW_RUBY_PATH, '-W0', "-r#{BENCHMARK_DIR}/sandbox.rb", BenchmarkSandbox::BREW_RB, *args) do
+    $stdout.reopen('/dev/null')
+    $stderr.reopen(log.to_s, 'w')
+  end
+  raise "`brew #{args * ' '}` failed:\n#{log.read}" unless ok
+end # brew
+
+# Stashes each keg’s Mach-O files & archives, one slice per architecture, & its main header, varied per architecture, as a
+# universal build stashes them before merging.
+def stash_for_merge(workspace, kegs, archs)
+  kegs.each do |keg|
+    rel = lambda{ |pn| pn.relative_path_from(keg.path).to_s }
+    binaries = keg.mach_o_files + Dir["#{keg}/lib/*.a"].map{ |p| Pathname(p) }
+    binaries.each do |pn|
+      MachOFixture.slices(pn.open('rb') { |f| f.read }).each do |arch, data|
+        (dest = workspace.stashdir(:binary, arch)/rel.call(pn)).dirname.mkpath
+        dest.open('wb') { |f| f.write(data) }
+      end
+    end
+    header = keg.path/'include'/keg.name/"#{keg.name}.h"
+    archs.each do |arch|
+      lines = header.read.lines.to_a
+      lines.insert(3, "#define #{keg.name.upcase}_SIZEOF_LONG #{MachOFixture::ARCHS[arch][2] ? 8 : 4}\n",
+                      "#define #{keg.name.upcase}_BIG_ENDIAN #{MachOFixture::ARCHS[arch][3] ? 1 : 0}\n")
+      (dest = workspace.stashdir(:header, arch)/rel.call(header)).dirname.mkpath
+      dest.open('w') { |f| f.write(lines.join) }
+    end
+  end # each |keg|
+end # stash_for_merge
+
+# A fresh, empty prefix, with the directories the stashes will be merged into.
+def clear_merge_prefix(workspace, archs)
+  workspace.prefix.rmtree if workspace.prefix.directory?
+  [:binary, :header].each do |type|
+    archs.each do |arch|
+      dir = workspace.stashdir(type, arch)
+      Dir["#{dir}/**/*/"].each{ |d| (workspace.prefix/Pathname(d).relative_path_from(dir)).mkpath }
+    end
+  end
+end # clear_merge_prefix
+
+kegs_n, files_n, iterations = options['kegs'].to_i, options['files'].to_i, options['iterations'].to_i
+archs = options['archs'].split(',').map(&:to_sym)
+abort '--kegs, --files & --iterations must be positive' unless kegs_n > 0 and files_n > 0 and iterations > 0
+archs.each{ |a| abort "Unknown architecture:  #{a}" unless MachOFixture::ARCHS[a] }
+
+install_stand_ins if STAND_INS
+ohai "Generating #{kegs_n} kegs of #{files_n} files each (#{archs * ', '}) in #{root}"
+generator = CellarGenerator.new(kegs_n, files_n, archs).generate
+kegs = generator.keg_objects
+top = generator.name(kegs_n - 1)
+
+bench = BenchmarkHarness.new(iterations, options['only'] && options['only'].split(','))
+
+bench.measure('formulary.load', kegs_n, lambda{ Formulary::FORMULAE.clear }) do
+  generator.formula_paths.each{ |path| Formulary.factory(path.to_s) }
+end
+
+bench.measure('brew --prefix') { brew '--prefix' }  # Startup alone, for comparison with those below.
+bench.measure('brew list') { brew 'list' }
+bench.measure('brew deps') { brew 'deps', top }
+bench.measure('brew deps --installed') { brew 'deps', '--installed' }
+bench.measure('brew uses --installed') { brew 'uses', '--installed', generator.name(0) }
+bench.measure('brew outdated') { brew 'outdated' }
+
+bench.measure('keg.link', kegs_n, lambda{ kegs.each{ |k| k.unlink if k.linked? } }) { kegs.each(&:link) }
+bench.measure('keg.unlink', kegs_n, lambda{ kegs.each{ |k| k.link unless k.linked? } }) { kegs.each(&:unlink) }
+
+bench.measure('keg.relocate_text_files', kegs_n) do
+  prefix, cellar = HOMEBREW_PREFIX.to_s, HOMEBREW_CELLAR.to_s
+  kegs.each do |k|
+    k.relocate_text_files prefix, Keg::PREFIX_PLACEHOLDER, cellar, Keg::CELLAR_PLACEHOLDER
+    k.relocate_text_files Keg::PREFIX_PLACEHOLDER, prefix, Keg::CELLAR_PLACEHOLDER, cellar
+  end
+end
+
+bench.measure('keg.fix_install_names', kegs_n, lambda{ kegs.each{ |k| generator.restore(k) }; LinkageIndex.reset! }) do
+  kegs.each(&:fix_install_names)
+end
+
+bench.measure('linkage_checker', kegs_n, lambda{ LinkageIndex.reset! }) { kegs.each{ |k| LinkageChecker.new(k) } }
+
+if archs.length > 1 and (bench.selected?('merge.binaries') or bench.selected?('merge.C_headers'))
+  workspace = MergeWorkspace.new(Pathname(root)/'merge')
+  stash_for_merge(workspace, kegs, archs)
+  bench.measure('merge.binaries', kegs_n, lambda{ clear_merge_prefix(workspace, archs) }) { workspace.merge_binaries(archs) }
+  bench.measure('merge.C_headers', kegs_n, lambda{ clear_merge_prefix(workspace, archs) }) { workspace.merge_C_headers(archs) }
+end
+
+if options['json']
+  bench.write_json(options['json'],
+                   'kegs' => kegs_n, 'files' => files_n, 'archs' => archs.map(&:to_s), 'iterations' => iterations,
+                   'stand_ins' => STAND_INS ? true : false, 'ruby' => "#{RUBY_VERSION} (#{RUBY_PLATFORM})",
+                   'os_version' => MACOS_FULL_VERSION,
+                   'revision' => Dir.chdir(BenchmarkSandbox::RUBY_LIBRARY) { `git rev-parse --short HEAD 2>/dev/null`.chomp })
+  ohai "Results written to #{options['json']}"
+end
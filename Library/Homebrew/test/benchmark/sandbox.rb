@@ -0,0 +1,71 @@
+# Sets up the environment `global.rb` reads, so that Homebrew’s libraries – both in the benchmark runner & in the `brew` commands it
+# times, which load this first (`ruby -r…/sandbox.rb brew.rb …`) – work inside the throwaway prefix at $HOMEBREW_BENCHMARK_ROOT,
+# using the libraries this file was found amongst, on a Mac or not.
+#
+# Away from a Mac there is no `sysctl` to describe the CPU, nor any developer tools to find, so HostProbe is primed with what a
+# Penryn Core 2 Duo running Leopard would have told it.
+require 'rbconfig'
+require 'fileutils'
+
+abort '$HOMEBREW_BENCHMARK_ROOT is not set' unless (root = ENV['HOMEBREW_BENCHMARK_ROOT']) and not root.empty?
+
+module BenchmarkSandbox
+  RUBY_LIBRARY = File.expand_path('../../..', __FILE__)
+  BREW_RB      = File.expand_path('../brew.rb', RUBY_LIBRARY)
+  ON_A_MAC     = (RUBY_PLATFORM =~ /darwin/) ? true : false
+
+  SYSCTL = {
+    'hw.cputype'                   => '7',
+    'hw.cpusubtype'                => '4',
+    'hw.cpufamily'                 => 0x78ea4fbc.to_s,
+    'hw.physicalcpu_max'           => '2',
+    'hw.cpu64bit_capable'          => '1',
+    'hw.optional.altivec'          => '0',
+    'hw.optional.sse3'             => '1',
+    'hw.optional.supplementalsse3' => '1',
+    'hw.optional.sse4_1'           => '1',
+    'hw.optional.sse4_2'           => '0',
+    'hw.optional.aes'              => nil,
+    'hw.optional.avx1_0'           => nil,
+    'hw.optional.avx2_0'           => nil,
+    'machdep.cpu.extmodel'         => '1',
+    'machdep.cpu.features'         => 'FPU VME DE PSE TSC MSR PAE MCE CX8 APIC SEP MTRR PGE MCA CMOV PAT PSE36 CLFSH DS ACPI MMX ' \
+                                      'FXSR SSE SSE2 SS HTT TM SSE3 MON DSCPL VMX SMX EST TM2 SSSE3 CX16 TPR PDCM SSE4.1',
+    'machdep.cpu.extfeatures'      => 'SYSCALL XD EM64T',
+    'machdep.cpu.leaf7_features'   => nil,
+  }.freeze
+
+  module_function
+
+  def os_version; ON_A_MAC ? `/usr/bin/sw_vers -productVersion`.chomp : '10.5.8'; end
+
+  def prime_host_probe
+    $:.unshift RUBY_LIBRARY unless $:.include?(RUBY_LIBRARY)
+    require 'host_probe'
+    HostProbe.instance_variable_set(:@state, { :format      => HostProbe::FORMAT_VERSION,
+                                               :fingerprint => nil,
+                                               :values      => { :sysctl => SYSCTL.dup, :active_developer_dir => nil,
+                                                                 :xcode_prefix => nil, :xcode_version => nil, :clt_version => nil } })
+  end # prime_host_probe
+end # BenchmarkSandbox
+
+prefix = File.join(root, 'prefix')
+{
+  'HOMEBREW_BREW_FILE'       => File.join(prefix, 'bin/brew'),
+  'HOMEBREW_CACHE'           => File.join(root, 'cache'),
+  'HOMEBREW_CELLAR'          => File.join(prefix, 'Cellar'),
+  'HOMEBREW_CURL_PATH'       => '/usr/bin/curl',
+  'HOMEBREW_LIBRARY'         => File.join(prefix, 'Library'),
+  'HOMEBREW_LOGS'            => File.join(root, 'logs'),
+  'HOMEBREW_OS_VERSION'      => ENV['HOMEBREW_OS_VERSION'] || BenchmarkSandbox.os_version,
+  'HOMEBREW_PREFIX'          => prefix,
+  'HOMEBREW_REPOSITORY'      => prefix,
+  'HOMEBREW_RUBY_LIBRARY'    => BenchmarkSandbox::RUBY_LIBRARY,
+  'HOMEBREW_RUBY_PATH'       => File.join(RbConfig::CONFIG['bindir'], RbConfig::CONFIG['ruby_install_name']),
+  'HOMEBREW_TEMP'            => File.join(root, 'tmp'),
+  'HOMEBREW_USER_AGENT'      => 'Leopardbrew-benchmark',
+  'HOMEBREW_USER_AGENT_CURL' => 'Leopardbrew-benchmark',
+}.each{ |key, value| ENV[key] = value }
+%w[HOMEBREW_CACHE HOMEBREW_CELLAR HOMEBREW_LIBRARY HOMEBREW_TEMP].each{ |key| FileUtils.mkdir_p ENV[key] }
+
+BenchmarkSandbox.prime_host_probe unless BenchmarkSandbox::ON_A_MAC
@@ -0,0 +1,65 @@
+require "testing_env"
+require "benchmark/mach_o_fixture"
+
+class BenchmarkFixtureTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @dir = Pathname.new(Dir.mktmpdir("benchmark_fixtures", HOMEBREW_TEMP))
+    @bin = HOMEBREW_PREFIX.join("opt", "cctools", "bin")
+    @bin.mkpath
+    %w[install_name_tool lipo otool].each do |tool|
+      @bin.join(tool).write "#!/bin/sh\nexec '#{CONFIG_RUBY_PATH}' '#{TEST_DIRECTORY}/benchmark/cctools.rb' #{tool} \"$@\"\n"
+      @bin.join(tool).chmod 0755
+    end
+  end
+
+  def teardown
+    @dir.rmtree
+    rm_rf HOMEBREW_PREFIX.join("opt")
+  end
+
+  def write(name, data)
+    @dir.join(name).open("wb") { |f| f.write(data) }
+    @dir.join(name)
+  end
+
+  def fat_dylib
+    write "libfoo.dylib", MachOFixture.build([:ppc, :x86_64].map { |a|
+      MachOFixture::Slice.new(a, :dylib, "/usr/local/Cellar/foo/1.0/lib/libfoo.dylib",
+                              %w[/usr/local/Cellar/bar/1.0/lib/libbar.dylib /usr/lib/libSystem.B.dylib], "\x90" * 64)
+    })
+  end
+
+  def test_headers_read_as_homebrew_reads_a_compilers
+    pn = fat_dylib
+    assert pn.fat_container?
+    assert_equal [:ppc, :x86_64], pn.archs
+    assert pn.dylib?
+    exe = write("foo", MachOFixture::Slice.new(:i386, :execute, nil, [], "\x90" * 64).to_s)
+    assert_equal :i386, exe.arch
+    assert exe.mach_o_executable?
+    ar = write("libfoo.a", MachOFixture.archive([["foo.o", MachOFixture::Slice.new(:i386, :object).to_s]]))
+    assert ar.ar_sigseek_from(0)
+  end
+
+  def test_stand_in_tools_agree_with_the_fixture
+    pn = fat_dylib
+    assert_equal "/usr/local/Cellar/foo/1.0/lib/libfoo.dylib", pn.dylib_id
+    assert_equal %w[/usr/local/Cellar/bar/1.0/lib/libbar.dylib /usr/lib/libSystem.B.dylib], pn.dynamically_linked_libraries
+    assert_equal [:ppc, :x86_64], pn.lipo_archs
+
+    assert system(MacOS.install_name_tool.to_s, "-id", "/usr/local/opt/foo/lib/libfoo.dylib",
+                  "-change", "/usr/local/Cellar/bar/1.0/lib/libbar.dylib", "/usr/local/opt/bar/lib/libbar.dylib", pn.to_s)
+    pn = Pathname.new(pn.to_s)
+    assert_equal "/usr/local/opt/foo/lib/libfoo.dylib", pn.dylib_id
+    assert_equal %w[/usr/local/opt/bar/lib/libbar.dylib /usr/lib/libSystem.B.dylib], pn.dynamically_linked_libraries
+    MachOFixture.slices(pn.open("rb") { |f| f.read }).each do |_, data|
+      assert_equal "/usr/local/opt/foo/lib/libfoo.dylib", MachOFixture.parse(data).id
+    end
+
+    thin = @dir.join("libfoo-ppc.dylib")
+    assert system(MacOS.lipo.to_s, "-thin", "ppc", "-output", thin.to_s, pn.to_s)
+    assert_equal [:ppc], thin.lipo_archs
+  end
+end
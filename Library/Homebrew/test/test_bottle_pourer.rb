@@ -0,0 +1,86 @@
+require "testing_env"
+require "bottle_pourer"
+
+class BottlePourerTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @src = mktmpdir
+    @dst = mktmpdir
+    @bottle = Pathname(mktmpdir)/"foo-1.0.bottle.tar.gz"
+    @keg = Pathname(@src)/"foo/1.0"
+    (@keg/"bin").mkpath
+    (@keg/"lib").mkpath
+  end
+
+  def teardown
+    rm_rf [@src, @dst, @bottle.dirname]
+  end
+
+  def pack
+    Dir.chdir(@src) { system "tar", "-czf", @bottle.to_s, "foo" }
+    BottlePourer.new(@bottle, @dst, "/opt/brew", "/opt/brew/Cellar").pour
+  end
+
+  def poured(rel); Pathname(@dst)/"foo/1.0"/rel; end
+
+  def test_text_files_are_relocated
+    script = @keg/"bin/foo"
+    script.write "#!/bin/sh\nexec #{Keg::CELLAR_PLACEHOLDER}/foo/1.0/libexec/foo --prefix=#{Keg::PREFIX_PLACEHOLDER}\n"
+    script.chmod 0755
+    pourer = pack
+    assert_equal "#!/bin/sh\nexec /opt/brew/Cellar/foo/1.0/libexec/foo --prefix=/opt/brew\n", poured("bin/foo").read
+    assert_equal 0755, poured("bin/foo").stat.mode & 07777
+    assert_equal [poured("bin/foo")], pourer.text_files
+  end
+
+  def test_placeholder_across_chunks
+    text = "x" * (BottlePourer::CHUNK - 5) + Keg::PREFIX_PLACEHOLDER + "\n" + "y" * BottlePourer::CHUNK
+    (@keg/"lib/pkgconfig.pc").write text
+    pack
+    assert_equal text.sub(Keg::PREFIX_PLACEHOLDER, "/opt/brew"), poured("lib/pkgconfig.pc").read
+  end
+
+  def test_binary_files_are_untouched
+    data = "\0\1\2#{Keg::PREFIX_PLACEHOLDER}\0"
+    (@keg/"lib/foo.a").open("wb") { |f| f.write data }
+    pack
+    assert_equal data, poured("lib/foo.a").binread
+  end
+
+  def test_symlinks_and_hardlinks
+    (@keg/"lib/libfoo.1.dylib.txt").write Keg::PREFIX_PLACEHOLDER
+    ln_s "libfoo.1.dylib.txt", @keg/"lib/libfoo.txt"
+    ln @keg/"lib/libfoo.1.dylib.txt", @keg/"lib/libfoo.hard.txt"
+    pack
+    assert_predicate poured("lib/libfoo.txt"), :symlink?
+    assert_equal "libfoo.1.dylib.txt", poured("lib/libfoo.txt").readlink.to_s
+    assert_equal poured("lib/libfoo.1.dylib.txt").stat.ino, poured("lib/libfoo.hard.txt").stat.ino
+  end
+
+  def test_mach_o_files_are_queued_only_when_needed
+    cp "#{TEST_DIRECTORY}/mach/i386.dylib", @keg/"lib/plain.dylib"
+    data = File.open("#{TEST_DIRECTORY}/mach/x86_64.dylib", "rb", &:read) + "#{Keg::PREFIX_PLACEHOLDER}/lib/libbar.dylib"
+    (@keg/"lib/libfoo.dylib").open("wb") { |f| f.write data }
+    pourer = pack
+    assert_equal [poured("lib/libfoo.dylib")], pourer.mach_o_files
+    assert_equal data, poured("lib/libfoo.dylib").binread
+    assert_empty pourer.text_files
+  end
+
+  def test_fat_files_are_thinned_as_they_pour
+    cp "#{TEST_DIRECTORY}/mach/fat.dylib", @keg/"lib/libfat.dylib"
+    ln @keg/"lib/libfat.dylib", @keg/"lib/libfat.hard.dylib"
+    lipo = Pathname(mktmpdir)/"lipo"  # Keeps the first 100 octets.
+    lipo.write "#!/bin/sh\nfor last; do :; done\nhead -c 100 \"$1\" > \"$last\"\n"
+    lipo.chmod 0755
+    MacOS.stubs(:lipo).returns(lipo)
+    Dir.chdir(@src) { system "tar", "-czf", @bottle.to_s, "foo" }
+    pourer = BottlePourer.new(@bottle, @dst, "/opt/brew", "/opt/brew/Cellar").thin_to([:x86_64], 2).pour
+    assert_equal 100, poured("lib/libfat.dylib").size
+    assert_equal poured("lib/libfat.dylib").stat.ino, poured("lib/libfat.hard.dylib").stat.ino
+    assert_equal File.size("#{TEST_DIRECTORY}/mach/fat.dylib") - 100, pourer.octets_thinned
+  ensure
+    rm_rf lipo.dirname if lipo
+  end
+end
@@ -0,0 +1,69 @@
+require "testing_env"
+require "bottle_writer"
+require "bottle_pourer"
+
+class BottleWriterTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @cellar = Pathname(mktmpdir)
+    @keg = @cellar/"foo/1.0"
+    (@keg/"bin").mkpath
+    (@keg/"share/doc").mkpath
+    (@keg/"bin/foo").write "#!/bin/sh\nexec /opt/brew/Cellar/foo/1.0/libexec/foo\n"
+    (@keg/"bin/foo").chmod 0755
+    (@keg/"share/doc/big").open("wb") { |f| 3000.times { |i| f.write "line #{i} of something compressible\n" } }
+    (@keg/"share/doc/random").open("wb") { |f| f.write Random.new(1).bytes(20_000) }
+    ln @keg/"share/doc/big", @keg/"share/doc/big-again"
+    ln_s "../bin/foo", @keg/"share/foo"
+    (@keg/"share/#{"n" * 90}/#{"m" * 90}").mkpath
+  end
+
+  def teardown
+    rm_rf @cellar
+  end
+
+  def bottle(jobs)
+    io = StringIO.new
+    io.binmode if io.respond_to?(:binmode)
+    writer = BottleWriter.new(@cellar, ["foo/1.0"], :jobs => jobs, :slice => 4096,
+                                                    :scan => ["/opt/brew", "/opt/brew/Cellar"])
+    writer.write(io)
+    [io.string, writer]
+  end
+
+  def test_output_is_deterministic
+    one, = bottle(1)
+    touch @keg/"bin/foo", :mtime => Time.now - 3600
+    three, = bottle(3)
+    assert_equal one, three
+  end
+
+  def test_output_is_one_gzip_member
+    data, = bottle(3)
+    tarball = Zlib::GzipReader.new(StringIO.new(data)).read
+    assert_equal 0, tarball.length % 512
+    assert_includes tarball, "line 2999 of something compressible"
+  end
+
+  def test_strings_are_found_while_writing
+    _, writer = bottle(2)
+    assert_equal [@keg/"bin/foo"], writer.files_containing("/opt/brew/Cellar")
+    assert_equal [@keg/"bin/foo"], writer.files_containing("/opt/brew")
+  end
+
+  def test_pours_back
+    data, = bottle(2)
+    bottle_path = @cellar/"foo.tar.gz"
+    bottle_path.open("wb") { |f| f.write data }
+    dest = Pathname(mktmpdir)
+    BottlePourer.new(bottle_path, dest, "/opt/brew", "/opt/brew/Cellar").pour
+    assert_equal (@keg/"share/doc/random").binread, (dest/"foo/1.0/share/doc/random").binread
+    assert_equal (dest/"foo/1.0/share/doc/big").stat.ino, (dest/"foo/1.0/share/doc/big-again").stat.ino
+    assert_equal "../bin/foo", (dest/"foo/1.0/share/foo").readlink.to_s
+    assert_predicate dest/"foo/1.0/share/#{"n" * 90}/#{"m" * 90}", :directory?
+    assert_equal 0755, (dest/"foo/1.0/bin/foo").stat.mode & 07777
+  ensure
+    rm_rf dest if dest
+  end
+end
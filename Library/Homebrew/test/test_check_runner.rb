@@ -0,0 +1,47 @@
+require "testing_env"
+require "check_runner"
+
+class CheckRunnerTests < Homebrew::TestCase
+  class FakeChecks
+    attr_reader :warmed
+
+    def warm_probes; @warmed = $$; end
+
+    def check_first; @seen_first = true; "first #{$$}"; end
+
+    def check_second; "second saw first" if @seen_first; end
+
+    def check_quiet; puts "said something"; nil; end
+
+    def check_broken; raise ArgumentError, "no good"; end
+  end
+
+  def run_checks(names, jobs)
+    checks = FakeChecks.new
+    runner = CheckRunner.new(checks, names, :in_process => %w[check_first],
+                             :after => { "check_second" => %w[check_first] }, :jobs => jobs)
+    [checks, runner, runner.run]
+  end
+
+  def test_results_come_back_in_the_order_asked
+    checks, _, results = run_checks(%w[check_second check_quiet check_broken check_first], 3)
+    assert_equal %w[check_second check_quiet check_broken check_first], results.map(&:name)
+    assert_equal $$, checks.warmed
+    assert_equal "first #{$$}", results.last.output  # run in this process
+    assert_equal "second saw first", results.first.output
+  end
+
+  def test_output_and_errors_are_collected_per_check
+    _, runner, results = run_checks(%w[check_quiet check_broken], 2)
+    assert_equal "said something\n", results[0].printed
+    assert_nil results[0].output
+    assert_equal "ArgumentError:  no good", results[1].error
+    assert_equal 2, runner.timings.length
+    assert runner.elapsed >= runner.timings.first.seconds
+  end
+
+  def test_runs_in_process_with_one_job
+    _, _, results = run_checks(%w[check_first check_second], 1)
+    assert_equal ["first #{$$}", "second saw first"], results.map(&:output)
+  end
+end
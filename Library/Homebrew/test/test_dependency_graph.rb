@@ -0,0 +1,63 @@
+require "testing_env"
+require "dependency_graph"
+
+class DependencyGraphTests < Homebrew::TestCase
+  def record(name, deps = [], requirements = [])
+    { "name" => name, "full_name" => name, "mtime" => 0, "revision" => 0, "version" => "1.0", "pkg_version" => "1.0",
+      "deps" => deps, "requirements" => requirements, "options" => [], "bottle_tags" => [] }
+  end
+
+  def graph_of(*records)
+    snapshot = FormulaSnapshot.new(:format => FormulaSnapshot::FORMAT_VERSION, :library => HOMEBREW_LIBRARY.to_s,
+                                   :records => Hash[records.map { |r| ["#{HOMEBREW_LIBRARY}/Formula/#{r["name"]}.rb", r] }],
+                                   :aliases => {}, :stamp => ReadallCache.library_stamp)
+    DependencyGraph.new(snapshot)
+  end
+
+  def setup
+    @graph = graph_of(record("app", [["lib", []], ["tool", [:build]], ["extra", [:optional]], ["nice", [:recommended]]]),
+                      record("lib", [["base", []]], [["x11", "xorg", []]]),
+                      record("tool", [["base", []]]),
+                      record("extra"), record("nice"), record("base"), record("xorg"))
+  end
+
+  def names(mask)
+    @graph.names_in(mask).sort
+  end
+
+  def test_closure_follows_every_class_by_default
+    assert_equal %w[base extra lib nice tool xorg], names(@graph.closure(@graph["app"]))
+  end
+
+  def test_ignored_classes_are_pruned
+    ignored = DependencyGraph::BUILD | DependencyGraph::OPTIONAL | DependencyGraph::RECOMMENDED
+    assert_equal %w[base lib xorg], names(@graph.closure(@graph["app"], ignored))
+    assert_equal %w[base lib nice xorg], names(@graph.closure(@graph["app"], ignored, DependencyGraph::RECOMMENDED))
+    assert_equal %w[extra lib nice], names(@graph.direct(@graph["app"], DependencyGraph::BUILD))
+  end
+
+  def test_reverse_closure
+    assert_equal %w[app lib tool], names(@graph.reverse_closure(@graph["base"]))
+    assert_empty names(@graph.reverse_closure(@graph["base"], DependencyGraph::RUN))
+    assert_equal %w[app lib], names(@graph.reverse_closure(@graph["xorg"]))
+  end
+
+  def test_unknown_dependencies_get_bare_nodes
+    graph = graph_of(record("foo", [["homebrew/other/bar", []]]))
+    assert_equal %w[homebrew/other/bar], names_for(graph, graph.closure(graph["foo"]))
+    assert_nil graph.entry_of(graph["homebrew/other/bar"])
+  end
+
+  def test_cycles_are_reported
+    graph = graph_of(record("a", [["b", []]]), record("b", [["a", []]]))
+    assert_raises(DependencyGraph::CircularDependencyError) { graph.closure(graph["a"]) }
+  end
+
+  def test_bitset_round_trip
+    assert_equal [0, 3, 70], @graph.ids_in(@graph.bitset([70, 0, 3]))
+  end
+
+  def names_for(graph, mask)
+    graph.names_in(mask).sort
+  end
+end
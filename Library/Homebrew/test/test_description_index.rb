@@ -0,0 +1,53 @@
+require "testing_env"
+require "description_index"
+
+class DescriptionIndexTests < Homebrew::TestCase
+  include FileUtils
+
+  def snapshot_of(descs)
+    records = {}
+    descs.each_pair do |name, desc|
+      records["#{HOMEBREW_LIBRARY}/Formula/#{name}.rb"] = { "name" => name, "full_name" => name, "desc" => desc, "mtime" => 0 }
+    end
+    FormulaSnapshot.new(:format => FormulaSnapshot::FORMAT_VERSION, :library => HOMEBREW_LIBRARY.to_s,
+                        :records => records, :aliases => {}, :stamp => ReadallCache.library_stamp)
+  end
+
+  def setup
+    @index = DescriptionIndex.new.refresh(snapshot_of("foo" => "Frobnicates widgets", "bar" => "Widget polisher",
+                                                      "baz" => nil))
+  end
+
+  def teardown
+    DescriptionIndex.reset!
+    rm_f DescriptionIndex::INDEX_FILE
+  end
+
+  def test_required_literals
+    assert_equal ["widget"], DescriptionIndex.required_literals(/.*widget.*/i)
+    assert_equal ["frob", "cat"], DescriptionIndex.required_literals(/^Frob\w+cat/)
+    assert_equal ["wid"], DescriptionIndex.required_literals(/widg?e[st]/)
+    assert_empty DescriptionIndex.required_literals(/foo|bar/)
+    assert_empty DescriptionIndex.required_literals(/\x66oo/)
+  end
+
+  def test_search_by_field
+    assert_equal %w[bar foo], @index.search(/widget/i, :desc).keys.sort
+    assert_equal %w[foo], @index.search(/widgets/, :desc).keys
+    assert_equal %w[bar baz], @index.search(/ba/, :name).keys.sort
+    assert_equal %w[foo], @index.search(/foo|nicate/, :either).keys
+  end
+
+  def test_incremental_refresh
+    @index.refresh(snapshot_of("foo" => "Polishes gadgets", "qux" => "Widget maker"))
+    assert_equal %w[qux], @index.search(/widget/i, :desc).keys
+    assert_equal %w[foo], @index.search(/gadget/, :desc).keys
+    assert_empty @index.search(/bar/, :name)
+  end
+
+  def test_index_persists
+    DescriptionIndex.new.refresh(snapshot_of("foo" => "Frobnicates widgets"))
+    assert_predicate DescriptionIndex::INDEX_FILE, :file?
+    assert_equal %w[foo], DescriptionIndex.load.search(/frob/i).keys
+  end
+end
@@ -0,0 +1,49 @@
+require "testing_env"
+require "digest_cache"
+
+class DigestCacheTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @file = HOMEBREW_CACHE/"testball-0.1.tbz"
+    HOMEBREW_CACHE.mkpath
+    cp "#{TEST_DIRECTORY}/tarballs/testball-0.1.tbz", @file
+  end
+
+  def teardown
+    rm_f @file
+    rm_rf DigestCache.dir
+  end
+
+  def test_digests_are_remembered
+    assert_equal TESTBALL_SHA256, @file.sha256
+    assert_equal TESTBALL_SHA256, DigestCache.remembered(@file)[:sha256]
+  end
+
+  def test_changed_files_are_rehashed
+    DigestCache.remember(@file, :sha256 => "0" * 64)
+    assert_equal "0" * 64, @file.sha256
+    @file.open("ab") { |f| f.write "x" }
+    refute_equal "0" * 64, @file.sha256
+  end
+
+  def test_tee_hashes_a_resumed_download
+    data = @file.binread
+    half = data.length / 2
+    partial = HOMEBREW_CACHE/"testball-0.1.tbz.incomplete"
+    partial.open("wb") { |f| f.write data[0, half] }
+    partial.open("ab") do |f|
+      tee = DigestCache::Tee.new(f, partial)
+      tee.write data[half..-1]
+      assert_equal TESTBALL_SHA256, tee.hexdigests[:sha256]
+    end
+    assert_equal data.length, partial.size
+  ensure
+    rm_f partial
+  end
+
+  def test_prime
+    DigestCache.prime([@file], 1)
+    assert_equal TESTBALL_SHA256, DigestCache.remembered(@file)[:sha256]
+  end
+end
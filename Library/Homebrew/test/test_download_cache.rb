@@ -0,0 +1,75 @@
+require "testing_env"
+require "download_cache"
+require "digest_cache"
+
+class DownloadCacheTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    HOMEBREW_CACHE.mkpath
+    @foo = HOMEBREW_CACHE/"foo-1.0.tar.gz"
+    @bar = HOMEBREW_CACHE/"bar-2.0.tar.gz"
+  end
+
+  def teardown
+    rm_rf HOMEBREW_CACHE
+    ENV.delete "HOMEBREW_CACHE_BUDGET"
+  end
+
+  def download(entry, content)
+    entry.write content
+    DownloadCache.store(entry, DigestCache.digest(entry, :sha256))
+  end
+
+  def test_identical_downloads_are_stored_once
+    blob = download(@foo, "tarball")
+    assert_equal blob, download(@bar, "tarball")
+    assert_equal [blob], DownloadCache.blobs
+    assert_equal "tarball", @bar.read
+    assert_equal blob, DownloadCache.blob_of(@foo)
+  end
+
+  def test_a_stored_checksum_needs_no_download
+    blob = download(@foo, "tarball")
+    refute DownloadCache.adopt(@bar, "0" * 64)
+    assert DownloadCache.adopt(@bar, blob.basename.to_s)
+    assert_equal "tarball", @bar.read
+  end
+
+  def test_plain_downloads_are_absorbed
+    @foo.write "tarball"
+    @bar.write "tarball"
+    (HOMEBREW_CACHE/"installed_index.marshal").write "index"
+    assert_equal 7, DownloadCache.absorb
+    assert_equal 1, DownloadCache.blobs.length
+    assert @foo.symlink?
+    refute (HOMEBREW_CACHE/"installed_index.marshal").symlink?
+  end
+
+  def test_least_recently_used_blobs_are_evicted_to_budget
+    old = download(@foo, "a" * 600)
+    new = download(@bar, "b" * 600)
+    ago = Time.now.to_i - 2 * DownloadCache::GRACE
+    DownloadCache::LOG_FILE.atomic_write "#{ago} #{old.basename}\n#{ago + 1} #{new.basename}\n"
+    ENV["HOMEBREW_CACHE_BUDGET"] = "1K"
+    assert_equal 1024, DownloadCache.budget
+    assert_equal 600, DownloadCache.evict
+    refute old.exist?
+    refute @foo.symlink?
+    assert new.exist?
+    assert_equal 0, DownloadCache.evict  # Within budget now.
+  end
+
+  def test_recently_used_and_referenced_blobs_are_kept
+    blob = download(@foo, "tarball")
+    orphan = download(@bar, "other")
+    @bar.unlink
+    assert_equal 0, DownloadCache.evict(0, :orphans => true)  # Both used just now.
+    DownloadCache::LOG_FILE.atomic_write "#{Time.now.to_i - 2 * DownloadCache::GRACE} #{orphan.basename}\n"
+    File.utime(Time.now - 2 * DownloadCache::GRACE, Time.now - 2 * DownloadCache::GRACE, blob.to_s)
+    DownloadCache::LOG_FILE.open("a") { |f| f.puts "#{Time.now.to_i} #{blob.basename}" }
+    assert_equal 5, DownloadCache.evict(nil, :orphans => true)
+    assert blob.exist?
+    refute orphan.exist?
+  end
+end
@@ -0,0 +1,97 @@
+require "testing_env"
+require "download_scheduler"
+require "socket"
+require "thread"
+
+# A stand-in HTTP server:  Serves the test tarballs, slowly enough that overlapping requests can be counted.
+class StandInServer
+  attr_reader :port, :requests, :peak
+
+  def initialize(delay = 0.3)
+    @server = TCPServer.new("127.0.0.1", 0)
+    @port = @server.addr[1]
+    @delay = delay
+    @lock = Mutex.new
+    @active = 0; @peak = 0; @requests = []
+    @thread = Thread.new { loop { client = @server.accept; Thread.new(client) { |c| serve(c) } } }
+  end
+
+  def url(name); "http://127.0.0.1:#{port}/#{name}"; end
+
+  def stop
+    @thread.kill
+    @server.close
+  end
+
+  private
+
+  def serve(client)
+    path = client.gets.to_s.split(" ")[1].to_s
+    nil while (line = client.gets) && line != "\r\n"
+    @lock.synchronize { @requests << path; @active += 1; @peak = @active if @active > @peak }
+    sleep @delay
+    file = File.join(TEST_DIRECTORY, "tarballs", File.basename(path))
+    if File.file?(file)
+      body = File.open(file, "rb") { |f| f.read }
+      client.write "HTTP/1.0 200 OK\r\nContent-Length: #{body.size}\r\n\r\n"
+      client.write body
+    else
+      client.write "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n"
+    end
+  ensure
+    @lock.synchronize { @active -= 1 }
+    client.close
+  end
+end # StandInServer
+
+class DownloadSchedulerTests < Homebrew::TestCase
+  Owner = Struct.new(:name)
+
+  def setup
+    @server = StandInServer.new
+  end
+
+  def teardown
+    DownloadScheduler.current.stop if DownloadScheduler.current
+    @server.stop
+    Dir["#{HOMEBREW_CACHE}/dlsched*"].each { |f| FileUtils.rm_rf f }
+  end
+
+  def resource(name, file, sha256 = TESTBALL_SHA256)
+    r = Resource.new
+    r.owner = Owner.new(name)
+    r.url @server.url(file)
+    r.version "0.1"
+    r.sha256 sha256
+    r
+  end
+
+  def test_fetches_in_the_background
+    items = %w[dlsched-a dlsched-b dlsched-c].map { |n| resource(n, "testball-0.1.tbz") }
+    scheduler = DownloadScheduler.new(4, 4)
+    items.each { |r| scheduler.add(r) }
+    scheduler.start
+    items.each { |r| assert scheduler.wait_for(r) }
+    items.each { |r| assert_predicate r.cached_download, :file? }
+    assert_equal 3, @server.peak
+  end
+
+  def test_per_host_limit
+    items = %w[dlsched-d dlsched-e dlsched-f].map { |n| resource(n, "testball-0.1.tbz") }
+    scheduler = DownloadScheduler.new(4, 1)
+    items.each { |r| scheduler.add(r) }
+    scheduler.start
+    items.each { |r| assert scheduler.wait_for(r) }
+    assert_equal 1, @server.peak
+  end
+
+  def test_failures_and_unscheduled_items
+    bad = resource("dlsched-g", "testball-0.1.tbz", "0" * 64)
+    missing = resource("dlsched-h", "nonexistent-0.1.tbz")
+    scheduler = DownloadScheduler.new
+    scheduler.add(bad).add(missing).start
+    refute scheduler.wait_for(bad)
+    refute scheduler.wait_for(missing)
+    assert_nil scheduler.wait_for(resource("dlsched-i", "testball-0.1.tbz"))
+  end
+end
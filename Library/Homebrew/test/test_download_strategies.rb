@@ -49,6 +49,62 @@ class VCSDownloadStrategyTests < Homebrew::TestCase
   end
 end
 
+class VCSStagingTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @stage = Pathname(Dir.mktmpdir)
+  end
+
+  def teardown
+    rm_rf @stage
+    rm_rf @cached if @cached
+  end
+
+  def git_strategy(specs = {})
+    strategy = GitDownloadStrategy.new("baz", ResourceDouble.new("https://example.com/baz.git", specs))
+    @cached = strategy.cached_location
+    @cached.mkpath
+    @cached.cd do
+      quiet_system "git", "init"
+      File.open("configure", "w") { |f| f.puts "#!/bin/sh" }
+      chmod 0755, "configure"
+      ln_s "configure", "configure.sh"
+      quiet_system "git", "add", "."
+      quiet_system "git", "-c", "user.name=T", "-c", "user.email=t@example.com", "commit", "-q", "-m", "Initial"
+    end
+    strategy
+  end
+
+  def test_git_stages_only_the_tree
+    strategy = git_strategy
+    index = (@cached/".git/index").read
+    @stage.cd { shutup { strategy.stage } }
+    assert_equal 0755, (@stage/"configure").stat.mode & 07777
+    assert (@stage/"configure.sh").symlink?
+    refute (@stage/".git").exist?
+    assert_equal index, (@cached/".git/index").read
+  end
+
+  def test_git_stages_metadata_when_asked
+    strategy = git_strategy(:vcs_metadata => true)
+    @stage.cd { shutup { strategy.stage } }
+    assert (@stage/".git").directory?
+  end
+
+  def test_cvs_stages_without_metadata
+    strategy = CVSDownloadStrategy.new("baz", ResourceDouble.new("cvs://example.com/cvsroot:baz"))
+    @cached = strategy.cached_location
+    (@cached/"CVS").mkpath
+    (@cached/"src/CVS").mkpath
+    (@cached/"src/main.c").write "int main() {}\n"
+    @stage.cd { strategy.stage }
+    assert_equal "int main() {}\n", (@stage/"src/main.c").read
+    refute (@stage/"CVS").exist?
+    refute (@stage/"src/CVS").exist?
+  end
+end
+
 class DownloadStrategyDetectorTests < Homebrew::TestCase
   def setup
     @d = DownloadStrategyDetector.new
@@ -0,0 +1,118 @@
+require "testing_env"
+require "formula_snapshot"
+require "installed_index"
+
+class FormulaSnapshotTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @path = Formulary.core_path("snapshotball")
+    @path.dirname.mkpath
+    write_formula "1.0"
+    forget_formula_files
+    FormulaSnapshot.reset!
+  end
+
+  def teardown
+    FormulaSnapshot.reset!
+    rm_f FormulaSnapshot::SNAPSHOT_FILE
+    InstalledIndex.reset!
+    rm_f InstalledIndex::INDEX_FILE
+    rm_f @path
+    forget_formula_files
+    rmtree HOMEBREW_CELLAR/"snapshotball" if (HOMEBREW_CELLAR/"snapshotball").exist?
+  end
+
+  # Formula memoizes its lists of formula files, which this test’s fixture joins & leaves.
+  def forget_formula_files
+    %w[@core_files @core_names @files @names @full_names].each { |v| Formula.instance_variable_set(v, nil) }
+  end
+
+  def write_formula(version)
+    rm_f @path
+    Formulary::FORMULAE.delete_if { |path, _| path.to_s == @path.to_s }  # Lest the old class be reused.
+    @path.write <<-EOS.undent
+      class Snapshotball < Formula
+        desc "Some test"
+        url "file://#{TEST_DIRECTORY}/tarballs/testball-#{version}.tbz"
+        version "#{version}"
+        depends_on "foo" => :build
+        option "with-bar", "Enable bar"
+      end
+    EOS
+  end
+
+  def test_records_static_metadata
+    entry = FormulaSnapshot.instance["snapshotball"]
+    assert_equal "Some test", entry.desc
+    assert_equal Version.new("1.0"), entry.version
+    assert_equal [["foo", [:build]]], entry.deps.map { |dep| [dep.name, dep.tags.to_a] }
+    assert_equal [["--with-bar", "Enable bar"]], entry.options
+    assert_equal "gsteemso/leopardbrew", entry.tap
+  end
+
+  def test_reevaluates_only_changed_files
+    FormulaSnapshot.instance
+    FormulaSnapshot.reset!
+    write_formula "2.0"
+    @path.utime(Time.now + 5, Time.now + 5)
+    assert_equal Version.new("2.0"), FormulaSnapshot.instance["snapshotball"].version
+  end
+
+  def test_forgets_removed_formulae
+    assert FormulaSnapshot.instance["snapshotball"]
+    FormulaSnapshot.reset!
+    rm_f @path
+    forget_formula_files
+    assert_nil FormulaSnapshot.instance["snapshotball"]
+  end
+
+  def test_refreshes_just_the_files_named
+    snapshot = FormulaSnapshot.load.refresh_files([@path])
+    assert_equal Version.new("1.0"), snapshot["snapshotball"].version
+    rm_f @path
+    assert_nil snapshot.refresh_files([@path])["snapshotball"]
+    assert_nil FormulaSnapshot.load["snapshotball"]
+  end
+
+  def test_discarded_when_homebrew_changes
+    FormulaSnapshot.load.refresh_files([@path])
+    assert_predicate FormulaSnapshot.load, :current?
+    ReadallCache.stubs(:library_stamp).returns("some other Homebrew")
+    snapshot = FormulaSnapshot.load
+    refute_predicate snapshot, :current?
+    assert_nil snapshot["snapshotball"]
+  end
+
+  def test_installed
+    refute_includes FormulaSnapshot.instance.installed.map(&:name), "snapshotball"
+    keg = HOMEBREW_CELLAR/"snapshotball/1.0"
+    keg.mkpath
+    touch keg/"INSTALL_RECEIPT.json"
+    FormulaSnapshot.reset!
+    InstalledIndex.reset!  # The Cellar may have changed within the second the index was stamped with.
+    rm_f InstalledIndex::INDEX_FILE
+    entry = FormulaSnapshot.instance.installed.detect { |e| e.name == "snapshotball" }
+    assert entry
+    assert_predicate entry, :any_version_installed?
+  end
+
+  def test_installed_follows_the_tap_the_keg_came_from
+    tapped = HOMEBREW_LIBRARY/"Taps/test/homebrew-tap/snapshotball.rb"
+    record = { "name" => "snapshotball", "mtime" => 0, "deps" => [], "requirements" => [] }
+    snapshot = FormulaSnapshot.new(:format => FormulaSnapshot::FORMAT_VERSION, :library => HOMEBREW_LIBRARY.to_s,
+                                   :stamp => ReadallCache.library_stamp, :aliases => {},
+                                   :records => { @path.to_s => record.merge("full_name" => "snapshotball"),
+                                                 tapped.to_s => record.merge("full_name" => "test/tap/snapshotball") })
+    keg = HOMEBREW_CELLAR/"snapshotball/1.0"
+    keg.mkpath
+    (keg/"INSTALL_RECEIPT.json").write '{"source":{"tap":"test/homebrew-tap"}}'
+    InstalledIndex.reset!
+    rm_f InstalledIndex::INDEX_FILE
+    assert_equal %w[test/tap/snapshotball], snapshot.installed.map(&:full_name)
+    (keg/"INSTALL_RECEIPT.json").atomic_write '{"source":{"tap":"gsteemso/leopardbrew"}}'
+    InstalledIndex.reset!
+    rm_f InstalledIndex::INDEX_FILE
+    assert_equal %w[snapshotball], snapshot.installed.map(&:full_name)
+  end
+end
@@ -0,0 +1,54 @@
+require "testing_env"
+require "host_probe"
+
+class HostProbeTests < Homebrew::TestCase
+  def setup
+    HostProbe.reset!
+    HostProbe.stubs(:fingerprint).returns([1, "10.5.8", []])
+  end
+
+  def teardown
+    HostProbe.cache_file.unlink if HostProbe.cache_file.exist?
+    HostProbe.reset!
+  end
+
+  def test_parse_sysctl
+    assert_equal({ "hw.cputype" => "18", "machdep.cpu.features" => "FPU VME SSE3" },
+                 HostProbe.parse_sysctl("hw.cputype: 18\nmachdep.cpu.features: FPU VME SSE3\n"))
+    assert_equal({ "hw.cputype" => "18" }, HostProbe.parse_sysctl("hw.cputype = 18\n"))
+  end
+
+  def test_sysctl_keys_are_read_in_one_go
+    output = HostProbe::SYSCTL_KEYS.map { |k| "#{k}: 1\n" }.join.sub("hw.cputype: 1", "hw.cputype: 7")
+    Utils.expects(:popen_read).once.returns(output)
+    assert_equal "7", HostProbe.sysctl("hw.cputype")
+    assert_equal "1", HostProbe.sysctl("hw.optional.sse3")
+  end
+
+  def test_values_are_remembered_between_runs
+    assert_equal "/Developer", HostProbe.fetch(:xcode_prefix) { "/Developer" }
+    assert_nil HostProbe.fetch(:clt_version) { nil }
+    HostProbe.reset!
+    assert_equal "/Developer", HostProbe.fetch(:xcode_prefix) { flunk "should have been remembered" }
+    assert_nil HostProbe.fetch(:clt_version) { flunk "should have been remembered" }
+  end
+
+  def test_values_are_forgotten_when_the_host_changes
+    HostProbe.fetch(:xcode_version) { "3.1.4" }
+    HostProbe.reset!
+    HostProbe.stubs(:fingerprint).returns([2, "10.5.8", []])
+    assert_equal "3.2.6", HostProbe.fetch(:xcode_version) { "3.2.6" }
+  end
+
+  def test_developer_dir_is_part_of_the_fingerprint
+    Utils.stubs(:popen_read).returns("")  # In case there is no syslogd pid file to stamp the boot time.
+    fingerprint = HostProbe.instance_method(:fingerprint).bind(HostProbe)  # The real one, not the stub from #setup.
+    old = ENV["DEVELOPER_DIR"]
+    ENV["DEVELOPER_DIR"] = "/Developer"
+    before = fingerprint.call
+    ENV["DEVELOPER_DIR"] = "/Applications/Xcode.app/Contents/Developer"
+    refute_equal before, fingerprint.call
+  ensure
+    ENV["DEVELOPER_DIR"] = old
+  end
+end
@@ -0,0 +1,63 @@
+require "testing_env"
+require "install_scheduler"
+
+class InstallSchedulerTests < Homebrew::TestCase
+  def setup
+    @dir = Pathname(Dir.mktmpdir("scheduler", HOMEBREW_TEMP.to_s))
+  end
+
+  def teardown
+    @dir.rmtree
+  end
+
+  # A job that records when it started & finished.
+  def job(name, delay = 0.2)
+    lambda do |_|
+      (@dir/"#{name}.start").write Time.now.to_f.to_s
+      sleep delay
+      (@dir/"#{name}.finish").write Time.now.to_f.to_s
+    end
+  end
+
+  def moment(name, event); (@dir/"#{name}.#{event}").read.to_f; end
+
+  def test_independent_jobs_run_together_and_dependents_wait
+    s = InstallScheduler.new(8, 4)
+    s.add("a", [], :build => true, &job("a"))
+    s.add("b", [], :build => true, &job("b"))
+    s.add("c", %w[a b], :build => true, &job("c"))
+    shush { s.run }
+    assert moment("b", "start") < moment("a", "finish")
+    assert moment("c", "start") >= moment("a", "finish")
+    assert moment("c", "start") >= moment("b", "finish")
+    assert_equal [4, 4, 8], %w[a b c].map { |n| s.jobs_of(n) }
+  end
+
+  def test_budget_is_shared_and_exported_to_builds
+    s = InstallScheduler.new(3, 4)
+    %w[a b].each { |n| s.add(n, [], :build => true) { (@dir/n).write ENV["HOMEBREW_MAKE_JOBS"] } }
+    s.add("pour", []) { (@dir/"pour").write ENV["HOMEBREW_MAKE_JOBS"].to_s }
+    shush { s.run }
+    assert_equal %w[2 1], %w[a b].map { |n| (@dir/n).read }
+    refute_equal "2", (@dir/"pour").read
+  end
+
+  def test_failure_cancels_only_its_dependents
+    s = InstallScheduler.new(4, 2)
+    s.add("bad", []) { raise "no good" }
+    s.add("good", [], &job("good"))
+    s.add("needs-bad", ["bad"], &job("needs-bad"))
+    s.add("needs-needs-bad", ["needs-bad"], &job("needs-needs-bad"))
+    s.add("needs-good", ["good"], &job("needs-good"))
+    e = assert_raises(RuntimeError) { shush { s.run } }
+    assert_equal "no good", e.message
+    assert_equal :failed, s.state_of("bad")
+    assert_equal [:cancelled, :cancelled], %w[needs-bad needs-needs-bad].map { |n| s.state_of(n) }
+    assert_equal [:done, :done], %w[good needs-good].map { |n| s.state_of(n) }
+    refute_predicate @dir/"needs-bad.start", :exist?
+  end
+
+  def shush
+    capture_io { yield }
+  end
+end
@@ -0,0 +1,84 @@
+require "testing_env"
+require "installed_index"
+require "formula/pin"
+
+class InstalledIndexTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @old_path = HOMEBREW_CELLAR.join("foo", "1.0")
+    @new_path = HOMEBREW_CELLAR.join("foo", "1.1")
+    [@old_path, @new_path].each { |p| p.join("bin").mkpath }
+    @new_path.join("bin", "foo").write "#!/bin/sh\n"
+    @new_path.join(Tab::FILENAME).write <<-EOS.undent
+      {"built_archs":["ppc"],"used_options":["--with-bar"],"poured_from_bottle":true,
+       "source":{"tap":"gsteemso/leopardbrew","spec":"stable"},"dependencies":["bar"]}
+    EOS
+    @old = Keg.new(@old_path)
+    @new = Keg.new(@new_path)
+    InstalledIndex.reset!
+  end
+
+  def teardown
+    InstalledIndex.reset!
+    rm_f InstalledIndex::INDEX_FILE
+    [@old, @new].each { |k| k.uninstall if k.exist? }
+    rmtree OPTDIR if OPTDIR.exist?
+    rmtree PINDIR if PINDIR.exist?
+  end
+
+  def test_kegs_and_receipts_are_recorded
+    rack = InstalledIndex.instance.rack("foo")
+    assert_equal [@old_path.to_s, @new_path.to_s], rack.kegs.map(&:path)
+    keg = rack.keg_at(@new_path)
+    assert_equal [:ppc], keg.built_archs
+    assert_equal ["--with-bar"], keg.used_options
+    assert keg.poured_from_bottle
+    assert_equal ["bar"], keg.dependencies
+    assert_equal "gsteemso/leopardbrew", keg.tap
+    assert_equal 2, keg.file_count
+    assert_equal 10 + @new_path.join(Tab::FILENAME).size, keg.size
+    assert_nil rack.keg_at(@old_path).dependencies
+    assert_equal @new_path.to_s, rack.active_keg.path
+  end
+
+  def test_optlinking_and_pinning_update_the_index
+    InstalledIndex.instance
+    @old.optlink
+    assert_equal @old_path.to_s, InstalledIndex.instance.rack("foo").active_keg.path
+    FormulaPin.new(OpenStruct.new(:name => "foo", :rack => @old_path.parent)).pin_at("1.0")
+    InstalledIndex.reset!
+    assert_equal @old_path.to_s, InstalledIndex.instance.rack("foo").pinned
+  end
+
+  def test_uninstalling_updates_the_index
+    InstalledIndex.instance
+    @new.uninstall
+    InstalledIndex.reset!
+    assert_equal ["1.0"], InstalledIndex.instance.versions("foo").map(&:to_s)
+    @old.uninstall
+    InstalledIndex.reset!
+    assert_empty InstalledIndex.instance.rack_names
+  end
+
+  def test_rebuild_reports_drift
+    InstalledIndex.instance
+    InstalledIndex.reset!
+    OPTDIR.mkpath
+    ln_s @old_path, OPTDIR/"foo"  # Behind the index’s back.
+    _, err = capture_io { InstalledIndex.rebuild }
+    assert_match "foo", err
+    InstalledIndex.reset!
+    assert_equal @old_path.to_s, InstalledIndex.instance.rack("foo").opt
+  end
+
+  def test_rebuilds_only_when_asked
+    ARGV << "--rebuild"
+    assert_equal ["", ""], capture_io { InstalledIndex.instance }
+    InstalledIndex.reset!
+    out, = capture_io { InstalledIndex.instance(true) }
+    assert_match "index was up to date", out
+  ensure
+    ARGV.delete("--rebuild")
+  end
+end
@@ -95,6 +95,22 @@ class LinkTests < Homebrew::TestCase
     assert_raises(Keg::AlreadyLinkedError) { @keg.link }
   end
 
+  def test_all_conflicts_are_found_before_linking
+    touch @dst
+    touch HOMEBREW_PREFIX/"bin/hiworld"
+    e = assert_raises(Keg::ConflictError) { @keg.link }
+    assert_equal 1, e.other_conflicts
+    refute_predicate HOMEBREW_PREFIX/"bin/goodbye_cruel_world", :symlink?
+  end
+
+  def test_failed_link_is_rolled_back
+    plan = Keg::LinkPlan.new(@mode)
+    plan.add_dir(@keg, "bin") { :link }
+    touch plan.ops.last.path
+    assert_raises(Keg::LinkError) { plan.apply }
+    assert_empty (HOMEBREW_PREFIX/"bin").children.select(&:symlink?)
+  end
+
   def test_linking_fails_when_files_exist
     touch @dst
     assert_raises(Keg::ConflictError) { @keg.link }
@@ -0,0 +1,55 @@
+require "testing_env"
+require "keg_cache"
+
+class KegCacheTests < Homebrew::TestCase
+  include FileUtils
+
+  FormulaDouble = Struct.new(:name, :pkg_version, :prefix)
+
+  def setup
+    @path = HOMEBREW_CELLAR.join("foo", "1.0")
+    @path.join("bin").mkpath
+    @path.join("bin", "foo-config").write "#!/bin/sh\necho #{HOMEBREW_PREFIX}/lib #{HOMEBREW_CELLAR}/foo/1.0\n"
+    @path.join("bin", "foo-config").chmod 0755
+    ln_s "foo-config", @path.join("bin", "foo")
+    @keg = Keg.new(@path)
+    @formula = FormulaDouble.new("foo", PkgVersion.parse("1.0"), @path)
+    @cache = KegCache.new(@formula, "recipe" => "abc", "compiler" => "clang 700")
+  end
+
+  def teardown
+    @keg.uninstall if @keg.exist?
+    rm_rf KegCache::DIR
+  end
+
+  def test_different_inputs_are_kept_apart
+    refute_equal @cache.path, KegCache.new(@formula, "recipe" => "abc", "compiler" => "gcc_4_2 5666").path
+    assert_equal @cache.path, KegCache.new(@formula, "compiler" => "clang 700", "recipe" => "abc").path
+    assert_match %r{/foo--1\.0--[0-9a-f]{32}\.tar\.gz$}, @cache.path.to_s
+  end
+
+  def test_storing_leaves_the_keg_untouched
+    config = @path.join("bin", "foo-config")
+    before = [config.stat.ino, config.stat.mtime]
+    shutup { @cache.store(@keg) }
+    assert_equal before, [config.stat.ino, config.stat.mtime]
+    assert_empty Dir["#{HOMEBREW_TEMP}/keg_cache*"]
+  end
+
+  def test_kegs_are_stored_relocatably_and_poured_back
+    original = @path.join("bin", "foo-config").read
+    refute @cache.hit?
+    shutup { @cache.store(@keg) }
+    assert @cache.hit?
+    assert_equal original, @path.join("bin", "foo-config").read
+    require "zlib"
+    stored = Zlib::GzipReader.open(@cache.path.to_s, &:read)
+    assert_includes stored, "#{Keg::PREFIX_PLACEHOLDER}/lib #{Keg::CELLAR_PLACEHOLDER}/foo/1.0"
+    refute_includes stored, HOMEBREW_PREFIX.to_s
+    @keg.uninstall
+    @cache.pour
+    assert_equal original, @path.join("bin", "foo-config").read
+    assert_equal 0755, @path.join("bin", "foo-config").stat.mode & 07777
+    assert @path.join("bin", "foo").symlink?
+  end
+end
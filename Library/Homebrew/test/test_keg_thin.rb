@@ -0,0 +1,68 @@
+require "testing_env"
+require "keg"
+
+class KegThinTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @path = HOMEBREW_CELLAR.join("foo", "1.0")
+    @path.join("lib").mkpath
+    cp "#{TEST_DIRECTORY}/mach/fat.dylib", @path/"lib/libfat.dylib"
+    cp "#{TEST_DIRECTORY}/mach/i386.dylib", @path/"lib/libthin.dylib"
+    @path.join(Tab::FILENAME).write <<-EOS.undent
+      {"built_archs":["i386","x86_64"],"build_mode":"native","compiler":"gcc-4.2","used_options":[],"source":{"path":"foo.rb","spec":"stable"}}
+    EOS
+    @keg = Keg.new(@path)
+    # A stand-in `lipo`, which “thins” by keeping the first 100 octets.
+    @lipo = HOMEBREW_TEMP/"fake-lipo"
+    @lipo.write "#!/bin/sh\nfor last; do :; done\nhead -c 100 \"$1\" > \"$last\"\n"
+    @lipo.chmod 0755
+    MacOS.stubs(:lipo).returns(@lipo)
+  end
+
+  def teardown
+    @keg.uninstall
+    rm_f @lipo
+  end
+
+  def test_fat_slice_archs
+    assert_equal [:x86_64, :i386], (@path/"lib/libfat.dylib").fat_slice_archs
+    assert_empty (@path/"lib/libthin.dylib").fat_slice_archs
+  end
+
+  def test_slices_to_keep
+    fat = @path/"lib/libfat.dylib"
+    assert_equal [:x86_64], Keg.slices_to_keep(fat, [:x86_64, :ppc])
+    assert_nil Keg.slices_to_keep(fat, [:i386, :x86_64])
+    assert_nil Keg.slices_to_keep(fat, [:ppc])
+    assert_nil Keg.slices_to_keep(@path/"lib/libthin.dylib", [:x86_64])
+  end
+
+  def test_thinning_a_keg
+    fat = @path/"lib/libfat.dylib"
+    size = fat.size
+    fat.chmod 0444
+    assert_equal size - 100, @keg.thin([:x86_64], 2)
+    assert_equal 100, fat.size
+    assert_equal 0444, fat.stat.mode & 07777
+    tab = Tab.for_keg(@path)
+    assert_equal [:x86_64], tab.built_archs
+    assert_equal :plain, tab.build_mode
+  end
+
+  def test_a_file_lipo_fails_on_is_left_fat
+    fat = @path/"lib/libfat.dylib"
+    size = fat.size
+    @lipo.unlink
+    @lipo.write "#!/bin/sh\nexit 1\n"
+    @lipo.chmod 0755
+    assert_equal 0, @keg.thin([:x86_64], 2)
+    assert_equal size, fat.size
+    refute_predicate Keg.thin_temp(fat), :exist?
+  end
+
+  def test_nothing_to_thin_leaves_the_receipt_alone
+    assert_equal 0, @keg.thin([:i386, :x86_64])
+    assert_equal [:i386, :x86_64], Tab.for_keg(@path).built_archs
+  end
+end
@@ -0,0 +1,93 @@
+require "testing_env"
+require "linkage_index"
+
+class LinkageIndexTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @keg_path = HOMEBREW_CELLAR.join("foo", "1.0")
+    @keg_path.join("lib").mkpath
+    cp "#{TEST_DIRECTORY}/mach/i386.dylib", @keg_path.join("lib", "libfoo.1.dylib")
+    ln_s "libfoo.1.dylib", @keg_path.join("lib", "libfoo.dylib")
+    touch @keg_path.join("lib", "README")
+    @keg = Keg.new(@keg_path)
+    LinkageIndex.reset!
+  end
+
+  def teardown
+    LinkageIndex.reset!
+    rm_f LinkageIndex::INDEX_FILE
+    @keg.uninstall if @keg.exist?
+    rmtree OPTDIR if OPTDIR.exist?
+  end
+
+  def test_dylibs_are_owned_by_their_keg
+    index = LinkageIndex.instance
+    owner = index.owner_of(@keg_path.join("lib", "libfoo.1.dylib"))
+    assert_equal @keg_path.to_s, owner.path
+    assert_equal "foo", owner.formula_name
+    assert_equal @keg_path.to_s, index.owner_of(@keg_path.join("lib", "libfoo.dylib")).path
+  end
+
+  def test_opt_paths_follow_the_optlink
+    @keg.optlink
+    index = LinkageIndex.instance
+    assert_equal @keg_path.to_s, index.owner_of("#{OPTDIR}/foo/lib/libfoo.1.dylib").path
+  end
+
+  def test_system_and_missing_libraries
+    index = LinkageIndex.instance
+    assert_nil index.owner_of("/usr/lib/libSystem.B.dylib") if File.exist?("/usr/lib/libSystem.B.dylib")
+    assert_raises(Errno::ENOENT) { index.owner_of(@keg_path.join("lib", "libgone.dylib")) }
+  end
+
+  def test_vanished_files_are_not_vouched_for
+    dylib = @keg_path.join("lib", "libfoo.1.dylib")
+    index = LinkageIndex.instance
+    rm dylib
+    assert_raises(Errno::ENOENT) { index.owner_of(dylib) }
+  end
+
+  def test_prefix_links_must_still_lead_into_the_keg
+    LINKDIR.mkpath
+    ln_s @keg_path, LINKDIR/"foo"  # Recorded as linked, though no links are made in the prefix.
+    linked = HOMEBREW_PREFIX.join("lib", "libfoo.1.dylib")
+    index = LinkageIndex.instance
+    assert_raises(Errno::ENOENT) { index.owner_of(linked) }
+    linked.dirname.mkpath
+    touch HOMEBREW_TEMP.join("elsewhere.dylib")
+    ln_s HOMEBREW_TEMP.join("elsewhere.dylib"), linked
+    assert_nil index.owner_of(linked)
+  ensure
+    rm_f LINKDIR/"foo"
+    rm_f linked if linked
+    rm_f HOMEBREW_TEMP.join("elsewhere.dylib")
+  end
+
+  def test_find_in_keg
+    index = LinkageIndex.instance
+    assert_equal @keg_path.join("lib", "libfoo.1.dylib"), index.find_in_keg(@keg, "libfoo.1.dylib", "lib")
+    assert_nil index.find_in_keg(@keg, "README")
+  end
+
+  def test_relocation_does_not_build_an_index
+    refute_predicate LinkageIndex, :available?
+    dylib = @keg_path.join("lib", "libfoo.1.dylib")
+    assert_equal "#{OPTDIR}/foo/lib/libfoo.1.dylib", @keg.fixed_name(dylib, dylib.to_s)
+    assert_equal dylib, @keg.find_dylib(Pathname.new("libfoo.1.dylib"))
+    refute_predicate LinkageIndex::INDEX_FILE, :exist?
+  end
+
+  def test_index_persists_and_drops_removed_racks
+    refute_predicate LinkageIndex, :available?
+    LinkageIndex.instance
+    assert_predicate LinkageIndex, :available?
+    assert_predicate LinkageIndex::INDEX_FILE, :file?
+    LinkageIndex.reset!
+    assert LinkageIndex.instance.indexed?(@keg)
+    @keg.uninstall
+    refute LinkageIndex.instance.indexed?(@keg)
+    LinkageIndex.reset!
+    assert_empty LinkageIndex.instance.keg_paths
+  end
+end
@@ -0,0 +1,90 @@
+require "testing_env"
+require "rebase_planner"
+
+class MachRebaserTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @path = HOMEBREW_CELLAR.join("foo", "1.0")
+    @path.join("lib").mkpath
+    @keg = Keg.new(@path)
+  end
+
+  def teardown
+    @keg.uninstall
+    rm_f RebasePlanner::PLAN_FILE
+  end
+
+  # A minimal big-endian PowerPC dylib, of the kind ld made before rebase info:  One pointer in __data with a local relocation,
+  # one local and one external non-lazy pointer, and one defined symbol, all aimed into __text.
+  def classic_dylib
+    cmds = [1, 124, "__TEXT", 0, 0x1000, 0, 0x1000, 7, 5, 1, 0].pack("NNa16N8") +
+           ["__text", "__TEXT", 0x200, 0x10, 0x200, 2, 0, 0, 0x80000400, 0, 0].pack("a16a16N9") +
+           [1, 192, "__DATA", 0x1000, 0x1000, 0x1000, 0x1000, 7, 3, 2, 0].pack("NNa16N8") +
+           ["__data", "__DATA", 0x1000, 8, 0x1000, 2, 0, 0, 0, 0, 0].pack("a16a16N9") +
+           ["__nl_symbol_ptr", "__DATA", 0x1008, 8, 0x1008, 2, 0, 0, 6, 0, 0].pack("a16a16N9") +
+           [2, 24, 0x2000, 1, 0x2010, 8].pack("N6") +
+           [0xb, 80, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0x2020, 2, 0, 0, 0x2030, 1].pack("N20")
+    data = [0xfeedface, 18, 0, 6, 4, cmds.length, 0].pack("N7") + cmds
+    data += "\0" * (0x200 - data.length) + "\x60\0\0\0" * 4
+    data += "\0" * (0x1000 - data.length) + [0x204, 0, 0x208, 0].pack("N4")
+    data += "\0" * (0x2000 - data.length) + [1, 0x0f, 1, 0, 0x200].pack("NCCnN")
+    data += "\0" * (0x2010 - data.length) + "\0_foo\0\0\0\0"
+    data += "\0" * (0x2020 - data.length) + [0x80000000, 0].pack("NN") + [0, 0].pack("NN") + [0x1000, 0x240].pack("NN")
+    pn = @path/"lib/libclassic.dylib"
+    pn.open("wb") { |f| f.write data }
+    pn
+  end
+
+  def bytes(pn); pn.open("rb") { |f| f.read }; end
+
+  def test_classic_dylibs_are_slid_whole
+    pn = classic_dylib
+    original = bytes(pn)
+    rebaser = MachRebaser.new(pn)
+    assert_equal [[:ppc, 0, 0x2000]], rebaser.slices.map { |s| [s.arch, s.base, s.size] }
+    rebaser.rebase(:ppc => 0x10000000).write
+    data = bytes(pn)
+    assert_equal [0x10000000, 0x1000], data[28 + 24, 8].unpack("NN")          # __TEXT
+    assert_equal 0x10000200, data[28 + 56 + 32, 4].unpack("N").first         # __text
+    assert_equal [0x10000204, 0, 0x10000208, 0], data[0x1000, 16].unpack("N4") # relocated & local non-lazy pointers only
+    assert_equal 0x10000200, data[0x2008, 4].unpack("N").first               # _foo
+    assert_equal 0x10000000, MachRebaser.new(pn).slices.first.base
+    MachRebaser.new(pn).rebase(:ppc => 0).write
+    assert_equal original, bytes(pn)
+  end
+
+  def test_dylibs_with_rebase_info_are_slid_per_slice
+    pn = @path/"lib/libfat.dylib"
+    cp "#{TEST_DIRECTORY}/mach/fat.dylib", pn
+    original = bytes(pn)
+    MachRebaser.new(pn).rebase(:i386 => 0x30000000, :x86_64 => 0x200000000).write
+    bases = MachRebaser.new(pn).slices.map { |s| [s.arch, s.base] }
+    assert_equal [[:x86_64, 0x200000000], [:i386, 0x30000000]], bases
+    MachRebaser.new(pn).rebase(:i386 => 0, :x86_64 => 0).write
+    assert_equal original, bytes(pn)
+  end
+
+  def test_only_dylibs_are_rebased
+    pn = @path/"lib/a.out"
+    cp "#{TEST_DIRECTORY}/mach/a.out", pn
+    original = bytes(pn)
+    arch = MachRebaser.new(pn).slices.first.arch
+    assert_raises(MachRebaser::UnsupportedError) { MachRebaser.new(pn).rebase(arch => 0x30000000) }
+    assert_equal original, bytes(pn)
+  end
+
+  def test_planner_places_dylibs_apart_and_remembers_them
+    cp "#{TEST_DIRECTORY}/mach/fat.dylib", @path/"lib/libfat.dylib"
+    cp "#{TEST_DIRECTORY}/mach/i386.dylib", @path/"lib/libthin.dylib"
+    assert_equal 2, RebasePlanner.run([@keg]).length
+    planner = RebasePlanner.load
+    fat, thin = planner.place_of(@path/"lib/libfat.dylib", :i386), planner.place_of(@path/"lib/libthin.dylib", :i386)
+    assert fat[0] + fat[1] <= thin[0] || thin[0] + thin[1] <= fat[0], "#{fat.inspect} overlaps #{thin.inspect}"
+    assert_equal fat[0], MachRebaser.new(@path/"lib/libfat.dylib").slices.detect { |s| s.arch == :i386 }.base
+    assert_empty RebasePlanner.run([@keg])
+    rm @path/"lib/libthin.dylib"
+    RebasePlanner.run([@keg])
+    assert_equal [(@path/"lib/libfat.dylib").to_s], RebasePlanner.load.paths
+  end
+end
@@ -0,0 +1,37 @@
+require "testing_env"
+require "readall_cache"
+
+class ReadallCacheTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    HOMEBREW_CACHE.mkpath
+    @file = HOMEBREW_CACHE/"foo.rb"
+    @file.write "class Foo < Formula; end\n"
+  end
+
+  def teardown
+    rm_rf HOMEBREW_CACHE
+  end
+
+  def test_unchanged_files_that_passed_are_remembered
+    cache = ReadallCache.load
+    refute cache.passed?(@file)
+    cache.pass(@file, ReadallCache.digest(@file)).save
+    assert ReadallCache.load.passed?(@file)
+    @file.atomic_write "class Foo < Formula\n"
+    refute ReadallCache.load.passed?(@file)
+  end
+
+  def test_failures_are_forgotten
+    ReadallCache.load.pass(@file, ReadallCache.digest(@file)).save
+    ReadallCache.load.fail(@file).save
+    refute ReadallCache.load.passed?(@file)
+  end
+
+  def test_a_changed_library_discards_the_record
+    stale = { :format => ReadallCache::FORMAT_VERSION, :stamp => "stale", :passed => { @file.to_s => ReadallCache.digest(@file) } }
+    refute ReadallCache.new(stale).passed?(@file)
+    assert ReadallCache.new(stale.merge(:stamp => ReadallCache.library_stamp)).passed?(@file)
+  end
+end
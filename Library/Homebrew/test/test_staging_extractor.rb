@@ -0,0 +1,69 @@
+require "testing_env"
+require "staging_extractor"
+
+class StagingExtractorTests < Homebrew::TestCase
+  include FileUtils
+
+  def setup
+    @dir = Pathname(Dir.mktmpdir)
+    source = @dir/"src/foo-1.0"
+    source.mkpath
+    (source/"configure").write "#!/bin/sh\n"
+    (source/"configure").chmod 0755
+    (source/"README").write "hello\n"
+    (source/"README").chmod 0640
+    ln_s "README", source/"README.txt"
+    @out = @dir/"out"
+    @out.mkpath
+  end
+
+  def teardown
+    rm_rf @dir
+    rm_rf OPTDIR
+  end
+
+  def tarball(flag, ext)
+    archive = @dir/"foo-1.0.tar.#{ext}"
+    (@dir/"src").cd { safe_system "tar", "-c#{flag}f", archive.to_s, "foo-1.0" }
+    archive
+  end
+
+  def assert_unpacked
+    dir = @out/"foo-1.0"
+    assert_equal "hello\n", (dir/"README").read
+    assert_equal 0640, (dir/"README").stat.mode & 07777
+    assert_equal 0755, (dir/"configure").stat.mode & 07777
+    assert (dir/"README.txt").symlink?
+    assert_equal "README", (dir/"README.txt").readlink.to_s
+  end
+
+  def test_tarballs_unpack_with_permissions_and_symlinks
+    [["z", "gz", :gzip], ["j", "bz2", :bzip2]].each do |flag, ext, type|
+      archive = tarball(flag, ext)
+      assert_equal type, archive.compression_type
+      @out.cd { StagingExtractor.new(type, 1).untar(archive) }
+      assert_unpacked
+      rm_rf @out/"foo-1.0"
+    end
+  end
+
+  def test_a_parallel_decompressor_is_preferred
+    archive = tarball("j", "bz2")
+    log = @dir/"lbzip2.log"
+    lbzip2 = OPTDIR/"lbzip2/bin/lbzip2"
+    lbzip2.dirname.mkpath
+    lbzip2.write "#!/bin/sh\necho \"$@\" > #{log}\nfor last; do :; done\nexec bzip2 -dc \"$last\"\n"
+    lbzip2.chmod 0755
+    extractor = StagingExtractor.new(:bzip2, 3)
+    assert_equal [lbzip2.to_s, "-dc", "-n", "3"], extractor.decompressor
+    @out.cd { extractor.untar(archive) }
+    assert_unpacked
+    assert_equal "-dc -n 3 #{archive}", log.read.chomp
+  end
+
+  def test_failures_are_reported
+    archive = @dir/"broken.tar.gz"
+    archive.write "\x1f\x8bnot really gzip"
+    assert_raises(ErrorDuringExecution) { @out.cd { StagingExtractor.new(:gzip, 1).untar(archive) } }
+  end
+end
@@ -0,0 +1,69 @@
+require "testing_env"
+require "cmd/update"
+
+class UpdateTapsTests < Homebrew::TestCase
+  include FileUtils
+
+  GIT = %w[git -c user.name=T -c user.email=t@example.com]
+
+  def setup
+    @remotes = Pathname(Dir.mktmpdir)
+    @work = Pathname(Dir.mktmpdir)
+    @taps = %w[foo bar].map { |repo| tap_with_remote(repo) }
+  end
+
+  def teardown
+    rm_rf [@remotes, @work, HOMEBREW_LIBRARY.join("Taps")]
+  end
+
+  # A tap cloned from a local bare repository holding one formula, “<repo>a”.
+  def tap_with_remote(repo)
+    remote = @remotes/"homebrew-#{repo}.git"
+    quiet_system "git", "init", "-q", "--bare", remote
+    clone = @work/repo
+    quiet_system "git", "clone", "-q", remote, clone
+    clone.cd do
+      mkdir "Formula"
+      File.open("Formula/#{repo}a.rb", "w") { |f| f.puts "class #{repo.capitalize}a < Formula; end" }
+      quiet_system(*GIT + %w[add .])
+      quiet_system(*GIT + %w[commit -q -m Initial])
+      quiet_system(*GIT + %w[push -q origin HEAD])
+    end
+    tap = Tap.fetch("test", repo)
+    tap.path.dirname.mkpath
+    quiet_system "git", "clone", "-q", remote, tap.path
+    tap
+  end
+
+  # Replaces the formula “<repo>a” upstream with “<repo>b”.
+  def push_change(repo)
+    (@work/repo).cd do
+      quiet_system(*GIT + ["mv", "Formula/#{repo}a.rb", "Formula/#{repo}b.rb"])
+      File.open("Formula/#{repo}b.rb", "w") { |f| f.puts "class #{repo.capitalize}b < Formula; url 'x'; end" }
+      quiet_system(*GIT + %w[commit -q -a -m Change])
+      quiet_system(*GIT + %w[push -q origin HEAD])
+    end
+  end
+
+  def test_taps_are_pulled_together_and_reported_on_afterwards
+    push_change("foo")
+    push_change("bar")
+    updaters = shutup { Homebrew.send(:update_taps) }
+    assert_equal 2, updaters.length
+    report = Report.new
+    updaters.each { |u| u.repository.cd { report.update(u.report) { |_k, old, new| old.concat(new) } } }
+    assert_equal %w[test/bar/barb test/foo/foob], report.select_formula(:A)
+    assert_equal %w[test/bar/bara test/foo/fooa], report.select_formula(:D)
+    @taps.each { |tap| assert tap.path.join("Formula/#{tap.repo}b.rb").file? }
+    files = updaters.map(&:changed_files).flatten.map { |p| p.basename.to_s }.sort
+    assert_equal %w[bara.rb barb.rb fooa.rb foob.rb], files
+  end
+
+  def test_a_failing_tap_does_not_hold_up_the_rest
+    push_change("bar")
+    rm_rf @remotes/"homebrew-foo.git"
+    updaters = shutup { Homebrew.send(:update_taps) }
+    assert_equal [@taps.last.path], updaters.map(&:repository)
+    assert @taps.last.path.join("Formula/barb.rb").file?
+  end
+end
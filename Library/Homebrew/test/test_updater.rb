@@ -130,4 +130,18 @@ class UpdaterTests < Homebrew::TestCase
     assert_equal %w[foo/bar/git], @report.select_formula(:M)
     assert_empty @report.select_formula(:D)
   end
+
+  def test_core_formulae_in_lettered_directories_are_reported
+    updater = Updater.new(HOMEBREW_REPOSITORY)
+    updater.instance_variable_set(:@initial_revision, "1234abcd")
+    updater.instance_variable_set(:@current_revision, "3456cdef")
+    def updater.read_current_revision; "3456cdef"; end
+    def updater.diff; "A\tLibrary/Formula/f/foo.rb\nR100\tLibrary/Formula/b/bar.rb\tLibrary/Formula/b/baz.rb\n"; end
+    map = updater.report
+    assert_equal [HOMEBREW_REPOSITORY.join("Library/Formula/f/foo.rb"), HOMEBREW_REPOSITORY.join("Library/Formula/b/baz.rb")],
+                 map[:A]
+    assert_equal [HOMEBREW_REPOSITORY.join("Library/Formula/b/bar.rb")], map[:D]
+    assert_equal %w[foo.rb bar.rb baz.rb], updater.changed_files.map { |p| p.basename.to_s }
+    refute_predicate updater, :library_changed?
+  end
 end
@@ -19,7 +19,10 @@ def archs_for_command(cmd)
   Pathname(cmd).archs
 end
 
-def curl(*args)
+def curl(*args); safe_system CURL_PATH, *curl_args(*args); end
+
+# The full argument list for a `curl` invocation, standard flags included.
+def curl_args(*args)
   raise "#{CURL_PATH} is not executable" unless CURL_PATH.exists? && CURL_PATH.executable?
 
   flags = HOMEBREW_CURL_ARGS
@@ -28,9 +31,8 @@ def curl(*args)
   args = [flags, HOMEBREW_USER_AGENT_CURL, *args]
   args << '--verbose' if ENV['HOMEBREW_CURL_VERBOSE']
   args << '--silent' unless $stdout.tty?
-
-  safe_system CURL_PATH, *args
-end # curl
+  args
+end # curl_args
 
 # Encompasses both safe_system and silent_system (“quiet_system”).
 def do_system(flags, cmd, *args, &block)
@@ -48,3 +48,52 @@ module Utils
     end
   end
 end
+
+module Utils
+  # Runs the block once per item across at most “jobs” forked worker processes, & returns the block’s results in item order.  Each
+  # worker handles every jobs’th item, so neighbouring (often similarly‐sized) items are spread out amongst them.  Results travel
+  # back to the parent through Marshal, so they must be marshalable; if the block raised for any item, the exception for the first
+  # such item is re‐raised here once every worker has finished.  The block runs in a child process:  It can read, but not alter,
+  # the parent’s state.
+  def self.parallel_map(items, jobs)
+    items = items.to_a
+    jobs = [jobs.to_i, items.length].min
+    return items.map{ |item| yield item } if jobs <= 1
+    readers = {}
+    pids = []
+    jobs.times do |slot|
+      read, write = IO.pipe
+      pids << fork do
+        read.close
+        results = []
+        slot.step(items.length - 1, jobs) do |i|
+          begin
+            results << [i, true, yield(items[i])]
+          rescue Exception => e
+            e = RuntimeError.new("#{e.class}:  #{e.message}") unless (Marshal.dump(e) rescue nil)
+            results << [i, false, e]
+          end
+        end
+        Marshal.dump(results, write)
+        write.close
+        exit!(true)
+      end # fork
+      write.close
+      readers[read] = ''
+    end # each worker |slot|
+    ignore_interrupts(:quietly) do  # The children will receive any interrupt too.
+      until (open_ones = readers.keys.reject(&:closed?)).empty?
+        IO.select(open_ones)[0].each do |io|
+          begin readers[io] << io.sysread(65536)
+          rescue EOFError then io.close; end
+        end
+      end
+      pids.each{ |pid| Process.wait(pid) }
+    end
+    outcome = []
+    readers.each_value{ |data| Marshal.load(data).each{ |i, ok, result| outcome[i] = [ok, result] } unless data.empty? }
+    raise 'A parallel worker exited without reporting its results' if outcome.compact.length < items.length
+    if failure = outcome.detect{ |ok, _| not ok } then raise failure[1]; end
+    outcome.map{ |_, result| result }
+  end # Utils::parallel_map
+end # Utils